@@ -28,14 +28,22 @@
 #include <string.h>
 #include <ctype.h>
 
+/* The last alias, if known, so that appending needn't go through all. */
+static ALIAS *LastAlias = NULL;
+
+/* The aliases sorted by name for completion, sorted again after the
+ * first completion since aliases were added or removed. */
+static ALIAS **SortedAliases = NULL;
+static int NumSortedAliases = 0;
+static int SortedAliasesValid = 0;
+
 ADDRESS *mutt_lookup_alias (const char *s)
 {
-  ALIAS *t = Aliases;
+  ALIAS *t;
 
-  for (; t; t = t->next)
-    if (!mutt_strcasecmp (s, t->name))
-      return (t->addr);
-  return (NULL);   /* no such alias */
+  if (!s || !(t = hash_find (AliasNames, s)))
+    return (NULL);   /* no such alias */
+  return (t->addr);
 }
 
 static ADDRESS *mutt_expand_aliases_r (ADDRESS *a, LIST **expn)
@@ -227,7 +235,7 @@ static void recode_buf (char *buf, size_t buflen)
 
 void mutt_create_alias (ENVELOPE *cur, ADDRESS *iadr)
 {
-  ALIAS *new, *t;
+  ALIAS *new;
   char buf[LONG_STRING], tmp[LONG_STRING], prompt[SHORT_STRING], *pc;
   char *err = NULL;
   char fixed[LONG_STRING];
@@ -333,15 +341,7 @@ retry_name:
   }
 
   mutt_alias_add_reverse (new);
-  
-  if ((t = Aliases))
-  {
-    while (t->next)
-      t = t->next;
-    t->next = new;
-  }
-  else
-    Aliases = new;
+  mutt_alias_append (new);
 
   strfcpy (buf, NONULL (AliasFile), sizeof (buf));
   if (mutt_get_field (_("Save to file: "), buf, sizeof (buf), M_FILE) != 0)
@@ -475,6 +475,101 @@ void mutt_alias_delete_reverse (ALIAS *t)
   }
 }
 
+/* Add t at the end of the aliases.  Alias names are unique regardless
+ * of case, so its name is only entered if no other has it yet. */
+void mutt_alias_append (ALIAS *t)
+{
+  ALIAS *a;
+
+  if (!t)
+    return;
+
+  if (!Aliases)
+    Aliases = t;
+  else
+  {
+    for (a = LastAlias ? LastAlias : Aliases; a->next; a = a->next)
+      ;
+    a->next = t;
+  }
+  LastAlias = t;
+
+  if (t->name)
+    hash_insert (AliasNames, t->name, t, 0);
+  SortedAliasesValid = 0;
+}
+
+/* Forget the alias t, which is being freed. */
+void mutt_alias_delete_name (ALIAS *t)
+{
+  if (!t)
+    return;
+
+  if (t == LastAlias)
+    LastAlias = NULL;
+  if (t->name)
+    hash_delete (AliasNames, t->name, t, NULL);
+  SortedAliasesValid = 0;
+}
+
+static int alias_sort_name (const void *a, const void *b)
+{
+  return mutt_strcmp ((*(ALIAS **) a)->name, (*(ALIAS **) b)->name);
+}
+
+static void alias_sort (void)
+{
+  ALIAS *a;
+  int n = 0;
+
+  if (SortedAliasesValid)
+    return;
+
+  for (a = Aliases; a; a = a->next)
+    if (a->name)
+      n++;
+
+  FREE (&SortedAliases);
+  SortedAliases = safe_calloc (n ? n : 1, sizeof (ALIAS *));
+  for (n = 0, a = Aliases; a; a = a->next)
+    if (a->name)
+      SortedAliases[n++] = a;
+  NumSortedAliases = n;
+
+  qsort (SortedAliases, n, sizeof (ALIAS *), alias_sort_name);
+  SortedAliasesValid = 1;
+}
+
+/* The range [*first, *last) of the sorted aliases whose name starts
+ * with s, in the same byte order as strcmp(). */
+static void alias_prefix_range (const char *s, int *first, int *last)
+{
+  size_t len = mutt_strlen (s);
+  int lo, hi, mid;
+
+  alias_sort ();
+
+  for (lo = 0, hi = NumSortedAliases; lo < hi; )
+  {
+    mid = (lo + hi) / 2;
+    if (strncmp (SortedAliases[mid]->name, s, len) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *first = lo;
+
+  for (hi = NumSortedAliases; lo < hi; )
+  {
+    mid = (lo + hi) / 2;
+    if (strncmp (SortedAliases[mid]->name, s, len) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *last = lo;
+}
+
 /* alias_complete() -- alias completion routine
  *
  * given a partial alias, this routine attempts to fill in the alias
@@ -486,7 +581,7 @@ int mutt_alias_complete (char *s, size_t buflen)
   ALIAS *a = Aliases;
   ALIAS *a_list = NULL, *a_cur = NULL;
   char bestname[HUGE_STRING];
-  int i;
+  int i, first, last;
 
 #ifndef min
 #define min(a,b)        ((a<b)?a:b)
@@ -496,21 +591,18 @@ int mutt_alias_complete (char *s, size_t buflen)
   {
     memset (bestname, 0, sizeof (bestname));
 
-    while (a)
+    /* the longest prefix common to all matches is the one common to
+     * the first and last of them in sorted order */
+    alias_prefix_range (s, &first, &last);
+    if (first < last)
     {
-      if (a->name && strstr (a->name, s) == a->name)
-      {
-	if (!bestname[0]) /* init */
-	  strfcpy (bestname, a->name,
-		   min (mutt_strlen (a->name) + 1, sizeof (bestname)));
-	else
-	{
-	  for (i = 0 ; a->name[i] && a->name[i] == bestname[i] ; i++)
-	    ;
-	  bestname[i] = 0;
-	}
-      }
-      a = a->next;
+      a = SortedAliases[first];
+      strfcpy (bestname, a->name,
+	       min (mutt_strlen (a->name) + 1, sizeof (bestname)));
+      a = SortedAliases[last - 1];
+      for (i = 0 ; a->name[i] && a->name[i] == bestname[i] ; i++)
+	;
+      bestname[i] = 0;
     }
 
     if (bestname[0] != 0)
@@ -22,9 +22,13 @@
 #endif				/* HAVE_CONFIG_H */
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <utime.h>
 
 #include "mutt.h"
 #include "account.h"
@@ -38,6 +42,29 @@ struct body_cache {
   size_t pathlen;
 };
 
+/* an entry found while scanning $message_cachedir for eviction */
+typedef struct
+{
+  char *path;
+  time_t mtime;
+  LOFF_T size;
+} bcache_entry_t;
+
+/* $message_cache_size and $message_cache_age apply to the whole
+ * $message_cachedir, so this is shared by all open caches. The entries'
+ * mtime doubles as their last access time: mutt_bcache_get() touches
+ * every entry it returns. */
+static struct
+{
+  LOFF_T used;		/* bytes in the cache, -1 until the first scan */
+  time_t scanned;	/* time of the last scan */
+} Usage = { -1, 0 };
+
+static BCACHE_STATS Stats;
+
+/* don't rescan the cache just for $message_cache_age more often than this */
+#define BCACHE_AGE_INTERVAL 3600
+
 static int bcache_path(ACCOUNT *account, const char *mailbox,
 		       char *dst, size_t dstlen)
 {
@@ -123,6 +150,21 @@ FILE* mutt_bcache_get(body_cache_t *bcache, const char *id)
 
   dprint (3, (debugfile, "bcache: get: '%s': %s\n", path, fp == NULL ? "no" : "yes"));
 
+  if (fp)
+  {
+    struct stat st;
+
+    Stats.hits++;
+    if (fstat (fileno (fp), &st) == 0)
+      Stats.bytes_read += st.st_size;
+    /* mark as recently used for eviction */
+    if ((MessageCacheSize || MessageCacheAge) && utime (path, NULL) < 0)
+      dprint (2, (debugfile, "bcache: get: utime '%s': %s\n", path,
+		  strerror (errno)));
+  }
+  else
+    Stats.misses++;
+
   return fp;
 }
 
@@ -136,8 +178,9 @@ FILE* mutt_bcache_put(body_cache_t *bcache, const char *id, int tmp)
   if (!id || !*id || !bcache)
     return NULL;
 
-  snprintf (path, sizeof (path), "%s%s%s", bcache->path, id,
-            tmp ? ".tmp" : "");
+  if (snprintf (path, sizeof (path), "%s%s%s", bcache->path, id,
+		tmp ? ".tmp" : "") >= sizeof (path))
+    return NULL;
 
   if ((fp = safe_fopen (path, "w+")))
     goto out;
@@ -163,13 +206,183 @@ FILE* mutt_bcache_put(body_cache_t *bcache, const char *id, int tmp)
   return fp;
 }
 
+static int bcache_entry_cmp (const void *a, const void *b)
+{
+  time_t ta = ((const bcache_entry_t *) a)->mtime;
+  time_t tb = ((const bcache_entry_t *) b)->mtime;
+
+  return ta < tb ? -1 : ta > tb;
+}
+
+/* bcache_account_dir: whether name, an entry of $message_cachedir, is
+ * one of the per-account directories bcache_path() creates */
+static int bcache_account_dir (const char *name)
+{
+  switch (url_check_scheme (name))
+  {
+    case U_IMAP:
+    case U_IMAPS:
+    case U_POP:
+    case U_POPS:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* bcache_foreign: whether the file name below an account directory
+ * belongs to the header cache, which may share $message_cachedir
+ * (see imap_hcache_namer() and pop_hcache_namer()) */
+static int bcache_foreign (const char *name, size_t len)
+{
+  return (len > 7 && !mutt_strcmp (name + len - 7, ".hcache")) ||
+    (len > 10 && !mutt_strcmp (name + len - 10, "-lock-hack"));
+}
+
+/* bcache_scan: collect the cached messages below dir into *entries.
+ * Returns the total size of the files found. Only the account
+ * directories are searched at the top level, and header cache files
+ * and temporary files of messages still being downloaded are left
+ * alone. */
+static LOFF_T bcache_scan (const char *dir, int top, bcache_entry_t **entries,
+			   size_t *count, size_t *max, time_t now)
+{
+  DIR *d;
+  struct dirent *de;
+  struct stat st;
+  char path[_POSIX_PATH_MAX];
+  LOFF_T total = 0;
+  size_t len;
+
+  if (!(d = opendir (dir)))
+    return 0;
+
+  while ((de = readdir (d)))
+  {
+    if (!mutt_strcmp (de->d_name, ".") || !mutt_strcmp (de->d_name, ".."))
+      continue;
+    if (top && !bcache_account_dir (de->d_name))
+      continue;
+
+    if (snprintf (path, sizeof (path), "%s/%s", dir,
+		  de->d_name) >= sizeof (path) ||
+	lstat (path, &st) < 0)
+      continue;
+
+    if (S_ISDIR (st.st_mode))
+    {
+      total += bcache_scan (path, 0, entries, count, max, now);
+      continue;
+    }
+    if (top || !S_ISREG (st.st_mode))
+      continue;
+
+    len = mutt_strlen (de->d_name);
+    if (bcache_foreign (de->d_name, len))
+      continue;
+    if (len > 4 && !mutt_strcmp (de->d_name + len - 4, ".tmp") &&
+	now - st.st_mtime < BCACHE_AGE_INTERVAL)
+      continue;
+
+    if (*count == *max)
+    {
+      *max += 256;
+      safe_realloc (entries, *max * sizeof (bcache_entry_t));
+    }
+    (*entries)[*count].path = safe_strdup (path);
+    (*entries)[*count].mtime = st.st_mtime;
+    (*entries)[*count].size = st.st_size;
+    (*count)++;
+    total += st.st_size;
+  }
+
+  closedir (d);
+
+  return total;
+}
+
+/* bcache_expire: remove entries older than $message_cache_age, then the
+ * least recently used ones until the cache is below 90% of
+ * $message_cache_size. */
+static void bcache_expire (void)
+{
+  bcache_entry_t *entries = NULL;
+  size_t count = 0, max = 0, i;
+  time_t now = time (NULL);
+  time_t cutoff = MessageCacheAge > 0 ? now - MessageCacheAge * 86400 : 0;
+  LOFF_T limit = MessageCacheSize > 0 ? (LOFF_T) MessageCacheSize << 20 : 0;
+  LOFF_T target = limit / 10 * 9;
+  LOFF_T total;
+  unsigned long evicted = Stats.evictions;
+
+  total = bcache_scan (MessageCachedir, 1, &entries, &count, &max, now);
+  qsort (entries, count, sizeof (bcache_entry_t), bcache_entry_cmp);
+
+  for (i = 0; i < count; i++)
+  {
+    /* entries are sorted oldest first */
+    if (entries[i].mtime >= cutoff && (!limit || total <= target))
+      break;
+    if (unlink (entries[i].path) < 0)
+      continue;
+    dprint (3, (debugfile, "bcache: expire: '%s'\n", entries[i].path));
+    total -= entries[i].size;
+    Stats.evictions++;
+    Stats.bytes_evicted += entries[i].size;
+  }
+
+  for (i = 0; i < count; i++)
+    FREE (&entries[i].path);
+  FREE (&entries);
+
+  Usage.used = total;
+  Usage.scanned = now;
+
+  dprint (2, (debugfile, "bcache: expire: %lu of %lu entries removed, "
+	      OFF_T_FMT " bytes left\n", Stats.evictions - evicted,
+	      (unsigned long) count, total));
+}
+
+/* bcache_account: note that delta bytes were added to (or removed from)
+ * the cache, and evict entries if that puts it over its limits */
+static void bcache_account (LOFF_T delta)
+{
+  if (!MessageCacheSize && !MessageCacheAge)
+  {
+    /* unbounded: stop tracking, the size may be stale when limits are set */
+    Usage.used = -1;
+    return;
+  }
+
+  if (Usage.used >= 0)
+    Usage.used += delta;
+
+  if (Usage.used < 0 ||
+      (MessageCacheSize > 0 && Usage.used > (LOFF_T) MessageCacheSize << 20) ||
+      (MessageCacheAge > 0 && time (NULL) - Usage.scanned > BCACHE_AGE_INTERVAL))
+    bcache_expire ();
+}
+
 int mutt_bcache_commit(body_cache_t* bcache, const char* id)
 {
   char tmpid[_POSIX_PATH_MAX];
+  char path[_POSIX_PATH_MAX];
+  struct stat st;
+  int rc;
 
-  snprintf (tmpid, sizeof (tmpid), "%s.tmp", id);
+  if (snprintf (tmpid, sizeof (tmpid), "%s.tmp", id) >= sizeof (tmpid))
+    return -1;
 
-  return mutt_bcache_move (bcache, tmpid, id);
+  if ((rc = mutt_bcache_move (bcache, tmpid, id)) == 0 &&
+      snprintf (path, sizeof (path), "%s%s", bcache->path,
+		id) < sizeof (path) &&
+      stat (path, &st) == 0)
+  {
+    Stats.bytes_written += st.st_size;
+    bcache_account (st.st_size);
+  }
+
+  return rc;
 }
 
 int mutt_bcache_move(body_cache_t* bcache, const char* id, const char* newid)
@@ -191,6 +404,7 @@ int mutt_bcache_move(body_cache_t* bcache, const char* id, const char* newid)
 int mutt_bcache_del(body_cache_t *bcache, const char *id)
 {
   char path[_POSIX_PATH_MAX];
+  struct stat st;
 
   if (!id || !*id || !bcache)
     return -1;
@@ -201,7 +415,14 @@ int mutt_bcache_del(body_cache_t *bcache, const char *id)
 
   dprint (3, (debugfile, "bcache: del: '%s'\n", path));
 
-  return unlink (path);
+  if (stat (path, &st) < 0)
+    return -1;
+  if (unlink (path) < 0)
+    return -1;
+  if (Usage.used >= 0)
+    Usage.used -= st.st_size;
+
+  return 0;
 }
 
 int mutt_bcache_exists(body_cache_t *bcache, const char *id)
@@ -265,3 +486,9 @@ out:
   dprint (3, (debugfile, "bcache: list: did %d entries\n", rc));
   return rc;
 }
+
+/* mutt_bcache_stats: copy the counters of all caches since startup */
+void mutt_bcache_stats (BCACHE_STATS *stats)
+{
+  memcpy (stats, &Stats, sizeof (BCACHE_STATS));
+}
@@ -26,6 +26,17 @@
 struct body_cache;
 typedef struct body_cache body_cache_t;
 
+/* counters for the whole cache, since startup */
+typedef struct
+{
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  unsigned long long bytes_read;	/* size of entries served from cache */
+  unsigned long long bytes_written;
+  unsigned long long bytes_evicted;
+} BCACHE_STATS;
+
 /*
  * Parameters:
  *   - 'account' is the current mailbox' account (required)
@@ -75,4 +86,6 @@ int mutt_bcache_list(body_cache_t *bcache,
 		     int (*want_id)(const char *id, body_cache_t *bcache,
 				    void *data), void *data);
 
+void mutt_bcache_stats (BCACHE_STATS *stats);
+
 #endif /* _BCACHE_H_ */
@@ -44,6 +44,8 @@ static time_t BuffyTime = 0;	/* last time we started checking for mail */
 time_t BuffyDoneTime = 0;	/* last time we knew for sure how much mail there was. */
 static short BuffyCount = 0;	/* how many boxes with new mail */
 static short BuffyNotify = 0;	/* # of unnotified new boxes */
+static HASH *BuffyPaths = NULL;	/* Incoming by realpath */
+static BUFFY **BuffyTail = NULL;	/* end of Incoming, if known */
 
 static BUFFY* buffy_get (const char *path);
 
@@ -207,16 +209,20 @@ static BUFFY *buffy_new (const char *path)
 
 static void buffy_free (BUFFY **mailbox)
 {
+  if (BuffyPaths)
+    hash_delete (BuffyPaths, (*mailbox)->realpath, *mailbox, NULL);
+  BuffyTail = NULL;
+  FREE (&(*mailbox)->realpath);
   FREE (mailbox); /* __FREE_CHECKED__ */
 }
 
 int mutt_parse_mailboxes (BUFFER *path, BUFFER *s, unsigned long data, BUFFER *err)
 {
-  BUFFY **tmp,*tmp1;
+  BUFFY **tmp,*tmp1,*b;
   char buf[_POSIX_PATH_MAX];
   struct stat sb;
-  char f1[PATH_MAX], f2[PATH_MAX];
-  char *p, *q;
+  char f1[PATH_MAX];
+  char *p;
 
   while (MoreArgs (s))
   {
@@ -240,21 +246,19 @@ int mutt_parse_mailboxes (BUFFER *path, BUFFER *s, unsigned long data, BUFFER *e
     if(!*buf) continue;
 
     /* avoid duplicates */
-    p = realpath (buf, f1);
-    for (tmp = &Incoming; *tmp; tmp = &((*tmp)->next))
-    {
-      q = realpath ((*tmp)->path, f2);
-      if (mutt_strcmp (p ? p : buf, q ? q : (*tmp)->path) == 0)
-      {
-	dprint(3,(debugfile,"mailbox '%s' already registered as '%s'\n", buf, (*tmp)->path));
-	break;
-      }
-    }
+    if (!(p = realpath (buf, f1)))
+      p = buf;
+    if (!BuffyPaths)
+      BuffyPaths = hash_create (1031, 0);
+    if ((b = hash_find (BuffyPaths, p)))
+      dprint(3,(debugfile,"mailbox '%s' already registered as '%s'\n", buf, b->path));
 
     if(data == M_UNMAILBOXES)
     {
-      if(*tmp)
+      if(b)
       {
+	for (tmp = &Incoming; *tmp != b; tmp = &((*tmp)->next))
+	  ;
         tmp1=(*tmp)->next;
         buffy_free (tmp);
         *tmp=tmp1;
@@ -262,25 +266,33 @@ int mutt_parse_mailboxes (BUFFER *path, BUFFER *s, unsigned long data, BUFFER *e
       continue;
     }
 
-    if (!*tmp)
-      *tmp = buffy_new (buf);
+    if (!b)
+    {
+      if (!BuffyTail)
+	for (BuffyTail = &Incoming; *BuffyTail; BuffyTail = &((*BuffyTail)->next))
+	  ;
+      b = *BuffyTail = buffy_new (buf);
+      b->realpath = safe_strdup (p);
+      hash_insert (BuffyPaths, b->realpath, b, 0);
+      BuffyTail = &b->next;
+    }
 
-    (*tmp)->new = 0;
-    (*tmp)->notified = 1;
-    (*tmp)->newly_created = 0;
+    b->new = 0;
+    b->notified = 1;
+    b->newly_created = 0;
 
     /* for check_mbox_size, it is important that if the folder is new (tested by
      * reading it), the size is set to 0 so that later when we check we see
      * that it increased .  without check_mbox_size we probably don't care.
      */
     if (option(OPTCHECKMBOXSIZE) &&
-	stat ((*tmp)->path, &sb) == 0 && !test_new_folder ((*tmp)->path))
+	stat (b->path, &sb) == 0 && !test_new_folder (b->path))
     {
       /* some systems out there don't have an off_t type */
-      (*tmp)->size = (off_t) sb.st_size;
+      b->size = (off_t) sb.st_size;
     }
     else
-      (*tmp)->size = 0;
+      b->size = 0;
   }
   return 0;
 }
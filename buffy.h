@@ -23,6 +23,7 @@
 typedef struct buffy_t
 {
   char path[_POSIX_PATH_MAX];
+  char *realpath;		/* path with links resolved, when registered */
   off_t size;
   struct buffy_t *next;
   short new;			/* mailbox has new mail */
@@ -393,6 +393,123 @@ iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
 }
 
 
+/*
+ * A small pool of converters, keyed by the arguments to mutt_iconv_open(),
+ * so that callers converting many short strings (every RFC 2047 encoded
+ * word, for instance) don't pay for charset canonicalisation, hook lookup
+ * and iconv_open() each time. A converter is handed out to one user at a
+ * time, and reset to its initial state on reuse. Failures are cached as
+ * well, since unknown charsets tend to repeat.
+ */
+
+#define ICONV_CACHE_SIZE 16
+
+typedef struct
+{
+  char *tocode;
+  char *fromcode;
+  int flags;
+  iconv_t cd;
+  unsigned long used;		/* for LRU replacement */
+  unsigned int busy : 1;
+} ICONV_CACHE;
+
+static ICONV_CACHE IconvCache[ICONV_CACHE_SIZE];
+static unsigned long IconvCacheClock = 0;
+
+static void iconv_cache_free (ICONV_CACHE *ic)
+{
+  /* a converter in use is closed by mutt_iconv_cache_close() */
+  if (ic->tocode && ic->cd != (iconv_t)-1 && !ic->busy)
+    iconv_close (ic->cd);
+  FREE (&ic->tocode);
+  FREE (&ic->fromcode);
+  memset (ic, 0, sizeof (ICONV_CACHE));
+}
+
+/*
+ * Like mutt_iconv_open(), but the converter must be returned with
+ * mutt_iconv_cache_close() instead of iconv_close().
+ */
+iconv_t mutt_iconv_cache_open (const char *tocode, const char *fromcode, int flags)
+{
+  ICONV_CACHE *ic, *slot = NULL;
+  iconv_t cd;
+  int i;
+
+  for (i = 0; i < ICONV_CACHE_SIZE; i++)
+  {
+    ic = &IconvCache[i];
+    if (!ic->tocode)
+    {
+      if (!slot)
+	slot = ic;
+      continue;
+    }
+    if (ic->flags == flags && !ic->busy &&
+	!mutt_strcmp (ic->tocode, tocode) && !mutt_strcmp (ic->fromcode, fromcode))
+    {
+      ic->used = ++IconvCacheClock;
+      if (ic->cd != (iconv_t)-1)
+      {
+	iconv (ic->cd, NULL, NULL, NULL, NULL);
+	ic->busy = 1;
+      }
+      return ic->cd;
+    }
+    if (!ic->busy && (!slot || (slot->tocode && ic->used < slot->used)))
+      slot = ic;
+  }
+
+  cd = mutt_iconv_open (tocode, fromcode, flags);
+
+  /* all slots busy: the caller gets an uncached converter */
+  if (!slot)
+    return cd;
+
+  iconv_cache_free (slot);
+  slot->tocode = safe_strdup (tocode);
+  slot->fromcode = safe_strdup (fromcode);
+  slot->flags = flags;
+  slot->cd = cd;
+  slot->used = ++IconvCacheClock;
+  slot->busy = (cd != (iconv_t)-1);
+
+  return cd;
+}
+
+void mutt_iconv_cache_close (iconv_t cd)
+{
+  int i;
+
+  if (cd == (iconv_t)-1)
+    return;
+
+  for (i = 0; i < ICONV_CACHE_SIZE; i++)
+    if (IconvCache[i].busy && IconvCache[i].cd == cd)
+    {
+      IconvCache[i].busy = 0;
+      return;
+    }
+
+  iconv_close (cd);
+}
+
+/*
+ * Forget all cached converters. Must be called when charset-hooks or
+ * iconv-hooks change, since those determine what the cached converters
+ * were opened with.
+ */
+void mutt_iconv_cache_flush (void)
+{
+  int i;
+
+  for (i = 0; i < ICONV_CACHE_SIZE; i++)
+    if (IconvCache[i].tocode)
+      iconv_cache_free (&IconvCache[i]);
+}
+
+
 /*
  * Like iconv, but keeps going even when the input is invalid
  * If you're supplying inrepls, the source charset should be stateless;
@@ -481,7 +598,7 @@ int mutt_convert_string (char **ps, const char *from, const char *to, int flags)
   if (!s || !*s)
     return 0;
 
-  if (to && from && (cd = mutt_iconv_open (to, from, flags)) != (iconv_t)-1)
+  if (to && from && (cd = mutt_iconv_cache_open (to, from, flags)) != (iconv_t)-1)
   {
     int len;
     ICONV_CONST char *ib;
@@ -503,7 +620,7 @@ int mutt_convert_string (char **ps, const char *from, const char *to, int flags)
     ob = buf = safe_malloc (obl + 1);
     
     mutt_iconv (cd, &ib, &ibl, &ob, &obl, inrepls, outrepl);
-    iconv_close (cd);
+    mutt_iconv_cache_close (cd);
 
     *ob = '\0';
 
@@ -553,7 +670,7 @@ FGETCONV *fgetconv_open (FILE *file, const char *from, const char *to, int flags
   static ICONV_CONST char *repls[] = { "\357\277\275", "?", 0 };
 
   if (from && to)
-    cd = mutt_iconv_open (to, from, flags);
+    cd = mutt_iconv_cache_open (to, from, flags);
 
   if (cd != (iconv_t)-1)
   {
@@ -648,8 +765,7 @@ void fgetconv_close (FGETCONV **_fc)
 {
   struct fgetconv_s *fc = (struct fgetconv_s *) *_fc;
 
-  if (fc->cd != (iconv_t)-1)
-    iconv_close (fc->cd);
+  mutt_iconv_cache_close (fc->cd);
   FREE (_fc);		/* __FREE_CHECKED__ */
 }
 
@@ -37,6 +37,9 @@ int iconv_close (iconv_t);
 int mutt_convert_string (char **, const char *, const char *, int);
 
 iconv_t mutt_iconv_open (const char *, const char *, int);
+iconv_t mutt_iconv_cache_open (const char *, const char *, int);
+void mutt_iconv_cache_close (iconv_t);
+void mutt_iconv_cache_flush (void);
 size_t mutt_iconv (iconv_t, ICONV_CONST char **, size_t *, char **, size_t *, ICONV_CONST char **, const char *);
 
 typedef void * FGETCONV;
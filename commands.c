@@ -701,6 +701,13 @@ static void set_copy_flags (HEADER *hdr, int decode, int decrypt, int *cmflags,
   }
 }
 
+static void set_saved_flags (HEADER *h)
+{
+  mutt_set_flag (Context, h, M_DELETE, 1);
+  if (option (OPTDELETEUNTAG))
+    mutt_set_flag (Context, h, M_TAG, 0);
+}
+
 int _mutt_save_message (HEADER *h, CONTEXT *ctx, int delete, int decode, int decrypt)
 {
   int cmflags, chflags;
@@ -715,11 +722,7 @@ int _mutt_save_message (HEADER *h, CONTEXT *ctx, int delete, int decode, int dec
     return rc;
 
   if (delete)
-  {
-    mutt_set_flag (Context, h, M_DELETE, 1);
-    if (option (OPTDELETEUNTAG))
-      mutt_set_flag (Context, h, M_TAG, 0);
-  }
+    set_saved_flags (h);
   
   return 0;
 }
@@ -730,6 +733,7 @@ int mutt_save_message (HEADER *h, int delete,
 {
   int i, need_buffy_cleanup;
   int need_passphrase = 0, app=0;
+  int attach_del_only = 0;
   char prompt[SHORT_STRING], buf[_POSIX_PATH_MAX];
   CONTEXT ctx;
   struct stat st;
@@ -828,6 +832,8 @@ int mutt_save_message (HEADER *h, int delete,
       case 0: mutt_clear_error (); return 0;
       /* non-fatal error: fall through to fetch/append */
       case 1: break;
+      /* copied all but messages with attachments to delete: append those */
+      case 2: attach_del_only = 1; break;
       /* fatal error, abort */
       case -1: return -1;
     }
@@ -846,18 +852,71 @@ int mutt_save_message (HEADER *h, int delete,
     }
     else
     {
+      HEADER **saved = NULL;	/* sent, but not yet marked for deletion */
+      int nsaved = 0, batch = 0, rc = 0, j;
+
+#ifdef USE_IMAP
+      /* let the IMAP code send the messages in MULTIAPPEND batches. The
+       * originals may be deleted only once the server has them. */
+      if (ctx.magic == M_IMAP)
+      {
+	imap_append_batch (&ctx, 1);
+	batch = 1;
+	if (delete)
+	  saved = safe_calloc (Context->vcount, sizeof (HEADER *));
+      }
+#endif
+
       for (i = 0; i < Context->vcount; i++)
       {
-	if (Context->hdrs[Context->v2r[i]]->tagged)
+	if (Context->hdrs[Context->v2r[i]]->tagged &&
+	    (!attach_del_only || Context->hdrs[Context->v2r[i]]->attach_del))
 	{
 	  mutt_message_hook (Context, Context->hdrs[Context->v2r[i]], M_MESSAGEHOOK);
 	  if (_mutt_save_message(Context->hdrs[Context->v2r[i]],
-			     &ctx, delete, decode, decrypt) != 0)
+			     &ctx, delete && !batch, decode, decrypt) != 0)
           {
-            mx_close_mailbox (&ctx, NULL);
-            return -1;
+	    nsaved = 0;
+	    rc = -1;
+	    break;
           }
+#ifdef USE_IMAP
+	  if (saved)
+	  {
+	    saved[nsaved++] = Context->hdrs[Context->v2r[i]];
+	    if (!imap_append_pending (&ctx))
+	    {
+	      for (j = 0; j < nsaved; j++)
+		set_saved_flags (saved[j]);
+	      nsaved = 0;
+	    }
+	  }
+#endif
+	}
+      }
+
+#ifdef USE_IMAP
+      /* send the rest before any more originals are marked, and stop
+       * batching: later saves, Fcc and postponing may use the same
+       * connection and must not be left queued */
+      if (batch)
+      {
+	if (imap_append_flush (&ctx) < 0)
+	{
+	  nsaved = 0;
+	  rc = -1;
 	}
+	imap_append_batch (&ctx, 0);
+      }
+#endif
+      for (j = 0; j < nsaved; j++)
+	set_saved_flags (saved[j]);
+      FREE (&saved);
+
+      if (rc != 0)
+      {
+	mx_close_mailbox (&ctx, NULL);
+	return -1;
       }
     }
 
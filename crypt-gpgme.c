@@ -682,6 +682,7 @@ static gpgme_key_t *create_recipient_set (const char *keylist,
 	      {
 		mutt_error (_("error adding recipient `%s': %s\n"),
 			    buf, gpgme_strerror (err));
+		safe_realloc (&rset, sizeof (*rset) * (rset_n + 1));
 		rset[rset_n] = NULL;
 		free_recipient_set (&rset);
 		gpgme_release (context);
@@ -3940,6 +3941,160 @@ static LIST *crypt_add_string_to_hints (LIST *hints, const char *str)
   return hints;
 }
 
+/* The keys found for addresses without asking, kept so that checking
+   for opportunistic encryption after every edit of the recipients
+   doesn't list the keyring again.  They are dropped when the keyring
+   files change, or after a while since validity also changes with time
+   alone. */
+#define KEY_CACHE_TTL 300
+
+struct key_cache
+{
+  char *mailbox;
+  char *personal;
+  unsigned int app;
+  short abilities;
+  crypt_key_t *key;  /* NULL if no key could be determined */
+  struct key_cache *next;
+};
+
+static struct key_cache *key_cache = NULL;
+static time_t key_cache_time;
+static time_t key_cache_mtime[CRYPT_KEYRING_FILES];
+static off_t key_cache_size[CRYPT_KEYRING_FILES];
+
+/* The candidates of one keylist pass for all the recipients find_keys()
+   looks for, and the hints it was made with. */
+static crypt_key_t *batch_keys = NULL;
+static LIST *batch_hints = NULL;
+static unsigned int batch_app;
+
+static void key_cache_free (void)
+{
+  struct key_cache *c;
+
+  while ((c = key_cache))
+    {
+      key_cache = c->next;
+      FREE (&c->mailbox);
+      FREE (&c->personal);
+      crypt_free_key (&c->key);
+      FREE (&c);
+    }
+}
+
+/* Drop the cached keys if the keyring changed or they are too old. */
+static void key_cache_check (void)
+{
+  time_t mtime[CRYPT_KEYRING_FILES];
+  off_t size[CRYPT_KEYRING_FILES];
+  time_t now = time (NULL);
+
+  if (crypt_stat_keyring (mtime, size) < 0)
+    {
+      memset (mtime, 0, sizeof (mtime));
+      memset (size, 0, sizeof (size));
+    }
+
+  if (now - key_cache_time > KEY_CACHE_TTL
+      || memcmp (mtime, key_cache_mtime, sizeof (mtime))
+      || memcmp (size, key_cache_size, sizeof (size)))
+    {
+      key_cache_free ();
+      key_cache_time = now;
+      memcpy (key_cache_mtime, mtime, sizeof (mtime));
+      memcpy (key_cache_size, size, sizeof (size));
+    }
+}
+
+static struct key_cache *key_cache_find (ADDRESS *a, unsigned int app,
+                                         short abilities)
+{
+  struct key_cache *c;
+
+  for (c = key_cache; c; c = c->next)
+    if (c->app == app && c->abilities == abilities
+        && !mutt_strcasecmp (c->mailbox, a->mailbox)
+        && !mutt_strcasecmp (c->personal, a->personal))
+      return c;
+  return NULL;
+}
+
+static void key_cache_add (ADDRESS *a, unsigned int app, short abilities,
+                           crypt_key_t *key)
+{
+  struct key_cache *c;
+
+  c = safe_calloc (1, sizeof *c);
+  c->mailbox = safe_strdup (a->mailbox);
+  c->personal = safe_strdup (a->personal);
+  c->app = app;
+  c->abilities = abilities;
+  c->key = key ? crypt_copy_key (key) : NULL;
+  c->next = key_cache;
+  key_cache = c;
+}
+
+static LIST *address_hints (ADDRESS *a)
+{
+  LIST *hints = NULL;
+
+  if (a && a->mailbox)
+    hints = crypt_add_string_to_hints (hints, a->mailbox);
+  if (a && a->personal)
+    hints = crypt_add_string_to_hints (hints, a->personal);
+  return hints;
+}
+
+/* List the keys for all of ADRLIST that aren't cached in one pass.
+   Keys for an address are those with a user ID that has its mailbox or
+   name, so the same keys are found among the candidates for all hints
+   as among those for its own. */
+static void batch_start (ADDRESS *adrlist, unsigned int app, int oppenc_mode)
+{
+  LIST *hints, *h;
+  ADDRESS *p;
+  int n = 0;
+
+  for (p = adrlist; p; p = p->next)
+    {
+      if (oppenc_mode && key_cache_find (p, app, KEYFLAG_CANENCRYPT))
+        continue;
+      if (!(hints = address_hints (p)))
+        continue;
+      for (h = hints; h; h = h->next)
+        if (!mutt_find_list (batch_hints, h->data))
+          batch_hints = mutt_add_list (batch_hints, h->data);
+      mutt_free_list (&hints);
+      n++;
+    }
+
+  if (n > 1)
+    {
+      batch_app = app;
+      batch_keys = get_candidates (batch_hints, app, 0);
+    }
+  else
+    mutt_free_list (&batch_hints);
+}
+
+static void batch_end (void)
+{
+  crypt_free_key (&batch_keys);
+  mutt_free_list (&batch_hints);
+}
+
+/* Whether the batch has the candidates for HINTS. */
+static int batch_covers (LIST *hints, unsigned int app, int secret)
+{
+  if (!batch_hints || !hints || secret || app != batch_app)
+    return 0;
+  for (; hints; hints = hints->next)
+    if (!mutt_find_list (batch_hints, hints->data))
+      return 0;
+  return 1;
+}
+
 /* Display a menu to select a key from the array KEYS. FORCED_VALID
    will be set to true on return if the user did override the the
    key's validity. */
@@ -4164,22 +4319,31 @@ static crypt_key_t *crypt_getkeybyaddr (ADDRESS * a, short abilities,
   crypt_key_t *a_valid_addrmatch_key = NULL;
   crypt_key_t *matches = NULL;
   crypt_key_t **matches_endp = &matches;
+  struct key_cache *cached;
+  int from_batch;
   
   *forced_valid = 0;
 
-  if (a && a->mailbox)
-    hints = crypt_add_string_to_hints (hints, a->mailbox);
-  if (a && a->personal)
-    hints = crypt_add_string_to_hints (hints, a->personal);
+  if (oppenc_mode && (cached = key_cache_find (a, app, abilities)))
+    return cached->key ? crypt_copy_key (cached->key) : NULL;
+
+  hints = address_hints (a);
 
   if (! oppenc_mode )
     mutt_message (_("Looking for keys matching \"%s\"..."), a->mailbox);
-  keys = get_candidates (hints, app, (abilities & KEYFLAG_CANSIGN) );
+  if ((from_batch = batch_covers (hints, app, (abilities & KEYFLAG_CANSIGN))))
+    keys = batch_keys;
+  else
+    keys = get_candidates (hints, app, (abilities & KEYFLAG_CANSIGN) );
 
   mutt_free_list (&hints);
   
   if (!keys)
-    return NULL;
+    {
+      if (oppenc_mode)
+        key_cache_add (a, app, abilities, NULL);
+      return NULL;
+    }
   
   dprint (5, (debugfile, "crypt_getkeybyaddr: looking for %s <%s>.",
 	      a->personal, a->mailbox));
@@ -4255,7 +4419,8 @@ static crypt_key_t *crypt_getkeybyaddr (ADDRESS * a, short abilities,
         }
     }
   
-  crypt_free_key (&keys);
+  if (!from_batch)
+    crypt_free_key (&keys);
   
   if (matches)
     {
@@ -4292,6 +4457,9 @@ static crypt_key_t *crypt_getkeybyaddr (ADDRESS * a, short abilities,
     }
   else 
     k = NULL;
+
+  if (oppenc_mode)
+    key_cache_add (a, app, abilities, k);
   
   return k;
 }
@@ -4425,7 +4593,7 @@ static crypt_key_t *crypt_ask_for_key (char *tag,
    message.  It returns NULL if any of the keys can not be found.
    If oppenc_mode is true, only keys that can be determined without
    prompting will be used.  */
-static char *find_keys (ADDRESS *adrlist, unsigned int app, int oppenc_mode)
+static char *lookup_keys (ADDRESS *adrlist, unsigned int app, int oppenc_mode)
 {
   LIST *crypt_hook_list, *crypt_hook = NULL;
   char *crypt_hook_val = NULL;
@@ -4573,6 +4741,20 @@ static char *find_keys (ADDRESS *adrlist, unsigned int app, int oppenc_mode)
   return (keylist);
 }
 
+/* Find the keyids of the recipients with one keylist pass for those
+   whose keys aren't cached. */
+static char *find_keys (ADDRESS *adrlist, unsigned int app, int oppenc_mode)
+{
+  char *keylist;
+
+  key_cache_check ();
+  batch_start (adrlist, app, oppenc_mode);
+  keylist = lookup_keys (adrlist, app, oppenc_mode);
+  batch_end ();
+
+  return keylist;
+}
+
 char *pgp_gpgme_findkeys (ADDRESS *adrlist, int oppenc_mode)
 {
   return find_keys (adrlist, APPLICATION_PGP, oppenc_mode);
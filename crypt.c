@@ -1115,3 +1115,44 @@ short crypt_is_numerical_keyid (const char *s)
 }
 
 
+/*
+ * Used by the key lookups of both backends to tell when what they
+ * keep of the keyrings is out of date.
+ */
+
+static const char *KeyringFiles[CRYPT_KEYRING_FILES] =
+{
+  "pubring.kbx", "pubring.gpg", "secring.gpg", "trustdb.gpg",
+  "private-keys-v1.d", "trustlist.txt"
+};
+
+int crypt_stat_keyring (time_t *mtime, off_t *size)
+{
+  char path[_POSIX_PATH_MAX], home[_POSIX_PATH_MAX];
+  struct stat st;
+  int i, found = 0;
+
+  if (getenv ("GNUPGHOME"))
+    strfcpy (home, getenv ("GNUPGHOME"), sizeof (home));
+  else
+    snprintf (home, sizeof (home), "%s/.gnupg", NONULL (Homedir));
+
+  for (i = 0; i < CRYPT_KEYRING_FILES; i++)
+  {
+    if (snprintf (path, sizeof (path), "%s/%s", home,
+		  KeyringFiles[i]) < sizeof (path) &&
+	stat (path, &st) == 0)
+    {
+      mtime[i] = st.st_mtime;
+      size[i] = st.st_size;
+      found = 1;
+    }
+    else
+    {
+      mtime[i] = 0;
+      size[i] = -1;
+    }
+  }
+
+  return found ? 0 : -1;
+}
@@ -27,6 +27,7 @@
 #include "mapping.h"
 #include "sort.h"
 #include "mx.h"
+#include "timing.h"
 
 #ifdef USE_POP
 #include "pop.h"
@@ -190,6 +191,16 @@ void mutt_ts_icon(char *str)
   fprintf(stderr, "\033]1;%s\007", str);
 }
 
+#ifdef USE_IMAP
+/* headers read with $imap_lazy_headers get their envelopes once they are
+ * drawn, along with those of a screenful before and after */
+static void index_read_envelopes (HEADER *h, int num)
+{
+  if (Context->magic == M_IMAP)
+    imap_read_envelopes (Context, h, num - LINES, num + 2 * LINES);
+}
+#endif
+
 void index_make_entry (char *s, size_t l, MUTTMENU *menu, int num)
 {
   format_flag flag = M_FORMAT_MAKEPRINT | M_FORMAT_ARROWCURSOR | M_FORMAT_INDEX;
@@ -197,6 +208,10 @@ void index_make_entry (char *s, size_t l, MUTTMENU *menu, int num)
   HEADER *h = Context->hdrs[Context->v2r[num]];
   THREAD *tmp;
 
+#ifdef USE_IMAP
+  index_read_envelopes (h, num);
+#endif
+
   if ((Sort & SORT_MASK) == SORT_THREADS && h->tree)
   {
     flag |= M_FORMAT_TREE; /* display the thread tree */
@@ -256,6 +271,10 @@ int index_color (int index_no)
 {
   HEADER *h = Context->hdrs[Context->v2r[index_no]];
 
+#ifdef USE_IMAP
+  index_read_envelopes (h, index_no);
+#endif
+
   if (h && h->pair)
     return h->pair;
 
@@ -493,6 +512,7 @@ static const struct mapping_t IndexHelp[] = {
   { NULL,	 0 }
 };
 
+#ifdef USE_LIBNOTIFY
 int mutt_libnotify_notify(char* message) {
   notify_init ("Mutt");
   NotifyNotification * Mutt = notify_notification_new ("Mutt", message, "dialog-information");
@@ -502,6 +522,7 @@ int mutt_libnotify_notify(char* message) {
 
   return 0;
 }
+#endif
 
 /* This function handles the message index window as well as commands returned
  * from the pager (MENU_PAGER).
@@ -576,7 +597,8 @@ int mutt_index_menu (void)
 
 	set_option (OPTSEARCHINVALID);
       }
-      else if (check == M_NEW_MAIL || check == M_REOPENED || check == M_FLAGS)
+      else if (check == M_NEW_MAIL || check == M_REOPENED || check == M_FLAGS ||
+	       check == M_MOVED)
       {
 	update_index (menu, Context, check, oldcount, index_hint);
 
@@ -588,8 +610,10 @@ int mutt_index_menu (void)
 	  mutt_message _("New mail in this mailbox.");
 	  if (option (OPTBEEPNEW))
 	    beep ();
+#ifdef USE_LIBNOTIFY
 	  if (option (OPTLIBNOTIFYNEW))
 	    mutt_libnotify_notify("New mail in this mailbox");
+#endif
 	} else if (check == M_FLAGS)
 	  mutt_message _("Mailbox was externally modified.");
 
@@ -635,7 +659,10 @@ int mutt_index_menu (void)
 
 	if (menu->redraw & REDRAW_INDEX)
 	{
+	  timing_t start = mutt_timing_now ();
+
 	  menu_redraw_index (menu);
+	  mutt_timing_add (TIMING_INDEX_DRAW, start, menu->pagelen);
 	  menu->redraw |= REDRAW_STATUS;
 	}
 	else if (menu->redraw & (REDRAW_MOTION_RESYNCH | REDRAW_MOTION))
@@ -762,6 +789,12 @@ int mutt_index_menu (void)
 	}
       }
 
+#ifdef USE_IMAP
+      /* tagged messages need not have been drawn yet */
+      if (tag)
+	imap_read_tagged_envelopes (Context, NULL);
+#endif
+
       mutt_clear_error ();
     }
     else
@@ -2306,6 +2339,11 @@ int mutt_index_menu (void)
 	mutt_version ();
 	break;
 
+      case OP_SHOW_TIMING:
+	mutt_timing_show ();
+	menu->redraw = REDRAW_FULL;
+	break;
+
       case OP_BUFFY_LIST:
 	mutt_buffy_list ();
 	break;
@@ -46,16 +46,11 @@ static time_t compute_tz (time_t g, struct tm *utc)
   return t;
 }
 
-/* Returns the local timezone in seconds east of UTC for the time t,
- * or for the current time if t is zero.
- */
-time_t mutt_local_tz (time_t t)
+static time_t lookup_tz (time_t t)
 {
   struct tm *ptm;
   struct tm utc;
 
-  if (!t)
-    t = time (NULL);
   ptm = gmtime (&t);
   /* need to make a copy because gmtime/localtime return a pointer to
      static memory (grr!) */
@@ -63,6 +58,39 @@ time_t mutt_local_tz (time_t t)
   return (compute_tz (t, &utc));
 }
 
+/* returns the seconds east of UTC at the time t. Messages mostly come
+   in runs from the same few days, so the offset is remembered for the
+   (UTC) day of t when it is the same at its start and its end. */
+static time_t local_tz (time_t t)
+{
+  static time_t cached_day = -1;
+  static time_t cached_tz;
+  time_t day, first, last;
+
+  day = t / 86400 - (t % 86400 < 0);
+  if (day == cached_day)
+    return cached_tz;
+
+  first = lookup_tz (day * 86400);
+  last = lookup_tz (day * 86400 + 86399);
+  if (first != last)
+    return lookup_tz (t);	/* the clocks change on that day */
+
+  cached_day = day;
+  cached_tz = first;
+  return first;
+}
+
+/* Returns the local timezone in seconds east of UTC for the time t,
+ * or for the current time if t is zero.
+ */
+time_t mutt_local_tz (time_t t)
+{
+  if (!t)
+    t = time (NULL);
+  return (local_tz (t));
+}
+
 /* converts struct tm to time_t, but does not take the local timezone into
    account unless ``local'' is nonzero */
 time_t mutt_mktime (struct tm *t, int local)
@@ -100,7 +128,7 @@ time_t mutt_mktime (struct tm *t, int local)
   g += t->tm_sec;
 
   if (local)
-    g -= compute_tz (g, t);
+    g -= local_tz (g);
 
   return (g);
 }
@@ -55,4 +55,7 @@
 # ifndef USE_SASL
 #  define USE_SASL
 # endif
+# ifndef USE_ZLIB
+#  define USE_ZLIB
+# endif
 #endif
@@ -43,6 +43,18 @@ int mutt_check_month (const char *s)
   return (-1); /* error */
 }
 
+/* read the unsigned number at s, which is nearly always what From_ lines
+ * have where sscanf() would be asked for one. Returns where it ends, or
+ * NULL if s doesn't start with a digit. */
+static const char *scan_int (const char *s, int *n)
+{
+  if (!isdigit ((unsigned char) *s))
+    return NULL;
+  for (*n = 0; isdigit ((unsigned char) *s) && *n < 100000; s++)
+    *n = *n * 10 + (*s - '0');
+  return isdigit ((unsigned char) *s) ? NULL : s;
+}
+
 static int is_day_name (const char *s)
 {
   int i;
@@ -64,6 +76,7 @@ static int is_day_name (const char *s)
 int is_from (const char *s, char *path, size_t pathlen, time_t *tp)
 {
   struct tm tm;
+  const char *p;
   int yr;
 
   if (path)
@@ -80,7 +93,6 @@ int is_from (const char *s, char *path, size_t pathlen, time_t *tp)
 
   if (!is_day_name (s))
   {
-    const char *p;
     size_t len;
     short q = 0;
 
@@ -151,14 +163,20 @@ int is_from (const char *s, char *path, size_t pathlen, time_t *tp)
   /* day */
   s = next_word (s);
   if (!*s) return 0;
-  if (sscanf (s, "%d", &tm.tm_mday) != 1) return 0;
+  if (!scan_int (s, &tm.tm_mday) && sscanf (s, "%d", &tm.tm_mday) != 1)
+    return 0;
 
   /* time */
   s = next_word (s);
   if (!*s) return 0;
 
   /* Accept either HH:MM or HH:MM:SS */
-  if (sscanf (s, "%d:%d:%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 3);
+  tm.tm_sec = 0;
+  if ((p = scan_int (s, &tm.tm_hour)) && *p == ':' &&
+      (p = scan_int (p + 1, &tm.tm_min)) &&
+      (*p != ':' || scan_int (p + 1, &tm.tm_sec)))
+    ;
+  else if (sscanf (s, "%d:%d:%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 3);
   else if (sscanf (s, "%d:%d", &tm.tm_hour, &tm.tm_min) == 2)
     tm.tm_sec = 0;
   else
@@ -185,7 +203,7 @@ int is_from (const char *s, char *path, size_t pathlen, time_t *tp)
   }
 
   /* year */
-  if (sscanf (s, "%d", &yr) != 1) return 0;
+  if (!scan_int (s, &yr) && sscanf (s, "%d", &yr) != 1) return 0;
   tm.tm_year = yr > 1900 ? yr - 1900 : (yr < 70 ? yr + 100 : yr);
   
   dprint (3,(debugfile, "is_from(): month=%d, day=%d, hr=%d, min=%d, sec=%d, yr=%d.\n",
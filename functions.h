@@ -145,6 +145,7 @@ const struct binding_t OpMain[] = { /* map: index */
   { "undelete-thread",		OP_UNDELETE_THREAD,		"\025" },
   { "view-attachments",		OP_VIEW_ATTACHMENTS,		"v" },
   { "show-version",		OP_VERSION,			"V" },
+  { "show-timing",		OP_SHOW_TIMING,			NULL },
   { "set-flag",			OP_MAIN_SET_FLAG,		"w" },
   { "clear-flag",		OP_MAIN_CLEAR_FLAG,		"W" },
   { "display-message",		OP_DISPLAY_MESSAGE,		M_ENTER_S },
@@ -115,6 +115,7 @@ WHERE char *QueryCmd;
 WHERE char *QueryFormat;
 WHERE char *Realname;
 WHERE short SearchContext;
+WHERE char *SearchIndex;
 WHERE char *SendCharset;
 WHERE char *Sendmail;
 WHERE char *Shell;
@@ -140,6 +141,7 @@ WHERE char *SslCACertFile INITVAL (NULL);
 WHERE char *StChars;
 WHERE char *Status;
 WHERE char *Tempdir;
+WHERE char *TimingFile;
 WHERE char *Tochars;
 WHERE char *TSStatusFormat;
 WHERE char *TSIconFormat;
@@ -155,6 +157,7 @@ WHERE const char *ReleaseDate;
 
 WHERE HASH *Groups;
 WHERE HASH *ReverseAlias;
+WHERE HASH *AliasNames;
 
 WHERE LIST *AutoViewList INITVAL(0);
 WHERE LIST *AlternativeOrderList INITVAL(0);
@@ -214,9 +217,14 @@ WHERE short ScoreThresholdRead;
 WHERE short ScoreThresholdFlag;
 
 #ifdef USE_IMAP
+WHERE short ImapFetchConnections;
 WHERE short ImapKeepalive;
 WHERE short ImapPipelineDepth;
 #endif
+#if defined(USE_IMAP) || defined(USE_POP)
+WHERE short MessageCacheAge;
+WHERE short MessageCacheSize;
+#endif
 
 /* flags for received signals */
 WHERE SIG_ATOMIC_VOLATILE_T SigAlrm INITVAL (0);
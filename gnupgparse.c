@@ -381,7 +381,8 @@ bail:
   return NULL;
 }
 
-pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
+/* pgp_list_keys: run the listing command for keyring and parse its output. */
+static pgp_key_t pgp_list_keys (pgp_ring_t keyring, LIST * hints)
 {
   FILE *fp;
   pid_t thepid;
@@ -443,3 +444,257 @@ pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
   return db;
 }
 
+
+/* The whole listing of each keyring, kept for as long as the keyring
+ * files stay the same, so that looking up the keys of recipients needn't
+ * run the listing command every time. */
+
+/* the main keys of the listing an address, name or id belongs to */
+struct pgp_key_ref
+{
+  char *name;
+  int *key;
+  int nkeys;
+  int max;
+};
+
+static struct pgp_keyring_cache
+{
+  char *command;			/* the listing command and charset */
+  char *charset;			/* it was made with */
+  time_t mtime[CRYPT_KEYRING_FILES];
+  off_t size[CRYPT_KEYRING_FILES];
+  pgp_key_t keys;			/* the listing */
+  pgp_key_t *key;			/* its main keys, in order */
+  int nkeys;
+  HASH *addr;				/* mailboxes and names of user ids */
+  HASH *id;				/* key ids and fingerprints */
+} KeyringCache[2];
+
+static void pgp_free_key_ref (void *p)
+{
+  struct pgp_key_ref *ref = (struct pgp_key_ref *) p;
+
+  FREE (&ref->name);
+  FREE (&ref->key);
+  FREE (&ref);		/* __FREE_CHECKED__ */
+}
+
+static void pgp_add_key_ref (HASH *table, const char *name, int key)
+{
+  struct pgp_key_ref *ref;
+
+  if (!name || !*name)
+    return;
+
+  if ((ref = hash_find (table, name)) == NULL)
+  {
+    ref = safe_calloc (1, sizeof (struct pgp_key_ref));
+    ref->name = safe_strdup (name);
+    hash_insert (table, ref->name, ref, 0);
+  }
+  else if (ref->key[ref->nkeys - 1] == key)
+    return;
+
+  if (ref->nkeys == ref->max)
+    safe_realloc (&ref->key, (ref->max += 4) * sizeof (int));
+  ref->key[ref->nkeys++] = key;
+}
+
+static void pgp_free_keyring_cache (struct pgp_keyring_cache *cache)
+{
+  FREE (&cache->command);
+  FREE (&cache->charset);
+  pgp_free_key (&cache->keys);
+  FREE (&cache->key);
+  cache->nkeys = 0;
+  if (cache->addr)
+    hash_destroy (&cache->addr, pgp_free_key_ref);
+  if (cache->id)
+    hash_destroy (&cache->id, pgp_free_key_ref);
+}
+
+/* pgp_keyring_cache: the listing of keyring, read anew if the keyring has
+ * changed, or NULL if it can't be kept. */
+static struct pgp_keyring_cache *pgp_keyring_cache (pgp_ring_t keyring)
+{
+  struct pgp_keyring_cache *cache = &KeyringCache[keyring == PGP_SECRING];
+  const char *command = keyring == PGP_SECRING ? PgpListSecringCommand :
+    PgpListPubringCommand;
+  time_t mtime[CRYPT_KEYRING_FILES];
+  off_t size[CRYPT_KEYRING_FILES];
+  ADDRESS *a, *p;
+  pgp_uid_t *u;
+  pgp_key_t k;
+  int n;
+
+  if (!command || crypt_stat_keyring (mtime, size) < 0)
+  {
+    pgp_free_keyring_cache (cache);
+    return NULL;
+  }
+
+  if (cache->addr && !mutt_strcmp (cache->command, command) &&
+      !mutt_strcmp (cache->charset, Charset) &&
+      !memcmp (cache->mtime, mtime, sizeof (mtime)) &&
+      !memcmp (cache->size, size, sizeof (size)))
+    return cache;
+
+  pgp_free_keyring_cache (cache);
+  dprint (2, (debugfile, "pgp_keyring_cache: listing %s keyring.\n",
+	      keyring == PGP_SECRING ? "secret" : "public"));
+
+  if ((cache->keys = pgp_list_keys (keyring, NULL)) == NULL)
+    return NULL;
+
+  cache->command = safe_strdup (command);
+  cache->charset = safe_strdup (Charset);
+  memcpy (cache->mtime, mtime, sizeof (mtime));
+  memcpy (cache->size, size, sizeof (size));
+  cache->addr = hash_create (1031, 1);
+  cache->id = hash_create (1031, 1);
+
+  for (k = cache->keys; k; k = k->next)
+    if (!(k->flags & KEYFLAG_SUBKEY))
+      cache->nkeys++;
+  cache->key = safe_calloc (cache->nkeys, sizeof (pgp_key_t));
+
+  n = -1;
+  for (k = cache->keys; k; k = k->next)
+  {
+    if (!(k->flags & KEYFLAG_SUBKEY))
+      cache->key[++n] = k;
+    if (n < 0)
+      continue;
+
+    pgp_add_key_ref (cache->id, k->keyid, n);
+    if (mutt_strlen (k->keyid) > 8)
+      pgp_add_key_ref (cache->id, k->keyid + mutt_strlen (k->keyid) - 8, n);
+    pgp_add_key_ref (cache->id, k->fingerprint, n);
+
+    for (u = k->address; u; u = u->next)
+    {
+      a = rfc822_parse_adrlist (NULL, NONULL (u->addr));
+      for (p = a; p; p = p->next)
+      {
+	pgp_add_key_ref (cache->addr, p->mailbox, n);
+	pgp_add_key_ref (cache->addr, p->personal, n);
+      }
+      rfc822_free_address (&a);
+    }
+  }
+
+  return cache;
+}
+
+static pgp_key_t pgp_copy_key (pgp_key_t k, pgp_key_t parent)
+{
+  pgp_key_t c = pgp_new_keyinfo ();
+
+  c->keyid       = safe_strdup (k->keyid);
+  c->fingerprint = safe_strdup (k->fingerprint);
+  c->flags       = k->flags;
+  c->keylen      = k->keylen;
+  c->gen_time    = k->gen_time;
+  c->numalg      = k->numalg;
+  c->algorithm   = k->algorithm;
+  c->parent      = parent;
+  c->address     = pgp_copy_uids (k->address, c);
+
+  return c;
+}
+
+static int pgp_compare_key_pos (const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/* pgp_copy_keys: copy the main keys found under names in table, with
+ * their subkeys, in the order of the listing. */
+static pgp_key_t pgp_copy_keys (struct pgp_keyring_cache *cache, HASH *table,
+				const char **names, int nnames)
+{
+  struct pgp_key_ref *ref;
+  pgp_key_t db = NULL, *kend = &db, k, top;
+  int *pos = NULL, npos = 0, max = 0;
+  int i;
+
+  for (i = 0; i < nnames; i++)
+  {
+    if (!names[i] || !(ref = hash_find (table, names[i])))
+      continue;
+    if (npos + ref->nkeys > max)
+      safe_realloc (&pos, (max = npos + ref->nkeys) * sizeof (int));
+    memcpy (pos + npos, ref->key, ref->nkeys * sizeof (int));
+    npos += ref->nkeys;
+  }
+  qsort (pos, npos, sizeof (int), pgp_compare_key_pos);
+
+  for (i = 0; i < npos; i++)
+  {
+    if (i && pos[i] == pos[i - 1])
+      continue;
+    k = cache->key[pos[i]];
+    *kend = top = pgp_copy_key (k, NULL);
+    kend = &top->next;
+    for (k = k->next; k && (k->flags & KEYFLAG_SUBKEY); k = k->next)
+    {
+      *kend = pgp_copy_key (k, top);
+      kend = &(*kend)->next;
+    }
+  }
+
+  FREE (&pos);
+  return db;
+}
+
+/* pgp_id_hint: whether hint is a key id or fingerprint, optionally
+ * prefixed with 0x. */
+static const char *pgp_id_hint (const char *hint)
+{
+  size_t l;
+
+  if (hint[0] == '0' && (hint[1] == 'x' || hint[1] == 'X'))
+    hint += 2;
+  l = strlen (hint);
+  if ((l == 8 || l == 16 || l == 40) && strspn (hint, "0123456789abcdefABCDEF") == l)
+    return hint;
+  return NULL;
+}
+
+/* pgp_get_candidates: the keys in keyring that match hints. Key ids and
+ * fingerprints are looked up in the listing kept of the keyring, other
+ * hints are left to the listing command. */
+pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
+{
+  struct pgp_keyring_cache *cache;
+  const char *ids[16];
+  LIST *h;
+  int n = 0;
+
+  for (h = hints; h && n < sizeof (ids) / sizeof (ids[0]); h = h->next, n++)
+    if (!(ids[n] = pgp_id_hint ((char *) h->data)))
+      break;
+
+  if (!hints || h || !(cache = pgp_keyring_cache (keyring)))
+    return pgp_list_keys (keyring, hints);
+
+  return pgp_copy_keys (cache, cache->id, ids, n);
+}
+
+/* pgp_get_candidates_by_addr: the keys in keyring with a user id whose
+ * mailbox or name is that of a. If no listing of the keyring can be
+ * kept, the listing command is given hints instead. */
+pgp_key_t pgp_get_candidates_by_addr (pgp_ring_t keyring, ADDRESS *a,
+				      LIST *hints)
+{
+  struct pgp_keyring_cache *cache;
+  const char *names[2];
+
+  if (!(cache = pgp_keyring_cache (keyring)))
+    return pgp_list_keys (keyring, hints);
+
+  names[0] = a->mailbox;
+  names[1] = a->personal;
+  return pgp_copy_keys (cache, cache->addr, names, 2);
+}
@@ -1537,10 +1537,10 @@ void mutt_decode_attachment (BODY *b, STATE *s)
     if (!charset && AssumedCharset && *AssumedCharset)
       charset = mutt_get_default_charset ();
     if (charset && Charset)
-      cd = mutt_iconv_open (Charset, charset, M_ICONV_HOOK_FROM);
+      cd = mutt_iconv_cache_open (Charset, charset, M_ICONV_HOOK_FROM);
   }
   else if (istext && b->charset)
-    cd = mutt_iconv_open (Charset, b->charset, M_ICONV_HOOK_FROM);
+    cd = mutt_iconv_cache_open (Charset, b->charset, M_ICONV_HOOK_FROM);
 
   fseeko (s->fpin, b->offset, 0);
   switch (b->encoding)
@@ -1559,8 +1559,7 @@ void mutt_decode_attachment (BODY *b, STATE *s)
       break;
   }
 
-  if (cd != (iconv_t)(-1))
-    iconv_close (cd);
+  mutt_iconv_cache_close (cd);
 }
 
 /* when generating format=flowed ($text_flowed is set) from format=fixed,
@@ -44,6 +44,7 @@
 #include "hcversion.h"
 #include "mx.h"
 #include "lib.h"
+#include "timing.h"
 #include "md5.h"
 #include "rfc822.h"
 
@@ -667,6 +668,7 @@ mutt_hcache_restore(const unsigned char *d, HEADER ** oh)
   int off = 0;
   HEADER *h = mutt_new_header();
   int convert = !Charset_is_utf8;
+  timing_t start = mutt_timing_now ();
 
   /* skip validate */
   off += sizeof (validate);
@@ -693,6 +695,8 @@ mutt_hcache_restore(const unsigned char *d, HEADER ** oh)
     mutt_free_header(oh);
   }
 
+  mutt_timing_add (TIMING_HCACHE_RESTORE, start, 1);
+
   return h;
 }
 
@@ -701,15 +705,23 @@ mutt_hcache_fetch(header_cache_t *h, const char *filename,
 		  size_t(*keylen) (const char *fn))
 {
   void* data;
+  timing_t start;
+
+  if (!h)
+    return NULL;
 
+  start = mutt_timing_now ();
   data = mutt_hcache_fetch_raw (h, filename, keylen);
 
   if (!data || !crc_matches(data, h->crc))
   {
     FREE(&data);
+    mutt_timing_add (TIMING_HCACHE_FETCH, start, 0);
     return NULL;
   }
   
+  /* items count hits */
+  mutt_timing_add (TIMING_HCACHE_FETCH, start, 1);
   return data;
 }
 
@@ -787,14 +799,17 @@ mutt_hcache_store(header_cache_t *h, const char *filename, HEADER * header,
   char* data;
   int dlen;
   int ret;
+  timing_t start;
   
   if (!h)
     return -1;
   
+  start = mutt_timing_now ();
   data = mutt_hcache_dump(h, header, &dlen, uidvalidity, flags);
   ret = mutt_hcache_store_raw (h, filename, data, dlen, keylen);
   
   FREE(&data);
+  mutt_timing_add (TIMING_HCACHE_STORE, start, 1);
   
   return ret;
 }
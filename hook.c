@@ -34,18 +34,98 @@ typedef struct hook
 {
   int type;		/* hook type */
   REGEXP rx;		/* regular expression */
+  char *literal;	/* text anything rx matches contains */
   char *command;	/* filename, command or pattern to execute */
   pattern_t *pattern;	/* used for fcc,save,send-hook */
+  unsigned int seq;	/* order of definition */
   struct hook *next;
+  struct hook *same;	/* next hook of this type with the same pattern */
 } HOOK;
 
-static HOOK *Hooks = NULL;
+/* more than the hook commands */
+#define HOOK_LISTS 16
+
+/* the hooks of each type, fcc-save-hooks having one of their own */
+static struct hook_list
+{
+  int type;
+  HOOK *first;
+  HOOK *last;
+  HASH *patterns;	/* the first hook of each pattern */
+} Hooks[HOOK_LISTS];
+
+static int NumHookLists = 0;
+static unsigned int HookSeq = 0;
+
+/* walks through the hooks for a type in order of definition */
+struct hook_walk
+{
+  struct hook_list *list[HOOK_LISTS];
+  HOOK *cur[HOOK_LISTS];
+  int n;
+};
 
 static int current_hook_type = 0;
 
+static struct hook_list *hook_list (int type)
+{
+  int i;
+
+  for (i = 0; i < NumHookLists; i++)
+    if (Hooks[i].type == type)
+      return &Hooks[i];
+
+  Hooks[NumHookLists].type = type;
+  return &Hooks[NumHookLists++];
+}
+
+static HOOK *hook_next (struct hook_walk *w)
+{
+  HOOK *h, *best = NULL;
+  int i, b = 0;
+
+  /* hooks may be added by the ones run, so take the successor only now */
+  for (i = 0; i < w->n; i++)
+  {
+    h = w->cur[i] ? w->cur[i]->next : w->list[i]->first;
+    if (h && (!best || h->seq < best->seq))
+    {
+      best = h;
+      b = i;
+    }
+  }
+  if (best)
+    w->cur[b] = best;
+  return best;
+}
+
+static HOOK *hook_first (struct hook_walk *w, int type)
+{
+  int i;
+
+  w->n = 0;
+  for (i = 0; i < NumHookLists; i++)
+  {
+    if (Hooks[i].type & type)
+    {
+      w->list[w->n] = &Hooks[i];
+      w->cur[w->n++] = NULL;
+    }
+  }
+  return hook_next (w);
+}
+
+static int hook_match (HOOK *hook, const char *s)
+{
+  if (hook->literal && !strstr (s, hook->literal))
+    return 0;
+  return regexec (hook->rx.rx, s, 0, NULL, 0) == 0;
+}
+
 int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 {
-  HOOK *ptr;
+  struct hook_list *list = hook_list (data);
+  HOOK *ptr, *same;
   BUFFER command, pattern;
   int rc, not = 0;
   regex_t *rx = NULL;
@@ -135,12 +215,18 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
     command.data = safe_strdup (path);
   }
 
+  /* cached converters may have been opened according to the old hooks */
+  if (data & (M_CHARSETHOOK | M_ICONVHOOK))
+    mutt_iconv_cache_flush ();
+
+  if (!list->patterns)
+    list->patterns = hash_create (1031, 0);
+
   /* check to make sure that a matching hook doesn't already exist */
-  for (ptr = Hooks; ptr; ptr = ptr->next)
+  same = hash_find (list->patterns, (NONULL (pattern.data)));
+  for (ptr = same; ptr; ptr = ptr->same)
   {
-    if (ptr->type == data &&
-	ptr->rx.not == not &&
-	!mutt_strcmp (pattern.data, ptr->rx.pattern))
+    if (ptr->rx.not == not)
     {
       if (data & (M_FOLDERHOOK | M_SENDHOOK | M_SEND2HOOK | M_MESSAGEHOOK | M_ACCOUNTHOOK | M_REPLYHOOK | M_CRYPTHOOK))
       {
@@ -167,8 +253,6 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 	return 0;
       }
     }
-    if (!ptr->next)
-      break;
   }
 
   if (data & (M_SENDHOOK | M_SEND2HOOK | M_SAVEHOOK | M_FCCHOOK | M_MESSAGEHOOK | M_REPLYHOOK))
@@ -194,19 +278,32 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
     }
   }
 
-  if (ptr)
-  {
-    ptr->next = safe_calloc (1, sizeof (HOOK));
-    ptr = ptr->next;
-  }
+  ptr = safe_calloc (1, sizeof (HOOK));
+  if (list->last)
+    list->last->next = ptr;
   else
-    Hooks = ptr = safe_calloc (1, sizeof (HOOK));
+    list->first = ptr;
+  list->last = ptr;
   ptr->type = data;
   ptr->command = command.data;
   ptr->pattern = pat;
   ptr->rx.pattern = pattern.data;
   ptr->rx.rx = rx;
   ptr->rx.not = not;
+  ptr->seq = HookSeq++;
+
+  /* folders and URLs not containing this can't match */
+  if (rx && (data & (M_FOLDERHOOK | M_MBOXHOOK | M_ACCOUNTHOOK)))
+    ptr->literal = mutt_rx_literal (NONULL (pattern.data), 0);
+
+  if (same)
+  {
+    while (same->same)
+      same = same->same;
+    same->same = ptr;
+  }
+  else
+    hash_insert (list->patterns, NONULL (ptr->rx.pattern), ptr, 0);
   return 0;
 
 error:
@@ -219,6 +316,7 @@ static void delete_hook (HOOK *h)
 {
   FREE (&h->command);
   FREE (&h->rx.pattern);
+  FREE (&h->literal);
   if (h->rx.rx)
   {
     regfree (h->rx.rx);
@@ -231,26 +329,24 @@ static void delete_hook (HOOK *h)
 static void delete_hooks (int type)
 {
   HOOK *h;
-  HOOK *prev;
+  int i;
 
-  while (h = Hooks, h && (type == 0 || type == h->type))
-  {
-    Hooks = h->next;
-    delete_hook (h);
-  }
-
-  prev = h; /* Unused assignment to avoid compiler warnings */
+  if (type == 0 || type == M_CHARSETHOOK || type == M_ICONVHOOK)
+    mutt_iconv_cache_flush ();
 
-  while (h)
+  for (i = 0; i < NumHookLists; i++)
   {
-    if (type == h->type)
+    if (type && type != Hooks[i].type)
+      continue;
+
+    while ((h = Hooks[i].first))
     {
-      prev->next = h->next;
+      Hooks[i].first = h->next;
       delete_hook (h);
     }
-    else
-      prev = h;
-    h = prev->next;
+    Hooks[i].last = NULL;
+    if (Hooks[i].patterns)
+      hash_destroy (&Hooks[i].patterns, NULL);
   }
 }
 
@@ -294,7 +390,8 @@ int mutt_parse_unhook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 
 void mutt_folder_hook (char *path)
 {
-  HOOK *tmp = Hooks;
+  struct hook_walk w;
+  HOOK *tmp;
   BUFFER err, token;
 
   current_hook_type = M_FOLDERHOOK;
@@ -303,25 +400,22 @@ void mutt_folder_hook (char *path)
   err.dsize = STRING;
   err.data = safe_malloc (err.dsize);
   mutt_buffer_init (&token);
-  for (; tmp; tmp = tmp->next)
+  for (tmp = hook_first (&w, M_FOLDERHOOK); tmp; tmp = hook_next (&w))
   {
     if(!tmp->command)
       continue;
 
-    if (tmp->type & M_FOLDERHOOK)
+    if (hook_match (tmp, path) ^ tmp->rx.not)
     {
-      if ((regexec (tmp->rx.rx, path, 0, NULL, 0) == 0) ^ tmp->rx.not)
+      if (mutt_parse_rc_line (tmp->command, &token, &err) == -1)
       {
-	if (mutt_parse_rc_line (tmp->command, &token, &err) == -1)
-	{
-	  mutt_error ("%s", err.data);
-	  FREE (&token.data);
-	  mutt_sleep (1);	/* pause a moment to let the user see the error */
-	  current_hook_type = 0;
-	  FREE (&err.data);
+	mutt_error ("%s", err.data);
+	FREE (&token.data);
+	mutt_sleep (1);	/* pause a moment to let the user see the error */
+	current_hook_type = 0;
+	FREE (&err.data);
 
-	  return;
-	}
+	return;
       }
     }
   }
@@ -333,20 +427,19 @@ void mutt_folder_hook (char *path)
 
 char *mutt_find_hook (int type, const char *pat)
 {
-  HOOK *tmp = Hooks;
+  struct hook_walk w;
+  HOOK *tmp;
 
-  for (; tmp; tmp = tmp->next)
-    if (tmp->type & type)
-    {
-      if (regexec (tmp->rx.rx, pat, 0, NULL, 0) == 0)
-	return (tmp->command);
-    }
+  for (tmp = hook_first (&w, type); tmp; tmp = hook_next (&w))
+    if (hook_match (tmp, pat))
+      return (tmp->command);
   return (NULL);
 }
 
 void mutt_message_hook (CONTEXT *ctx, HEADER *hdr, int type)
 {
   BUFFER err, token;
+  struct hook_walk w;
   HOOK *hook;
 
   current_hook_type = type;
@@ -355,23 +448,22 @@ void mutt_message_hook (CONTEXT *ctx, HEADER *hdr, int type)
   err.dsize = STRING;
   err.data = safe_malloc (err.dsize);
   mutt_buffer_init (&token);
-  for (hook = Hooks; hook; hook = hook->next)
+  for (hook = hook_first (&w, type); hook; hook = hook_next (&w))
   {
     if(!hook->command)
       continue;
 
-    if (hook->type & type)
-      if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not)
-	if (mutt_parse_rc_line (hook->command, &token, &err) != 0)
-	{
-	  FREE (&token.data);
-	  mutt_error ("%s", err.data);
-	  mutt_sleep (1);
-	  current_hook_type = 0;
-	  FREE (&err.data);
+    if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not)
+      if (mutt_parse_rc_line (hook->command, &token, &err) != 0)
+      {
+	FREE (&token.data);
+	mutt_error ("%s", err.data);
+	mutt_sleep (1);
+	current_hook_type = 0;
+	FREE (&err.data);
 
-	  return;
-	}
+	return;
+      }
   }
   FREE (&token.data);
   FREE (&err.data);
@@ -382,20 +474,20 @@ void mutt_message_hook (CONTEXT *ctx, HEADER *hdr, int type)
 static int
 mutt_addr_hook (char *path, size_t pathlen, int type, CONTEXT *ctx, HEADER *hdr)
 {
+  struct hook_walk w;
   HOOK *hook;
 
   /* determine if a matching hook exists */
-  for (hook = Hooks; hook; hook = hook->next)
+  for (hook = hook_first (&w, type); hook; hook = hook_next (&w))
   {
     if(!hook->command)
       continue;
 
-    if (hook->type & type)
-      if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not)
-      {
-	mutt_make_string (path, pathlen, hook->command, ctx, hdr);
-	return 0;
-      }
+    if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not)
+    {
+      mutt_make_string (path, pathlen, hook->command, ctx, hdr);
+      return 0;
+    }
   }
 
   return -1;
@@ -454,12 +546,12 @@ void mutt_select_fcc (char *path, size_t pathlen, HEADER *hdr)
 
 static char *_mutt_string_hook (const char *match, int hook)
 {
-  HOOK *tmp = Hooks;
+  struct hook_walk w;
+  HOOK *tmp;
 
-  for (; tmp; tmp = tmp->next)
+  for (tmp = hook_first (&w, hook); tmp; tmp = hook_next (&w))
   {
-    if ((tmp->type & hook) && ((match &&
-	 regexec (tmp->rx.rx, match, 0, NULL, 0) == 0) ^ tmp->rx.not))
+    if ((match && hook_match (tmp, match)) ^ tmp->rx.not)
       return (tmp->command);
   }
   return (NULL);
@@ -467,13 +559,13 @@ static char *_mutt_string_hook (const char *match, int hook)
 
 static LIST *_mutt_list_hook (const char *match, int hook)
 {
-  HOOK *tmp = Hooks;
+  struct hook_walk w;
+  HOOK *tmp;
   LIST *matches = NULL;
 
-  for (; tmp; tmp = tmp->next)
+  for (tmp = hook_first (&w, hook); tmp; tmp = hook_next (&w))
   {
-    if ((tmp->type & hook) &&
-        ((match && regexec (tmp->rx.rx, match, 0, NULL, 0) == 0) ^ tmp->rx.not))
+    if ((match && hook_match (tmp, match)) ^ tmp->rx.not)
       matches = mutt_add_list (matches, tmp->command);
   }
   return (matches);
@@ -502,6 +594,7 @@ void mutt_account_hook (const char* url)
    * belong in a folder-hook -- perhaps we should warn the user. */
   static int inhook = 0;
 
+  struct hook_walk w;
   HOOK* hook;
   BUFFER token;
   BUFFER err;
@@ -514,12 +607,12 @@ void mutt_account_hook (const char* url)
   err.data = safe_malloc (err.dsize);
   mutt_buffer_init (&token);
 
-  for (hook = Hooks; hook; hook = hook->next)
+  for (hook = hook_first (&w, M_ACCOUNTHOOK); hook; hook = hook_next (&w))
   {
-    if (! (hook->command && (hook->type & M_ACCOUNTHOOK)))
+    if (!hook->command)
       continue;
 
-    if ((regexec (hook->rx.rx, url, 0, NULL, 0) == 0) ^ hook->rx.not)
+    if (hook_match (hook, url) ^ hook->rx.not)
     {
       inhook = 1;
 
@@ -29,6 +29,7 @@
 #include "imap_private.h"
 #include "mx.h"
 #include "buffy.h"
+#include "timing.h"
 
 #include <ctype.h>
 #include <stdlib.h>
@@ -52,6 +53,8 @@ static void cmd_parse_myrights (IMAP_DATA* idata, const char* s);
 static void cmd_parse_search (IMAP_DATA* idata, const char* s);
 static void cmd_parse_status (IMAP_DATA* idata, char* s);
 static void cmd_parse_enabled (IMAP_DATA* idata, const char* s);
+static void cmd_parse_copyuid (IMAP_DATA* idata, const char* s);
+static void cmd_parse_modified (IMAP_DATA* idata, const char* s);
 
 static const char * const Capabilities[] = {
   "IMAP4",
@@ -67,6 +70,14 @@ static const char * const Capabilities[] = {
   "IDLE",
   "SASL-IR",
   "ENABLE",
+  "COMPRESS=DEFLATE",
+  "LITERAL+",
+  "LITERAL-",
+  "MULTIAPPEND",
+  "UIDPLUS",
+  "MOVE",
+  "CONDSTORE",
+  "SORT",
 
   NULL
 };
@@ -231,6 +242,7 @@ const char* imap_cmd_trailer (IMAP_DATA* idata)
  */
 int imap_exec (IMAP_DATA* idata, const char* cmdstr, int flags)
 {
+  timing_t start = mutt_timing_now ();
   int rc;
 
   if ((rc = cmd_start (idata, cmdstr, flags)) < 0)
@@ -246,6 +258,8 @@ int imap_exec (IMAP_DATA* idata, const char* cmdstr, int flags)
     rc = imap_cmd_step (idata);
   while (rc == IMAP_CMD_CONTINUE);
 
+  mutt_timing_add (TIMING_IMAP_CMD, start, 0);
+
   if (rc == IMAP_CMD_NO && (flags & IMAP_CMD_FAIL_OK))
     return -2;
 
@@ -299,8 +313,12 @@ void imap_cmd_finish (IMAP_DATA* idata)
       if ((idata->reopen & IMAP_EXPUNGE_PENDING) &&
 	  !(idata->reopen & IMAP_EXPUNGE_EXPECTED))
 	idata->check_status = IMAP_EXPUNGE_PENDING;
+      /* messages moved away only need the index redrawn */
+      else if ((idata->reopen & IMAP_EXPUNGE_PENDING) &&
+	       (idata->reopen & IMAP_MOVE_EXPECTED))
+	idata->check_status |= IMAP_MOVED_PENDING;
       idata->reopen &= ~(IMAP_EXPUNGE_PENDING | IMAP_NEWMAIL_PENDING |
-			 IMAP_EXPUNGE_EXPECTED);
+			 IMAP_EXPUNGE_EXPECTED | IMAP_MOVE_EXPECTED);
     }
   }
 
@@ -514,6 +532,17 @@ static int cmd_handle_untagged (IMAP_DATA* idata)
     cmd_parse_capability (idata, pn);
   else if (!ascii_strncasecmp ("OK [CAPABILITY", pn, 14))
     cmd_parse_capability (idata, imap_next_word (pn));
+  else if (!ascii_strncasecmp ("OK [COPYUID ", s, 12))
+    cmd_parse_copyuid (idata, pn);
+  else if (!ascii_strncasecmp ("OK [MODIFIED ", s, 13))
+    cmd_parse_modified (idata, pn);
+  else if (!ascii_strncasecmp ("OK [HIGHESTMODSEQ ", s, 18))
+  {
+    unsigned long long modseq;
+
+    imap_parse_modseq (s + 18, &modseq);
+    imap_update_modseq (idata, modseq);
+  }
   else if (ascii_strncasecmp ("LIST", s, 4) == 0)
     cmd_parse_list (idata, s);
   else if (ascii_strncasecmp ("LSUB", s, 4) == 0)
@@ -620,6 +649,8 @@ static void cmd_parse_fetch (IMAP_DATA* idata, char* s)
 {
   int msgno, cur;
   HEADER* h = NULL;
+  char* flags = NULL;
+  unsigned long long modseq = 0;
 
   dprint (3, (debugfile, "Handling FETCH\n"));
 
@@ -657,19 +688,58 @@ static void cmd_parse_fetch (IMAP_DATA* idata, char* s)
   }
   s++;
 
-  if (ascii_strncasecmp ("FLAGS", s, 5) != 0)
+  /* with CONDSTORE the FLAGS may be preceded or replaced by a MODSEQ */
+  for (;;)
+  {
+    SKIPWS (s);
+    if (!ascii_strncasecmp ("FLAGS", s, 5))
+    {
+      flags = s;
+      if (!(s = strchr (s, ')')))
+        break;
+      s++;
+    }
+    else if (!ascii_strncasecmp ("MODSEQ", s, 6))
+      s = imap_parse_modseq (s + 6, &modseq);
+    else if (!ascii_strncasecmp ("UID", s, 3))
+      s = imap_next_word (imap_next_word (s));
+    else
+      break;
+  }
+
+  if (!flags)
   {
-    dprint (2, (debugfile, "Only handle FLAGS updates\n"));
+    /* our own conditional STORE */
+    imap_update_modseq (idata, modseq);
+    if (modseq)
+      HEADER_DATA(h)->modseq = modseq;
+    else
+      dprint (2, (debugfile, "Only handle FLAGS updates\n"));
     return;
   }
 
-  /* If server flags could conflict with mutt's flags, reopen the mailbox. */
+  /* If server flags could conflict with mutt's flags, reopen the mailbox.
+   * The highest modseq will soon include the server's change, so the
+   * message keeps the modseq from before it: a later conditional STORE
+   * then fails rather than overwrite the change. */
   if (h->changed)
+  {
     idata->reopen |= IMAP_EXPUNGE_PENDING;
+    if (idata->modseq && !HEADER_DATA(h)->conflict)
+    {
+      if (!HEADER_DATA(h)->modseq || HEADER_DATA(h)->modseq > idata->modseq)
+	HEADER_DATA(h)->modseq = idata->modseq;
+      HEADER_DATA(h)->conflict = 1;
+    }
+  }
   else {
-    imap_set_flags (idata, h, s);
+    imap_set_flags (idata, h, flags);
+    if (modseq)
+      HEADER_DATA(h)->modseq = modseq;
+    HEADER_DATA(h)->conflict = 0;
     idata->check_status = IMAP_FLAGS_PENDING;
   }
+  imap_update_modseq (idata, modseq);
 }
 
 static void cmd_parse_list (IMAP_DATA* idata, char* s)
@@ -1039,3 +1109,31 @@ static void cmd_parse_enabled (IMAP_DATA* idata, const char* s)
       idata->unicode = 1;
   }
 }
+
+/* cmd_parse_copyuid: remember the UIDPLUS response code to a COPY or
+ *   MOVE (untagged for MOVE, tagged for COPY) */
+static void cmd_parse_copyuid (IMAP_DATA* idata, const char* s)
+{
+  dprint (3, (debugfile, "Handling COPYUID\n"));
+
+  idata->copyuid = mutt_add_list (idata->copyuid, s + 9);
+}
+
+/* cmd_parse_modified: remember the messages a conditional STORE left
+ *   alone because they changed on the server since we last looked */
+static void cmd_parse_modified (IMAP_DATA* idata, const char* s)
+{
+  char buf[STRING];
+  size_t len;
+
+  dprint (2, (debugfile, "Handling MODIFIED\n"));
+
+  s += 10;
+  len = strcspn (s, "] ");
+  if (!len || len >= sizeof (buf))
+    return;
+  memcpy (buf, s, len);
+  buf[len] = '\0';
+
+  idata->modified = mutt_add_list (idata->modified, buf);
+}
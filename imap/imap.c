@@ -38,6 +38,9 @@
 #if USE_HCACHE
 #include "hcache.h"
 #endif
+#ifdef USE_ZLIB
+#include "mutt_zstrm.h"
+#endif
 
 #include <unistd.h>
 #include <ctype.h>
@@ -243,6 +246,50 @@ int imap_read_literal (FILE* fp, IMAP_DATA* idata, long bytes, progress_t* pbar)
   return 0;
 }
 
+/* imap_read_literal_buffer: like imap_read_literal(), but append the
+ *   literal to buf, copied straight out of the connection's input buffer */
+int imap_read_literal_buffer (BUFFER* buf, IMAP_DATA* idata, long bytes)
+{
+  size_t offset = buf->dptr - buf->data;
+  char *src, *dst, *end;
+
+  dprint (2, (debugfile, "imap_read_literal_buffer: reading %ld bytes\n", bytes));
+
+  if (offset + bytes + 1 > buf->dsize)
+  {
+    buf->dsize = offset + bytes + 1;
+    safe_realloc (&buf->data, buf->dsize);
+    buf->dptr = buf->data + offset;
+  }
+
+  if (mutt_socket_readn (idata->conn, buf->dptr, bytes) < 0)
+  {
+    dprint (1, (debugfile, "imap_read_literal_buffer: error during read\n"));
+    idata->status = IMAP_FATAL;
+    *buf->dptr = '\0';
+
+    return -1;
+  }
+
+#ifdef DEBUG
+  if (debuglevel >= IMAP_LOG_LTRL)
+    fwrite (buf->dptr, 1, bytes, debugfile);
+#endif
+
+  /* drop the CR of CRLF, and a trailing one, as imap_read_literal() does */
+  end = buf->dptr + bytes;
+  for (src = dst = buf->dptr; src < end; src++)
+  {
+    if (*src == '\r' && (src + 1 == end || src[1] == '\n'))
+      continue;
+    *dst++ = *src;
+  }
+  *dst = '\0';
+  buf->dptr = dst;
+
+  return 0;
+}
+
 /* imap_expunge_mailbox: Purge IMAP portion of expunged messages from the
  *   context. Must not be done while something has a handle on any headers
  *   (eg inside pager or editor). That is, check IMAP_REOPEN_ALLOW. */
@@ -291,7 +338,9 @@ void imap_expunge_mailbox (IMAP_DATA* idata)
   /* We may be called on to expunge at any time. We can't rely on the caller
    * to always know to rethread */
   mx_update_tables (idata->ctx, 0);
+  idata->defer_sort = 1;
   mutt_sort_headers (idata->ctx, 1);
+  idata->defer_sort = 0;
 }
 
 /* imap_check_capabilities: make sure we can log in to this server. */
@@ -386,6 +435,27 @@ IMAP_DATA* imap_conn_find (const ACCOUNT* account, int flags)
   {
     /* capabilities may have changed */
     imap_exec (idata, "CAPABILITY", IMAP_CMD_QUEUE);
+#ifdef USE_ZLIB
+    /* RFC 4978: compression starts right after the tagged OK, so the
+     * command may not be pipelined with anything else. */
+    if (option (OPTIMAPDEFLATE))
+    {
+      imap_exec (idata, NULL, IMAP_CMD_FAIL_OK);
+      if (mutt_bit_isset (idata->capabilities, COMPRESS_DEFLATE)
+          && imap_exec (idata, "COMPRESS DEFLATE", IMAP_CMD_FAIL_OK) == 0)
+      {
+        if (mutt_zstrm_wrap_conn (idata->conn) < 0)
+        {
+          /* the server is already compressing - there is no way back */
+          mutt_error _("Could not set up compression");
+          mutt_sleep (1);
+          idata->status = IMAP_FATAL;
+          imap_close_connection (idata);
+          return NULL;
+        }
+      }
+    }
+#endif
     /* enable RFC6855, if the server supports that */
     if (mutt_bit_isset (idata->capabilities, ENABLE))
       imap_exec (idata, "ENABLE UTF8=ACCEPT", IMAP_CMD_QUEUE);
@@ -626,8 +696,12 @@ int imap_open_mailbox (CONTEXT* ctx)
     imap_status (Postponed, 1);
   FREE (&pmx.mbox);
 
-  snprintf (bufout, sizeof (bufout), "%s %s",
-    ctx->readonly ? "EXAMINE" : "SELECT", buf);
+  /* CONDSTORE lets flag changes be stored only if nobody else touched the
+   * messages in the meantime, see imap_sync_messages() */
+  snprintf (bufout, sizeof (bufout), "%s %s%s",
+    ctx->readonly ? "EXAMINE" : "SELECT", buf,
+    mutt_bit_isset (idata->capabilities, CONDSTORE) ? " (CONDSTORE)" : "");
+  idata->modseq = 0;
 
   idata->state = IMAP_SELECTED;
 
@@ -684,6 +758,11 @@ int imap_open_mailbox (CONTEXT* ctx)
       idata->uidnext = strtol (pc, NULL, 10);
       status->uidnext = idata->uidnext;
     }
+    else if (ascii_strncasecmp ("OK [HIGHESTMODSEQ", pc, 17) == 0)
+    {
+      dprint (3, (debugfile, "Getting mailbox HIGHESTMODSEQ\n"));
+      imap_parse_modseq (pc + 17, &idata->modseq);
+    }
     else
     {
       pc = imap_next_word (pc);
@@ -1038,6 +1117,47 @@ static int compare_flags (HEADER* h)
   return 0;
 }
 
+/* sync_flags: write the flags (including any keywords) which hdr should
+ *   have on the server into flags. Returns 1 if flags instead holds the
+ *   system flags which must be removed, because nothing is left to set. */
+static int sync_flags (IMAP_DATA *idata, HEADER *hdr, char *flags,
+		       size_t flsize)
+{
+  flags[0] = '\0';
+
+  imap_set_flag (idata, M_ACL_SEEN, hdr->read, "\\Seen ",
+		 flags, flsize);
+  imap_set_flag (idata, M_ACL_WRITE, hdr->old,
+                 "Old ", flags, flsize);
+  imap_set_flag (idata, M_ACL_WRITE, hdr->flagged,
+		 "\\Flagged ", flags, flsize);
+  imap_set_flag (idata, M_ACL_WRITE, hdr->replied,
+		 "\\Answered ", flags, flsize);
+  imap_set_flag (idata, M_ACL_DELETE, hdr->deleted,
+		 "\\Deleted ", flags, flsize);
+
+  /* now make sure we don't lose custom tags */
+  if (mutt_bit_isset (idata->ctx->rights, M_ACL_WRITE))
+    imap_add_keywords (flags, hdr, idata->flags, flsize);
+
+  mutt_remove_trailing_ws (flags);
+
+  if (*flags)
+    return 0;
+
+  /* UW-IMAP is OK with null flags, Cyrus isn't. The only solution is to
+   * explicitly revoke all system flags (if we have permission) */
+  imap_set_flag (idata, M_ACL_SEEN, 1, "\\Seen ", flags, flsize);
+  imap_set_flag (idata, M_ACL_WRITE, 1, "Old ", flags, flsize);
+  imap_set_flag (idata, M_ACL_WRITE, 1, "\\Flagged ", flags, flsize);
+  imap_set_flag (idata, M_ACL_WRITE, 1, "\\Answered ", flags, flsize);
+  imap_set_flag (idata, M_ACL_DELETE, 1, "\\Deleted ", flags, flsize);
+
+  mutt_remove_trailing_ws (flags);
+
+  return 1;
+}
+
 /* Update the IMAP server to reflect the flags a single message.  */
 int imap_sync_message (IMAP_DATA *idata, HEADER *hdr, BUFFER *cmd,
 		       int *err_continue)
@@ -1058,39 +1178,9 @@ int imap_sync_message (IMAP_DATA *idata, HEADER *hdr, BUFFER *cmd,
   mutt_buffer_addstr (cmd, "UID STORE ");
   mutt_buffer_addstr (cmd, uid);
 
-  flags[0] = '\0';
-
-  imap_set_flag (idata, M_ACL_SEEN, hdr->read, "\\Seen ",
-		 flags, sizeof (flags));
-  imap_set_flag (idata, M_ACL_WRITE, hdr->old,
-                 "Old ", flags, sizeof (flags));
-  imap_set_flag (idata, M_ACL_WRITE, hdr->flagged,
-		 "\\Flagged ", flags, sizeof (flags));
-  imap_set_flag (idata, M_ACL_WRITE, hdr->replied,
-		 "\\Answered ", flags, sizeof (flags));
-  imap_set_flag (idata, M_ACL_DELETE, hdr->deleted,
-		 "\\Deleted ", flags, sizeof (flags));
-
-  /* now make sure we don't lose custom tags */
-  if (mutt_bit_isset (idata->ctx->rights, M_ACL_WRITE))
-    imap_add_keywords (flags, hdr, idata->flags, sizeof (flags));
-
-  mutt_remove_trailing_ws (flags);
-
-  /* UW-IMAP is OK with null flags, Cyrus isn't. The only solution is to
-   * explicitly revoke all system flags (if we have permission) */
-  if (!*flags)
-  {
-    imap_set_flag (idata, M_ACL_SEEN, 1, "\\Seen ", flags, sizeof (flags));
-    imap_set_flag (idata, M_ACL_WRITE, 1, "Old ", flags, sizeof (flags));
-    imap_set_flag (idata, M_ACL_WRITE, 1, "\\Flagged ", flags, sizeof (flags));
-    imap_set_flag (idata, M_ACL_WRITE, 1, "\\Answered ", flags, sizeof (flags));
-    imap_set_flag (idata, M_ACL_DELETE, 1, "\\Deleted ", flags, sizeof (flags));
-
-    mutt_remove_trailing_ws (flags);
-
+  if (sync_flags (idata, hdr, flags, sizeof (flags)))
     mutt_buffer_addstr (cmd, " -FLAGS.SILENT (");
-  } else
+  else
     mutt_buffer_addstr (cmd, " FLAGS.SILENT (");
 
   mutt_buffer_addstr (cmd, flags);
@@ -1116,6 +1206,156 @@ int imap_sync_message (IMAP_DATA *idata, HEADER *hdr, BUFFER *cmd,
   return 0;
 }
 
+typedef struct
+{
+  HEADER *h;
+  char *flags;	/* STORE argument, prefixed by '-' to remove or ' ' to set */
+  unsigned long long modseq;	/* for UNCHANGEDSINCE, 0 without CONDSTORE */
+} SYNC_MSG;
+
+static int sync_msg_cmp (const void *a, const void *b)
+{
+  const SYNC_MSG *ma = (const SYNC_MSG *) a;
+  const SYNC_MSG *mb = (const SYNC_MSG *) b;
+  int r;
+
+  if ((r = mutt_strcmp (ma->flags, mb->flags)))
+    return r;
+  if (ma->modseq != mb->modseq)
+    return ma->modseq < mb->modseq ? -1 : 1;
+  return ma->h->index - mb->h->index;
+}
+
+#define SYNC_MSG_SAME(a, b) \
+  (!mutt_strcmp ((a)->flags, (b)->flags) && (a)->modseq == (b)->modseq)
+
+/* imap_sync_messages: queue STOREs bringing the server flags of the
+ *   changed messages among hdrs up to date. Messages ending up with the
+ *   same flags and keywords share a command, neighbouring ones collapsed
+ *   into UID ranges. With CONDSTORE each command carries the mailbox's
+ *   highest known modseq as UNCHANGEDSINCE, so that messages changed on
+ *   the server since we last heard of it are left alone and reported in
+ *   MODIFIED response codes for imap_sync_modified() to deal with. The
+ *   few messages known to have been changed on the server meanwhile go
+ *   out separately, with the modseq from before that change.
+ *   The messages stay changed: the caller clears that once the queued
+ *   commands have succeeded.
+ *   Returns the number of messages queued, or -1 on failure. */
+int imap_sync_messages (IMAP_DATA *idata, HEADER **hdrs, int count)
+{
+  SYNC_MSG *msgs;
+  BUFFER *cmd = NULL;
+  BUFFER *set = NULL;
+  HEADER *h;
+  char flags[LONG_STRING];
+  int nmsgs = 0;
+  int queued = 0;
+  int i, j, k;
+  int rc = -1;
+
+  mutt_free_list (&idata->modified);
+
+  msgs = safe_calloc (count ? count : 1, sizeof (SYNC_MSG));
+  for (i = 0; i < count; i++)
+  {
+    h = hdrs[i];
+    if (!h->active || !h->changed || !compare_flags (h))
+      continue;
+
+    flags[0] = sync_flags (idata, h, flags + 1, sizeof (flags) - 1) ? '-' : ' ';
+    /* no rights to change anything */
+    if (!flags[1])
+      continue;
+
+    msgs[nmsgs].h = h;
+    msgs[nmsgs].flags = safe_strdup (flags);
+    msgs[nmsgs].modseq = HEADER_DATA (h)->conflict ? HEADER_DATA (h)->modseq :
+      idata->modseq;
+    nmsgs++;
+  }
+
+  qsort (msgs, nmsgs, sizeof (SYNC_MSG), sync_msg_cmp);
+
+  if (!(cmd = mutt_buffer_new ()) || !(set = mutt_buffer_new ()))
+  {
+    dprint (1, (debugfile, "imap_sync_messages: unable to allocate buffer\n"));
+    goto out;
+  }
+
+  for (i = 0; i < nmsgs; i = j)
+  {
+    set->dptr = set->data;
+
+    /* j: start of the next range, k: end of this one */
+    for (j = i; j < nmsgs && SYNC_MSG_SAME (&msgs[j], &msgs[i])
+	   && set->dptr - set->data < IMAP_MAX_CMDLEN; j = k)
+    {
+      for (k = j + 1; k < nmsgs && SYNC_MSG_SAME (&msgs[k], &msgs[j])
+	     && msgs[k].h->index == msgs[k - 1].h->index + 1; k++)
+	;
+
+      mutt_buffer_printf (set, j == i ? "%u" : ",%u",
+			  HEADER_DATA (msgs[j].h)->uid);
+      if (k - j > 1)
+	mutt_buffer_printf (set, ":%u", HEADER_DATA (msgs[k - 1].h)->uid);
+    }
+
+    cmd->dptr = cmd->data;
+    mutt_buffer_printf (cmd, "UID STORE %s", set->data);
+    if (msgs[i].modseq)
+      mutt_buffer_printf (cmd, " (UNCHANGEDSINCE %llu)", msgs[i].modseq);
+    mutt_buffer_printf (cmd, " %sFLAGS.SILENT (%s)",
+			msgs[i].flags[0] == '-' ? "-" : "", msgs[i].flags + 1);
+
+    if (imap_exec (idata, cmd->data, IMAP_CMD_QUEUE))
+      goto out;
+    queued += j - i;
+  }
+
+  rc = queued;
+
+out:
+  for (i = 0; i < nmsgs; i++)
+    FREE (&msgs[i].flags);
+  FREE (&msgs);
+  mutt_buffer_free (&cmd);
+  mutt_buffer_free (&set);
+
+  return rc;
+}
+
+/* imap_sync_modified: refetch the flags of messages which a conditional
+ *   STORE left alone, so that the other client's changes win instead of
+ *   being overwritten. Returns the number of MODIFIED sets, or -1. */
+int imap_sync_modified (IMAP_DATA *idata)
+{
+  LIST *l;
+  char buf[LONG_STRING];
+  int rc = 0;
+
+  for (l = idata->modified; l; l = l->next)
+  {
+    snprintf (buf, sizeof (buf), "UID FETCH %s (UID FLAGS MODSEQ)", l->data);
+    if (imap_exec (idata, buf, IMAP_CMD_QUEUE))
+    {
+      rc = -1;
+      break;
+    }
+    rc++;
+  }
+  mutt_free_list (&idata->modified);
+
+  if (rc > 0)
+  {
+    if (imap_exec (idata, NULL, 0))
+      rc = -1;
+    mutt_error _("Some messages changed on the server, keeping their flags.");
+    mutt_sleep (1);
+  }
+
+  return rc;
+}
+
 static int sync_helper (IMAP_DATA* idata, int right, int flag, const char* name)
 {
   int count = 0;
@@ -1238,33 +1478,41 @@ int imap_sync_mailbox (CONTEXT* ctx, int expunge, int* index_hint)
   imap_hcache_close (idata);
 #endif
 
-  /* sync +/- flags for the five flags mutt cares about */
   rc = 0;
 
-  /* presort here to avoid doing 10 resorts in imap_exec_msgset */
-  oldsort = Sort;
-  if (Sort != SORT_ORDER)
+  /* With CONDSTORE each message is stored exactly once: a second STORE
+   * would find the modseq bumped by the first one and fail. */
+  if (idata->modseq)
+    rc = imap_sync_messages (idata, ctx->hdrs, ctx->msgcount);
+  else
   {
-    hdrs = ctx->hdrs;
-    ctx->hdrs = safe_malloc (ctx->msgcount * sizeof (HEADER*));
-    memcpy (ctx->hdrs, hdrs, ctx->msgcount * sizeof (HEADER*));
+    /* sync +/- flags for the five flags mutt cares about */
 
-    Sort = SORT_ORDER;
-    qsort (ctx->hdrs, ctx->msgcount, sizeof (HEADER*),
-           mutt_get_sort_func (SORT_ORDER));
-  }
+    /* presort here to avoid doing 10 resorts in imap_exec_msgset */
+    oldsort = Sort;
+    if (Sort != SORT_ORDER)
+    {
+      hdrs = ctx->hdrs;
+      ctx->hdrs = safe_malloc (ctx->msgcount * sizeof (HEADER*));
+      memcpy (ctx->hdrs, hdrs, ctx->msgcount * sizeof (HEADER*));
 
-  rc += sync_helper (idata, M_ACL_DELETE, M_DELETED, "\\Deleted");
-  rc += sync_helper (idata, M_ACL_WRITE, M_FLAG, "\\Flagged");
-  rc += sync_helper (idata, M_ACL_WRITE, M_OLD, "Old");
-  rc += sync_helper (idata, M_ACL_SEEN, M_READ, "\\Seen");
-  rc += sync_helper (idata, M_ACL_WRITE, M_REPLIED, "\\Answered");
+      Sort = SORT_ORDER;
+      qsort (ctx->hdrs, ctx->msgcount, sizeof (HEADER*),
+             mutt_get_sort_func (SORT_ORDER));
+    }
 
-  if (oldsort != Sort)
-  {
-    Sort = oldsort;
-    FREE (&ctx->hdrs);
-    ctx->hdrs = hdrs;
+    rc += sync_helper (idata, M_ACL_DELETE, M_DELETED, "\\Deleted");
+    rc += sync_helper (idata, M_ACL_WRITE, M_FLAG, "\\Flagged");
+    rc += sync_helper (idata, M_ACL_WRITE, M_OLD, "Old");
+    rc += sync_helper (idata, M_ACL_SEEN, M_READ, "\\Seen");
+    rc += sync_helper (idata, M_ACL_WRITE, M_REPLIED, "\\Answered");
+
+    if (oldsort != Sort)
+    {
+      Sort = oldsort;
+      FREE (&ctx->hdrs);
+      ctx->hdrs = hdrs;
+    }
   }
 
   if (rc && (imap_exec (idata, NULL, 0) != IMAP_CMD_OK))
@@ -1293,10 +1541,14 @@ int imap_sync_mailbox (CONTEXT* ctx, int expunge, int* index_hint)
     HEADER_DATA(ctx->hdrs[n])->old = ctx->hdrs[n]->old;
     HEADER_DATA(ctx->hdrs[n])->read = ctx->hdrs[n]->read;
     HEADER_DATA(ctx->hdrs[n])->replied = ctx->hdrs[n]->replied;
+    HEADER_DATA(ctx->hdrs[n])->conflict = 0;
     ctx->hdrs[n]->changed = 0;
   }
   ctx->changed = 0;
 
+  if (idata->modified)
+    imap_sync_modified (idata);
+
   /* We must send an EXPUNGE command if we're not closing. */
   if (expunge && !(ctx->closing) &&
       mutt_bit_isset(ctx->rights, M_ACL_DELETE))
@@ -1385,6 +1637,8 @@ int imap_close_mailbox (CONTEXT* ctx)
  * return values:
  *	M_REOPENED	mailbox has been externally modified
  *	M_NEW_MAIL	new mail has arrived!
+ *	M_FLAGS		flags were changed by another client
+ *	M_MOVED		messages we moved away are gone from the index
  *	0		no change
  *	-1		error
  */
@@ -1436,6 +1690,8 @@ int imap_check_mailbox (CONTEXT *ctx, int *index_hint, int force)
     result = M_NEW_MAIL;
   else if (idata->check_status & IMAP_FLAGS_PENDING)
     result = M_FLAGS;
+  else if (idata->check_status & IMAP_MOVED_PENDING)
+    result = M_MOVED;
 
   idata->check_status = 0;
 
@@ -1787,12 +2043,53 @@ static int imap_compile_search (const pattern_t* pat, BUFFER* buf)
   return 0;
 }
 
+/* search_envelopes: whether any part of pat looks at more of a message
+ *   than $imap_lazy_headers fetches up front */
+static int search_envelopes (const pattern_t* pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    switch (pat->op)
+    {
+      case M_AND:
+      case M_OR:
+        if (search_envelopes (pat->child))
+          return 1;
+        break;
+      case M_ALL:
+      case M_NEW:
+      case M_OLD:
+      case M_REPLIED:
+      case M_READ:
+      case M_UNREAD:
+      case M_DELETED:
+      case M_FLAG:
+      case M_TAG:
+      case M_DATE_RECEIVED:
+      case M_MESSAGE:
+      case M_SIZE:
+      /* these open the message, or are left to the server */
+      case M_BODY:
+      case M_HEADER:
+      case M_WHOLE_MSG:
+        break;
+      default:
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
 int imap_search (CONTEXT* ctx, const pattern_t* pat)
 {
   BUFFER buf;
   IMAP_DATA* idata = (IMAP_DATA*)ctx->data;
   int i;
 
+  if (search_envelopes (pat) && imap_read_all_envelopes (idata) < 0)
+    return -1;
+
   for (i = 0; i < ctx->msgcount; i++)
     ctx->hdrs[i]->matched = 0;
 
@@ -1816,6 +2113,154 @@ int imap_search (CONTEXT* ctx, const pattern_t* pat)
   return 0;
 }
 
+static int compare_server_order (const void* a, const void* b)
+{
+  HEADER* ha = *((HEADER**) a);
+  HEADER* hb = *((HEADER**) b);
+  unsigned int pa = HEADER_DATA (ha)->sortpos;
+  unsigned int pb = HEADER_DATA (hb)->sortpos;
+  int result = pa < pb ? -1 : pa > pb;
+
+  if (!result)
+    result = ha->index - hb->index;
+
+  return (Sort & SORT_REVERSE) ? -result : result;
+}
+
+static int compare_uid (const void* a, const void* b)
+{
+  unsigned int ua = HEADER_DATA (*((HEADER**) a))->uid;
+  unsigned int ub = HEADER_DATA (*((HEADER**) b))->uid;
+
+  return ua < ub ? -1 : ua > ub;
+}
+
+static int find_uid (const void* key, const void* elem)
+{
+  unsigned int uid = *((const unsigned int*) key);
+  unsigned int ue = HEADER_DATA (*((HEADER**) elem))->uid;
+
+  return uid < ue ? -1 : uid > ue;
+}
+
+/* sort_key: the SORT key for method, "" if the skeleton of a lazily
+ *   read header is enough to sort by it, NULL if mutt needs envelopes */
+static const char* sort_key (int method)
+{
+  switch (method & SORT_MASK)
+  {
+    case SORT_ORDER:
+    case SORT_RECEIVED:
+    case SORT_SIZE:
+      return "";
+    case SORT_DATE:
+      return "DATE";
+    case SORT_FROM:
+      return "FROM";
+    case SORT_TO:
+      return "TO";
+    case SORT_SUBJECT:
+      return "SUBJECT";
+  }
+
+  return NULL;
+}
+
+/* imap_sort_lazy: whether the folder can be sorted by method without
+ *   fetching the envelopes of all messages */
+int imap_sort_lazy (IMAP_DATA* idata, int method)
+{
+  const char* key = sort_key (method);
+
+  return key && (!*key || mutt_bit_isset (idata->capabilities, SORT));
+}
+
+/* imap_sort_headers: headers read with $imap_lazy_headers may lack the
+ *   envelope that sorting by method compares. Let the server sort them
+ *   if it can, otherwise fetch what's missing so that mutt can. While a
+ *   command is being completed this is left for the next resort.
+ *   Returns 1 if ctx->hdrs has been put in order, 0 if it is up to the
+ *   caller to do so. */
+int imap_sort_headers (CONTEXT* ctx, int method)
+{
+  IMAP_DATA* idata = (IMAP_DATA*) ctx->data;
+  HEADER** hdrs;
+  HEADER** hp;
+  const char* key;
+  char buf[SHORT_STRING];
+  char* s;
+  unsigned int uid, pos = 0;
+  int reopen;
+  int i, lazy = 0;
+  int rc;
+
+  for (i = 0; i < ctx->msgcount; i++)
+    if (HEADER_DATA (ctx->hdrs[i])->lazy)
+      lazy++;
+  if (!lazy)
+    return 0;
+
+  /* called from imap_cmd_finish(): keep the order the headers are in,
+   * and sort them properly once the command is done */
+  if (idata->defer_sort)
+  {
+    set_option (OPTNEEDRESORT);
+    return 1;
+  }
+
+  if (!imap_sort_lazy (idata, method))
+  {
+    imap_read_all_envelopes (idata);
+    return 0;
+  }
+  if (!*(key = sort_key (method)))
+    return 0;
+
+  hdrs = safe_malloc (ctx->msgcount * sizeof (HEADER*));
+  memcpy (hdrs, ctx->hdrs, ctx->msgcount * sizeof (HEADER*));
+  qsort (hdrs, ctx->msgcount, sizeof (HEADER*), compare_uid);
+  for (i = 0; i < ctx->msgcount; i++)
+    HEADER_DATA (hdrs[i])->sortpos = (unsigned int) -1;
+
+  snprintf (buf, sizeof (buf), "UID SORT (%s) UTF-8 ALL", key);
+
+  /* the index must not change until it is sorted */
+  reopen = idata->reopen & IMAP_REOPEN_ALLOW;
+  idata->reopen &= ~IMAP_REOPEN_ALLOW;
+
+  imap_cmd_start (idata, buf);
+  while ((rc = imap_cmd_step (idata)) == IMAP_CMD_CONTINUE)
+  {
+    if (ascii_strncasecmp ("* SORT", idata->buf, 6))
+      continue;
+
+    s = idata->buf + 6;
+    SKIPWS (s);
+    while (isdigit ((unsigned char) *s))
+    {
+      uid = (unsigned int) strtoul (s, &s, 10);
+      if ((hp = bsearch (&uid, hdrs, ctx->msgcount, sizeof (HEADER*),
+                         find_uid)))
+        HEADER_DATA (*hp)->sortpos = pos++;
+      SKIPWS (s);
+    }
+  }
+
+  idata->reopen |= reopen;
+  FREE (&hdrs);
+
+  if (rc != IMAP_CMD_OK)
+  {
+    dprint (1, (debugfile, "imap_sort_headers: SORT by %s failed\n", key));
+    imap_read_all_envelopes (idata);
+    return 0;
+  }
+
+  qsort (ctx->hdrs, ctx->msgcount, sizeof (HEADER*), compare_server_order);
+
+  return 1;
+}
+
 int imap_subscribe (char *path, int subscribe)
 {
   IMAP_DATA *idata;
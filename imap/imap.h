@@ -42,6 +42,7 @@ int imap_close_mailbox (CONTEXT *ctx);
 int imap_buffy_check (int force);
 int imap_status (char *path, int queue);
 int imap_search (CONTEXT* ctx, const pattern_t* pat);
+int imap_sort_headers (CONTEXT* ctx, int method);
 int imap_subscribe (char *path, int subscribe);
 int imap_complete (char* dest, size_t dlen, char* path);
 
@@ -56,8 +57,13 @@ int imap_mailbox_rename (const char* mailbox);
 
 /* message.c */
 int imap_append_message (CONTEXT* ctx, MESSAGE* msg);
+void imap_append_batch (CONTEXT* ctx, int batch);
+int imap_append_pending (CONTEXT* ctx);
+int imap_append_flush (CONTEXT* ctx);
 int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete);
 int imap_fetch_message (MESSAGE* msg, CONTEXT* ctx, int msgno);
+int imap_read_envelopes (CONTEXT* ctx, HEADER* h, int first, int last);
+int imap_read_tagged_envelopes (CONTEXT* ctx, HEADER* h);
 
 /* socket.c */
 void imap_logout_all (void);
@@ -65,6 +65,10 @@
 #define IMAP_EXPUNGE_PENDING  (1<<2)
 #define IMAP_NEWMAIL_PENDING  (1<<3)
 #define IMAP_FLAGS_PENDING    (1<<4)
+/* the expected EXPUNGEs are for messages moved away with UID MOVE */
+#define IMAP_MOVE_EXPECTED    (1<<5)
+/* check_status: messages we moved away have been expunged */
+#define IMAP_MOVED_PENDING    (1<<6)
 
 /* imap_exec flags (see imap_exec) */
 #define IMAP_CMD_FAIL_OK (1<<0)
@@ -116,6 +120,14 @@ enum
   IDLE,                         /* RFC 2177: IDLE */
   SASL_IR,                      /* SASL initial response draft */
   ENABLE,                       /* RFC 5161 */
+  COMPRESS_DEFLATE,             /* RFC 4978: COMPRESS=DEFLATE */
+  LITERALPLUS,                  /* RFC 7888: LITERAL+ */
+  LITERALMINUS,                 /* RFC 7888: LITERAL- */
+  MULTIAPPEND,                  /* RFC 3502: MULTIAPPEND */
+  UIDPLUS,                      /* RFC 4315: UIDPLUS */
+  MOVE,                         /* RFC 6851: MOVE */
+  CONDSTORE,                    /* RFC 7162: CONDSTORE */
+  SORT,                         /* RFC 5256: SORT */
 
   CAPMAX
 };
@@ -124,6 +136,17 @@ enum
 #define M_IMAP_CONN_NONEW    (1<<0)
 #define M_IMAP_CONN_NOSELECT (1<<1)
 
+/* minimum number of headers each connection fetches with
+ * $imap_fetch_connections */
+#define IMAP_FETCH_SPLIT_MIN 1000
+
+/* minimum number of headers to fetch before $imap_lazy_headers applies */
+#define IMAP_LAZY_MIN 1000
+
+/* flush queued appends after this many messages or bytes */
+#define IMAP_APPEND_BATCH 100
+#define IMAP_APPEND_BATCH_BYTES (8 * 1024 * 1024)
+
 /* -- data structures -- */
 typedef struct
 {
@@ -166,6 +189,16 @@ typedef enum
   IMAP_CT_STATUS
 } IMAP_COMMAND_TYPE;
 
+/* a message waiting to be sent in a MULTIAPPEND command */
+typedef struct imap_append_msg
+{
+  char *path;			/* temporary file, owned by the queue */
+  size_t len;			/* length after CRLF conversion */
+  char flags[SHORT_STRING];
+  char date[IMAP_DATELEN];
+  struct imap_append_msg *next;
+} IMAP_APPEND_MSG;
+
 typedef struct
 {
   /* This data is specific to a CONNECTION to an IMAP server */
@@ -206,6 +239,20 @@ typedef struct
   /* cache IMAP_STATUS of visited mailboxes */
   LIST* mboxcache;
 
+  /* appends queued for a single MULTIAPPEND, see imap_append_batch() */
+  unsigned int append_batch : 1;
+  char *append_mbox;
+  IMAP_APPEND_MSG *append_queue;
+  IMAP_APPEND_MSG **append_tail;
+  int append_count;
+  size_t append_bytes;
+
+  /* COPYUID response codes of the last COPY or MOVE */
+  LIST *copyuid;
+
+  /* MODIFIED response codes of conditional STOREs, see imap_sync_modified() */
+  LIST *modified;
+
   /* The following data is all specific to the currently SELECTED mbox */
   char delim;
   CONTEXT *ctx;
@@ -216,6 +263,10 @@ typedef struct
   IMAP_CACHE cache[IMAP_CACHE_LEN];
   unsigned int uid_validity;
   unsigned int uidnext;
+  unsigned long long modseq;	/* HIGHESTMODSEQ, 0 without CONDSTORE */
+  /* a command is still being completed: imap_sort_headers() must not
+   * issue one of its own */
+  unsigned int defer_sort : 1;
   body_cache_t *bcache;
 
   /* all folder flags - system flags AND keywords */
@@ -242,10 +293,14 @@ int imap_open_connection (IMAP_DATA* idata);
 void imap_close_connection (IMAP_DATA* idata);
 IMAP_DATA* imap_conn_find (const ACCOUNT* account, int flags);
 int imap_read_literal (FILE* fp, IMAP_DATA* idata, long bytes, progress_t*);
+int imap_read_literal_buffer (BUFFER* buf, IMAP_DATA* idata, long bytes);
 void imap_expunge_mailbox (IMAP_DATA* idata);
 void imap_logout (IMAP_DATA** idata);
 int imap_sync_message (IMAP_DATA *idata, HEADER *hdr, BUFFER *cmd,
   int *err_continue);
+int imap_sync_messages (IMAP_DATA *idata, HEADER **hdrs, int count);
+int imap_sync_modified (IMAP_DATA *idata);
+int imap_sort_lazy (IMAP_DATA* idata, int method);
 int imap_has_flag (LIST* flag_list, const char* flag);
 
 /* auth.c */
@@ -264,9 +319,13 @@ int imap_cmd_idle (IMAP_DATA* idata);
 void imap_add_keywords (char* s, HEADER* keywords, LIST* mailbox_flags, size_t slen);
 void imap_free_header_data (IMAP_HEADER_DATA** data);
 int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend);
+int imap_read_all_envelopes (IMAP_DATA* idata);
 char* imap_set_flags (IMAP_DATA* idata, HEADER* h, char* s);
+char* imap_parse_modseq (char* s, unsigned long long* modseq);
+void imap_update_modseq (IMAP_DATA* idata, unsigned long long modseq);
 int imap_cache_del (IMAP_DATA* idata, HEADER* h);
 int imap_cache_clean (IMAP_DATA* idata);
+void imap_append_discard (IMAP_DATA* idata);
 
 /* util.c */
 #ifdef USE_HCACHE
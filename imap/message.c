@@ -26,11 +26,17 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include "mutt.h"
 #include "imap_private.h"
 #include "mx.h"
+#include "sort.h"
+#include "timing.h"
 
 #ifdef HAVE_PGP
 #include "pgp.h"
@@ -47,8 +53,15 @@ static FILE* msg_cache_put (IMAP_DATA* idata, HEADER* h);
 static int msg_cache_commit (IMAP_DATA* idata, HEADER* h);
 
 static void flush_buffer(char* buf, size_t* len, CONNECTION* conn);
-static int msg_fetch_header (CONTEXT* ctx, IMAP_HEADER* h, char* buf,
-  FILE* fp);
+static int msg_fetch_header (IMAP_DATA* idata, IMAP_HEADER* h, char* buf,
+  BUFFER* hbuf);
+static char* msg_header_request (IMAP_DATA* idata);
+static HEADER* msg_new_header (IMAP_HEADER* h, BUFFER* hbuf);
+static void msg_envelope_done (CONTEXT* ctx, HEADER* h);
+static int read_envelopes (IMAP_DATA* idata, HEADER** hdrs, int count,
+  progress_t* progress);
+static int read_headers_split (IMAP_DATA* idata, int msgbegin, int msgend,
+  const char* hdrreq, BUFFER* hbuf, int* maxuid);
 static int msg_parse_fetch (IMAP_HEADER* h, char* s);
 static char* msg_parse_flags (IMAP_HEADER* h, char* s);
 
@@ -61,17 +74,17 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
 {
   CONTEXT* ctx;
   char *hdrreq = NULL;
-  FILE *fp;
-  char tempfile[_POSIX_PATH_MAX];
+  BUFFER *hbuf;
   int msgno, idx = msgbegin - 1;
   IMAP_HEADER h;
   IMAP_STATUS* status;
   int rc, mfhrc, oldmsgcount;
   int fetchlast = 0;
   int maxuid = 0;
-  static const char * const want_headers = "DATE FROM SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL";
+  int lazy;
   progress_t progress;
   int retval = -1;
+  timing_t start = mutt_timing_now ();
 
 #if USE_HCACHE
   char buf[LONG_STRING];
@@ -83,17 +96,7 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
 
   ctx = idata->ctx;
 
-  if (mutt_bit_isset (idata->capabilities,IMAP4REV1))
-  {
-    safe_asprintf (&hdrreq, "BODY.PEEK[HEADER.FIELDS (%s%s%s)]",
-                           want_headers, ImapHeaders ? " " : "", NONULL (ImapHeaders));
-  }
-  else if (mutt_bit_isset (idata->capabilities,IMAP4))
-  {
-    safe_asprintf (&hdrreq, "RFC822.HEADER.LINES (%s%s%s)",
-                           want_headers, ImapHeaders ? " " : "", NONULL (ImapHeaders));
-  }
-  else
+  if (!(hdrreq = msg_header_request (idata)))
   {	/* Unable to fetch headers for lower versions */
     mutt_error _("Unable to fetch headers from this IMAP server version.");
     mutt_sleep (2);	/* pause a moment to let the user see the error */
@@ -102,14 +105,7 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
 
   /* instead of downloading all headers and then parsing them, we parse them
    * as they come in. */
-  mutt_mktemp (tempfile, sizeof (tempfile));
-  if (!(fp = safe_fopen (tempfile, "w+")))
-  {
-    mutt_error (_("Could not create temporary file %s"), tempfile);
-    mutt_sleep (2);
-    goto error_out_0;
-  }
-  unlink (tempfile);
+  hbuf = mutt_buffer_new ();
 
   /* make sure context has room to hold the mailbox */
   while ((msgend) >= idata->ctx->hdrmax)
@@ -143,7 +139,8 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
 			M_PROGRESS_MSG, ReadInc, msgend + 1);
 
     snprintf (buf, sizeof (buf),
-      "UID FETCH 1:%u (UID FLAGS)", uidnext - 1);
+      "UID FETCH 1:%u (UID FLAGS%s)", uidnext - 1,
+      idata->modseq ? " MODSEQ" : "");
 
     imap_cmd_start (idata, buf);
 
@@ -169,7 +166,7 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
         if (!evalhc)
           continue;
 
-        if ((mfhrc = msg_fetch_header (ctx, &h, idata->buf, NULL)) == -1)
+        if ((mfhrc = msg_fetch_header (idata, &h, idata->buf, NULL)) == -1)
           continue;
         else if (mfhrc < 0)
 	{
@@ -201,6 +198,7 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
           ctx->hdrs[idx]->changed = h.data->changed;
           /*  ctx->hdrs[msgno]->received is restored from mutt_hcache_restore */
           ctx->hdrs[idx]->data = (void *) (h.data);
+          imap_update_modseq (idata, h.data->modseq);
 
           ctx->msgcount++;
           ctx->size += ctx->hdrs[idx]->content->length;
@@ -229,6 +227,37 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
   }
 #endif /* USE_HCACHE */
 
+  /* no point if sorting needs every envelope at once */
+  lazy = option (OPTIMAPLAZYHEADERS) && imap_sort_lazy (idata, Sort) &&
+    msgend - msgbegin + 1 >= IMAP_LAZY_MIN;
+
+  if (!lazy && ImapFetchConnections > 0 &&
+      msgend - msgbegin + 1 >= 2 * IMAP_FETCH_SPLIT_MIN)
+  {
+    if ((rc = read_headers_split (idata, msgbegin, msgend, hdrreq, hbuf,
+                                  &maxuid)) < 0)
+    {
+#if USE_HCACHE
+      imap_hcache_close (idata);
+#endif
+      goto error_out_1;
+    }
+    if (rc > 0)
+    {
+      idx = ctx->msgcount - 1;
+      msgbegin = msgend + 1;
+      /* new mail which arrived meanwhile is fetched the usual way */
+      if (idata->reopen & IMAP_NEWMAIL_PENDING)
+      {
+        msgend = idata->newMailCount - 1;
+        while ((msgend) >= ctx->hdrmax)
+          mx_alloc_memory (ctx);
+        idata->reopen &= ~IMAP_NEWMAIL_PENDING;
+        idata->newMailCount = 0;
+      }
+    }
+  }
+
   mutt_progress_init (&progress, _("Fetching message headers..."),
 		      M_PROGRESS_MSG, ReadInc, msgend + 1);
 
@@ -242,13 +271,14 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
       char *cmd;
 
       fetchlast = msgend + 1;
-      safe_asprintf (&cmd, "FETCH %d:%d (UID FLAGS INTERNALDATE RFC822.SIZE %s)",
-                     msgno + 1, fetchlast, hdrreq);
+      safe_asprintf (&cmd, "FETCH %d:%d (UID FLAGS%s INTERNALDATE RFC822.SIZE%s%s)",
+                     msgno + 1, fetchlast, idata->modseq ? " MODSEQ" : "",
+                     lazy ? "" : " ", lazy ? "" : hdrreq);
       imap_cmd_start (idata, cmd);
       FREE (&cmd);
     }
 
-    rewind (fp);
+    hbuf->dptr = hbuf->data;
     memset (&h, 0, sizeof (h));
     h.data = safe_calloc (1, sizeof (IMAP_HEADER_DATA));
 
@@ -264,12 +294,12 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
       if (rc != IMAP_CMD_CONTINUE)
 	break;
 
-      if ((mfhrc = msg_fetch_header (ctx, &h, idata->buf, fp)) == -1)
+      if ((mfhrc = msg_fetch_header (idata, &h, idata->buf, hbuf)) == -1)
 	continue;
       else if (mfhrc < 0)
 	break;
 
-      if (!ftello (fp))
+      if (!lazy && hbuf->dptr == hbuf->data)
       {
         dprint (2, (debugfile, "msg_fetch_header: ignoring fetch response with no body\n"));
         mfhrc = -1;
@@ -277,9 +307,6 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
         continue;
       }
 
-      /* make sure we don't get remnants from older larger message headers */
-      fputs ("\n\n", fp);
-
       idx++;
       if (idx > msgend)
       {
@@ -298,31 +325,13 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
 	continue;
       }
 
-      ctx->hdrs[idx] = mutt_new_header ();
-
-      ctx->hdrs[idx]->index = h.sid - 1;
-      /* messages which have not been expunged are ACTIVE (borrowed from mh
-       * folders) */
-      ctx->hdrs[idx]->active = 1;
-      ctx->hdrs[idx]->read = h.data->read;
-      ctx->hdrs[idx]->old = h.data->old;
-      ctx->hdrs[idx]->deleted = h.data->deleted;
-      ctx->hdrs[idx]->flagged = h.data->flagged;
-      ctx->hdrs[idx]->replied = h.data->replied;
-      ctx->hdrs[idx]->changed = h.data->changed;
-      ctx->hdrs[idx]->received = h.received;
-      ctx->hdrs[idx]->data = (void *) (h.data);
-
       if (maxuid < h.data->uid)
         maxuid = h.data->uid;
 
-      rewind (fp);
-      /* NOTE: if Date: header is missing, mutt_read_rfc822_header depends
-       *   on h.received being set */
-      ctx->hdrs[idx]->env = mutt_read_rfc822_header (fp, ctx->hdrs[idx],
-        0, 0);
-      /* content built as a side-effect of mutt_read_rfc822_header */
-      ctx->hdrs[idx]->content->length = h.content_length;
+      /* a lazy header gets an empty envelope until imap_read_envelopes() */
+      h.data->lazy = lazy;
+      imap_update_modseq (idata, h.data->modseq);
+      ctx->hdrs[idx] = msg_new_header (&h, hbuf);
       ctx->size += h.content_length;
 
 #if USE_HCACHE
@@ -383,11 +392,606 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
   retval = msgend;
 
 error_out_1:
-  safe_fclose (&fp);
+  mutt_buffer_free (&hbuf);
 
 error_out_0:
   FREE (&hdrreq);
 
+  mutt_timing_add (TIMING_IMAP_HEADERS, start, msgend - msgbegin + 1);
+
+  return retval;
+}
+
+/* msg_header_request: the FETCH item for the header fields mutt wants,
+ *   or NULL if the server is too old to ask for them. */
+static char* msg_header_request (IMAP_DATA* idata)
+{
+  static const char * const want_headers = "DATE FROM SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL";
+  char *hdrreq = NULL;
+
+  if (mutt_bit_isset (idata->capabilities,IMAP4REV1))
+  {
+    safe_asprintf (&hdrreq, "BODY.PEEK[HEADER.FIELDS (%s%s%s)]",
+                           want_headers, ImapHeaders ? " " : "", NONULL (ImapHeaders));
+  }
+  else if (mutt_bit_isset (idata->capabilities,IMAP4))
+  {
+    safe_asprintf (&hdrreq, "RFC822.HEADER.LINES (%s%s%s)",
+                           want_headers, ImapHeaders ? " " : "", NONULL (ImapHeaders));
+  }
+
+  return hdrreq;
+}
+
+/* msg_new_header: create a HEADER from a FETCH response parsed into h,
+ *   whose header lines msg_fetch_header() has collected in hbuf. */
+static HEADER* msg_new_header (IMAP_HEADER* h, BUFFER* hbuf)
+{
+  HEADER* hdr;
+
+  hdr = mutt_new_header ();
+
+  hdr->index = h->sid - 1;
+  /* messages which have not been expunged are ACTIVE (borrowed from mh
+   * folders) */
+  hdr->active = 1;
+  hdr->read = h->data->read;
+  hdr->old = h->data->old;
+  hdr->deleted = h->data->deleted;
+  hdr->flagged = h->data->flagged;
+  hdr->replied = h->data->replied;
+  hdr->changed = h->data->changed;
+  hdr->received = h->received;
+  hdr->data = (void *) (h->data);
+
+  /* NOTE: if Date: header is missing, mutt_read_rfc822_header_span depends
+   *   on h->received being set */
+  hdr->env = mutt_read_rfc822_header_span (hbuf->data, hbuf->dptr - hbuf->data,
+                                           hdr, 0, 0);
+  /* content built as a side-effect of mutt_read_rfc822_header_span */
+  hdr->content->length = h->content_length;
+
+  return hdr;
+}
+
+/* msg_envelope_done: the envelope of a lazily fetched header has just
+ *   been read. Make up for what mx_update_context() couldn't do with the
+ *   empty one. */
+static void msg_envelope_done (CONTEXT* ctx, HEADER* h)
+{
+  HEADER_DATA(h)->lazy = 0;
+  h->attach_valid = 0;
+  h->pair = 0;
+
+  if (ctx->id_hash && h->env->message_id)
+    hash_insert (ctx->id_hash, h->env->message_id, h, 0);
+  if (ctx->subj_hash && h->env->real_subj)
+    hash_insert (ctx->subj_hash, h->env->real_subj, h, 1);
+
+  if (option (OPTSCORE))
+    mutt_score_message (ctx, h, 1);
+}
+
+static int envelope_uid_cmp (const void* a, const void* b)
+{
+  unsigned int ua = HEADER_DATA (*(HEADER**) a)->uid;
+  unsigned int ub = HEADER_DATA (*(HEADER**) b)->uid;
+
+  return ua < ub ? -1 : ua > ub;
+}
+
+static int envelope_uid_find (const void* key, const void* elem)
+{
+  unsigned int uid = *(const unsigned int*) key;
+  unsigned int ue = HEADER_DATA (*(HEADER**) elem)->uid;
+
+  return uid < ue ? -1 : uid > ue;
+}
+
+/* read_envelopes: fetch the header fields of the lazily read headers in
+ *   hdrs, neighbouring messages collapsed into UID ranges.
+ *   Returns 0 on success, -1 on failure. */
+static int read_envelopes (IMAP_DATA* idata, HEADER** hdrs, int count,
+  progress_t* progress)
+{
+  CONTEXT* ctx = idata->ctx;
+  BUFFER* cmd = NULL;
+  BUFFER* hbuf = NULL;
+  HEADER** hp;
+  HEADER* hdr;
+  IMAP_HEADER h;
+  char* hdrreq;
+  LOFF_T length;
+  int reopen = idata->reopen & IMAP_REOPEN_ALLOW;
+  int fetched = 0;
+  int i, j, k, cmdrc, mfhrc;
+  int rc = -1;
+#if USE_HCACHE
+  int hcache = !idata->hcache;
+#endif
+
+  if (!(hdrreq = msg_header_request (idata)))
+    return -1;
+
+  cmd = mutt_buffer_new ();
+  hbuf = mutt_buffer_new ();
+
+  qsort (hdrs, count, sizeof (HEADER*), envelope_uid_cmp);
+
+  /* we may be called while the index is drawn: keep the message
+   * numbers where they are until we're done */
+  idata->reopen &= ~IMAP_REOPEN_ALLOW;
+#if USE_HCACHE
+  if (hcache)
+    idata->hcache = imap_hcache_open (idata, NULL);
+#endif
+
+  for (i = 0; i < count; i = j)
+  {
+    cmd->dptr = cmd->data;
+    mutt_buffer_addstr (cmd, "UID FETCH ");
+
+    /* j: start of the next range, k: end of this one */
+    for (j = i; j < count && cmd->dptr - cmd->data < IMAP_MAX_CMDLEN; j = k)
+    {
+      for (k = j + 1; k < count && hdrs[k]->index == hdrs[k - 1]->index + 1; k++)
+	;
+
+      mutt_buffer_printf (cmd, j == i ? "%u" : ",%u",
+			  HEADER_DATA (hdrs[j])->uid);
+      if (k - j > 1)
+	mutt_buffer_printf (cmd, ":%u", HEADER_DATA (hdrs[k - 1])->uid);
+    }
+    mutt_buffer_printf (cmd, " (UID %s)", hdrreq);
+
+    imap_cmd_start (idata, cmd->data);
+    FOREVER
+    {
+      hbuf->dptr = hbuf->data;
+      memset (&h, 0, sizeof (h));
+      h.data = safe_calloc (1, sizeof (IMAP_HEADER_DATA));
+
+      if ((cmdrc = imap_cmd_step (idata)) != IMAP_CMD_CONTINUE)
+      {
+	imap_free_header_data (&h.data);
+	break;
+      }
+
+      if ((mfhrc = msg_fetch_header (idata, &h, idata->buf, hbuf)) < -1)
+      {
+	imap_free_header_data (&h.data);
+	goto out;
+      }
+
+      hp = bsearch (&h.data->uid, hdrs + i, j - i, sizeof (HEADER*),
+		    envelope_uid_find);
+      if (mfhrc || hbuf->dptr == hbuf->data || !hp || !HEADER_DATA (*hp)->lazy)
+      {
+	imap_free_header_data (&h.data);
+	continue;
+      }
+      hdr = *hp;
+      length = hdr->content->length;
+      mutt_free_envelope (&hdr->env);
+      mutt_free_body (&hdr->content);
+      hdr->env = mutt_read_rfc822_header_span (hbuf->data,
+                                               hbuf->dptr - hbuf->data,
+                                               hdr, 0, 0);
+      /* msg_fetch_header() subtracted the header lines from nothing */
+      hdr->content->length = length + h.content_length;
+      ctx->size += h.content_length;
+#if defined(HAVE_PGP) || defined(HAVE_SMIME)
+      hdr->security = crypt_query (hdr->content);
+#endif
+      msg_envelope_done (ctx, hdr);
+#if USE_HCACHE
+      imap_hcache_put (idata, hdr);
+#endif
+
+      imap_free_header_data (&h.data);
+      if (progress)
+	mutt_progress_update (progress, ++fetched, -1);
+    }
+
+    if (cmdrc != IMAP_CMD_OK)
+      goto out;
+
+    /* whatever the server had nothing for has been expunged meanwhile.
+     * Don't ask for it again each time the index is drawn. */
+    for (k = i; k < j; k++)
+      HEADER_DATA (hdrs[k])->lazy = 0;
+  }
+
+  rc = 0;
+
+out:
+#if USE_HCACHE
+  if (hcache)
+    imap_hcache_close (idata);
+#endif
+  idata->reopen |= reopen;
+  mutt_buffer_free (&hbuf);
+  mutt_buffer_free (&cmd);
+  FREE (&hdrreq);
+
+  return rc;
+}
+
+/* imap_read_envelopes: make sure h, read with $imap_lazy_headers, has its
+ *   envelope. The ones still missing among virtual messages first to last
+ *   are fetched along with it, so that paging through the index costs a
+ *   round trip per screen rather than per message. */
+int imap_read_envelopes (CONTEXT* ctx, HEADER* h, int first, int last)
+{
+  HEADER** hdrs;
+  HEADER* cur;
+  int i, count = 0;
+  int rc;
+
+  if (!HEADER_DATA (h)->lazy)
+    return 0;
+
+  if (first < 0)
+    first = 0;
+  if (last >= ctx->vcount)
+    last = ctx->vcount - 1;
+
+  hdrs = safe_calloc (last >= first ? last - first + 2 : 1, sizeof (HEADER*));
+  hdrs[count++] = h;
+  for (i = first; i <= last; i++)
+  {
+    cur = ctx->hdrs[ctx->v2r[i]];
+    if (cur != h && HEADER_DATA (cur)->lazy)
+      hdrs[count++] = cur;
+  }
+
+  rc = read_envelopes ((IMAP_DATA*) ctx->data, hdrs, count, NULL);
+  FREE (&hdrs);
+
+  return rc;
+}
+
+/* imap_read_tagged_envelopes: make sure h, or every tagged message if h
+ *   is NULL, has its envelope, for operations on messages which may not
+ *   have been drawn yet (tag-prefix commands, replies, forwards) */
+int imap_read_tagged_envelopes (CONTEXT* ctx, HEADER* h)
+{
+  HEADER** hdrs;
+  int i, count = 0;
+  int rc = 0;
+
+  if (ctx->magic != M_IMAP)
+    return 0;
+  if (h)
+    return imap_read_envelopes (ctx, h, 0, -1);
+
+  hdrs = safe_calloc (ctx->msgcount ? ctx->msgcount : 1, sizeof (HEADER*));
+  for (i = 0; i < ctx->msgcount; i++)
+    if (ctx->hdrs[i]->tagged && HEADER_DATA (ctx->hdrs[i])->lazy)
+      hdrs[count++] = ctx->hdrs[i];
+
+  if (count)
+    rc = read_envelopes ((IMAP_DATA*) ctx->data, hdrs, count, NULL);
+  FREE (&hdrs);
+
+  return rc;
+}
+
+/* imap_read_all_envelopes: fetch every envelope $imap_lazy_headers left
+ *   out, for operations which need to look at all messages. */
+int imap_read_all_envelopes (IMAP_DATA* idata)
+{
+  CONTEXT* ctx = idata->ctx;
+  HEADER** hdrs;
+  progress_t progress;
+  int i, count = 0;
+  int rc = 0;
+
+  hdrs = safe_calloc (ctx->msgcount ? ctx->msgcount : 1, sizeof (HEADER*));
+  for (i = 0; i < ctx->msgcount; i++)
+    if (HEADER_DATA (ctx->hdrs[i])->lazy)
+      hdrs[count++] = ctx->hdrs[i];
+
+  if (count)
+  {
+    mutt_progress_init (&progress, _("Fetching message headers..."),
+			M_PROGRESS_MSG, ReadInc, count);
+    rc = read_envelopes (idata, hdrs, count, &progress);
+  }
+  FREE (&hdrs);
+
+  return rc;
+}
+
+/* one connection taking part in read_headers_split() */
+typedef struct
+{
+  IMAP_DATA* idata;
+  int first;		/* range of message numbers, counting from 0 */
+  int last;
+  int done;
+} FETCH_STREAM;
+
+/* split_close: log out of an extra connection opened for
+ *   read_headers_split() and forget about it */
+static void split_close (IMAP_DATA* idata)
+{
+  CONNECTION* conn = idata->conn;
+
+  if (idata->status != IMAP_FATAL && idata->state >= IMAP_AUTHENTICATED)
+    imap_logout (&idata);
+  else
+  {
+    mutt_socket_close (conn);
+    imap_free_idata (&idata);
+  }
+  mutt_socket_free (conn);
+}
+
+/* split_open: open up to n extra connections which EXAMINE the mailbox
+ *   selected by idata, and make sure they see the same msgcount messages.
+ *   Returns the number of connections in streams. */
+static int split_open (IMAP_DATA* idata, FETCH_STREAM* streams, int n,
+                       int msgcount)
+{
+  IMAP_DATA* sidata;
+  char mbox[LONG_STRING];
+  char buf[LONG_STRING];
+  char* s;
+  unsigned int uidvalidity;
+  int exists;
+  int count = 0;
+  int i, rc;
+
+  for (i = 0; i < n; i++)
+  {
+    if (!(sidata = imap_conn_find (&idata->conn->account, M_IMAP_CONN_NOSELECT)))
+      break;
+    /* looks taken to the next imap_conn_find(), until we're done here */
+    sidata->state = IMAP_SELECTED;
+    streams[count++].idata = sidata;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    sidata = streams[i].idata;
+    /* the connections don't have a context, keep cmd_handle_untagged()
+     * away from EXISTS, EXPUNGE and FETCH */
+    sidata->state = IMAP_AUTHENTICATED;
+    imap_munge_mbox_name (sidata, mbox, sizeof (mbox), idata->mailbox);
+    snprintf (buf, sizeof (buf), "EXAMINE %s", mbox);
+    if (imap_cmd_start (sidata, buf) < 0)
+      streams[i].done = -1;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    sidata = streams[i].idata;
+    exists = -1;
+    uidvalidity = 0;
+    rc = IMAP_CMD_BAD;
+    while (!streams[i].done && (rc = imap_cmd_step (sidata)) == IMAP_CMD_CONTINUE)
+    {
+      s = imap_next_word (sidata->buf);
+      if (!ascii_strncasecmp ("OK [UIDVALIDITY", s, 15))
+        uidvalidity = strtoul (imap_next_word (s + 3), NULL, 10);
+      else if (isdigit ((unsigned char) *s) &&
+               !ascii_strncasecmp ("EXISTS", imap_next_word (s), 6))
+        exists = atoi (s);
+    }
+    /* a message expunged meanwhile would shift all sequence numbers */
+    if (rc != IMAP_CMD_OK || exists != msgcount ||
+        uidvalidity != idata->uid_validity)
+    {
+      dprint (2, (debugfile, "split_open: connection %d sees %d messages (UIDVALIDITY %u), ignoring it\n",
+                  i, exists, uidvalidity));
+      streams[i].done = -1;
+    }
+  }
+
+  /* keep the usable ones */
+  for (i = n = 0; i < count; i++)
+  {
+    if (streams[i].done)
+      split_close (streams[i].idata);
+    else
+      streams[n++] = streams[i];
+  }
+
+  return n;
+}
+
+/* split_step: handle one response on stream s.
+ *   Returns 0 when the response was handled, 1 when the stream's FETCH is
+ *   done, -1 on error. */
+static int split_step (CONTEXT* ctx, FETCH_STREAM* s, BUFFER* hbuf, int* count,
+                       int* maxuid)
+{
+  IMAP_HEADER h;
+  int rc, mfhrc;
+
+  if ((rc = imap_cmd_step (s->idata)) != IMAP_CMD_CONTINUE)
+    return rc == IMAP_CMD_OK ? 1 : -1;
+
+  hbuf->dptr = hbuf->data;
+  memset (&h, 0, sizeof (h));
+  h.data = safe_calloc (1, sizeof (IMAP_HEADER_DATA));
+
+  if ((mfhrc = msg_fetch_header (s->idata, &h, s->idata->buf, hbuf)) < 0 ||
+      hbuf->dptr == hbuf->data || h.sid < s->first + 1 || h.sid > s->last + 1 ||
+      ctx->hdrs[h.sid - 1])
+  {
+    imap_free_header_data (&h.data);
+    /* untagged responses and FLAGS updates are fine */
+    return mfhrc < -1 ? -1 : 0;
+  }
+
+  ctx->hdrs[h.sid - 1] = msg_new_header (&h, hbuf);
+  if (*maxuid < h.data->uid)
+    *maxuid = h.data->uid;
+  (*count)++;
+
+  return 0;
+}
+
+/* read_headers_split: fetch the headers of messages msgbegin to msgend
+ *   over several connections at once, see $imap_fetch_connections. The
+ *   selected connection takes the first slice. Responses are read from
+ *   whichever connection has some ready, and the headers parsed into
+ *   their place in ctx->hdrs.
+ *   Returns the number of headers added to the context, 0 if the caller
+ *   should fetch the headers itself, or -1 if the selected connection
+ *   failed. */
+static int read_headers_split (IMAP_DATA* idata, int msgbegin, int msgend,
+                               const char* hdrreq, BUFFER* hbuf, int* maxuid)
+{
+  CONTEXT* ctx = idata->ctx;
+  FETCH_STREAM* streams;
+  progress_t progress;
+  char* cmd;
+  fd_set rfds;
+  struct timeval tv;
+  unsigned int lastuid = 0;
+  int nstreams, nactive;
+  int count = 0;
+  int maxfd, ready, i, n, rc;
+  int retval = 0;
+
+  nstreams = (msgend - msgbegin + 1) / IMAP_FETCH_SPLIT_MIN;
+  if (nstreams > ImapFetchConnections + 1)
+    nstreams = ImapFetchConnections + 1;
+
+  streams = safe_calloc (nstreams, sizeof (FETCH_STREAM));
+  streams[0].idata = idata;
+  if ((nstreams = split_open (idata, streams + 1, nstreams - 1, msgend + 1) + 1) == 1)
+  {
+    FREE (&streams);
+    return 0;
+  }
+
+  dprint (2, (debugfile, "read_headers_split: fetching %d headers over %d connections\n",
+              msgend - msgbegin + 1, nstreams));
+
+  for (i = 0; i < nstreams; i++)
+  {
+    streams[i].first = msgbegin + (msgend - msgbegin + 1) * i / nstreams;
+    streams[i].last = msgbegin + (msgend - msgbegin + 1) * (i + 1) / nstreams - 1;
+    safe_asprintf (&cmd, "FETCH %d:%d (UID FLAGS%s INTERNALDATE RFC822.SIZE %s)",
+                   streams[i].first + 1, streams[i].last + 1,
+                   idata->modseq ? " MODSEQ" : "", hdrreq);
+    rc = imap_cmd_start (streams[i].idata, cmd);
+    FREE (&cmd);
+    if (rc < 0)
+    {
+      retval = i ? 0 : -1;
+      goto out;
+    }
+  }
+
+  mutt_progress_init (&progress, _("Fetching message headers..."),
+		      M_PROGRESS_MSG, ReadInc, msgend + 1);
+
+  nactive = nstreams;
+  while (nactive)
+  {
+    ready = 0;
+    for (i = 0; i < nstreams; i++)
+    {
+      /* a few responses at a time, so no connection gets far behind */
+      for (n = 0; !streams[i].done && n < 64 &&
+             mutt_socket_poll (streams[i].idata->conn) != 0; n++)
+      {
+        if ((rc = split_step (ctx, &streams[i], hbuf, &count, maxuid)) < 0)
+        {
+          dprint (1, (debugfile, "read_headers_split: connection %d failed\n", i));
+          retval = i ? 0 : -1;
+          goto out;
+        }
+        if (rc)
+        {
+          streams[i].done = 1;
+          nactive--;
+        }
+        ready = 1;
+      }
+    }
+    mutt_progress_update (&progress, msgbegin + count, -1);
+
+    if (ready || !nactive)
+      continue;
+
+    /* wait for any of them */
+    FD_ZERO (&rfds);
+    maxfd = -1;
+    for (i = 0; i < nstreams; i++)
+    {
+      if (streams[i].done || streams[i].idata->conn->fd < 0)
+        continue;
+      FD_SET (streams[i].idata->conn->fd, &rfds);
+      if (streams[i].idata->conn->fd > maxfd)
+        maxfd = streams[i].idata->conn->fd;
+    }
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    if (maxfd >= 0 && select (maxfd + 1, &rfds, NULL, NULL, &tv) < 0 &&
+        errno != EINTR)
+    {
+      mutt_perror ("select");
+      retval = 0;
+      goto out;
+    }
+  }
+
+  /* pack the headers into sequence order. UIDs must ascend with it, or
+   * the mailbox changed under our feet after all. */
+  for (i = msgbegin; i <= msgend; i++)
+  {
+    if (!ctx->hdrs[i])
+      continue;
+    if (HEADER_DATA (ctx->hdrs[i])->uid <= lastuid)
+    {
+      dprint (1, (debugfile, "read_headers_split: UID %u out of order\n",
+                  HEADER_DATA (ctx->hdrs[i])->uid));
+      retval = 0;
+      goto out;
+    }
+    lastuid = HEADER_DATA (ctx->hdrs[i])->uid;
+  }
+  for (i = msgbegin; i <= msgend; i++)
+  {
+    if (!ctx->hdrs[i])
+      continue;
+    ctx->hdrs[ctx->msgcount] = ctx->hdrs[i];
+    if (ctx->msgcount != i)
+      ctx->hdrs[i] = NULL;
+    ctx->size += ctx->hdrs[ctx->msgcount]->content->length;
+#if USE_HCACHE
+    imap_hcache_put (idata, ctx->hdrs[ctx->msgcount]);
+#endif
+    ctx->msgcount++;
+  }
+  retval = count;
+
+out:
+  /* on failure, throw away what we've got so far */
+  if (retval <= 0)
+  {
+    /* the selected connection may still be busy with its slice */
+    if (!retval)
+      while (!streams[0].done && split_step (ctx, &streams[0], hbuf, &count, maxuid) == 0)
+        ;
+    for (i = msgbegin; i <= msgend; i++)
+      if (ctx->hdrs[i])
+      {
+        imap_free_header_data ((IMAP_HEADER_DATA**) (void*) &ctx->hdrs[i]->data);
+        mutt_free_header (&ctx->hdrs[i]);
+      }
+    *maxuid = 0;
+  }
+  for (i = 1; i < nstreams; i++)
+    split_close (streams[i].idata);
+  FREE (&streams);
+
   return retval;
 }
 
@@ -517,6 +1121,11 @@ int imap_fetch_message (MESSAGE *msg, CONTEXT *ctx, int msgno)
 	  if ((pc = imap_set_flags (idata, h, pc)) == NULL)
 	    goto bail;
 	}
+	else if ((ascii_strncasecmp ("MODSEQ", pc, 6) == 0) && !h->changed)
+	{
+	  pc = imap_parse_modseq (pc + 6, &HEADER_DATA(h)->modseq);
+	  imap_update_modseq (idata, HEADER_DATA(h)->modseq);
+	}
       }
     }
   }
@@ -553,6 +1162,8 @@ int imap_fetch_message (MESSAGE *msg, CONTEXT *ctx, int msgno)
   read = h->read;
   newenv = mutt_read_rfc822_header (msg->fp, h, 0, 0);
   mutt_merge_envelopes(h->env, &newenv);
+  if (HEADER_DATA(h)->lazy)
+    msg_envelope_done (ctx, h);
 
   /* see above. We want the new status in h->read, so we unset it manually
    * and let mutt_set_flag set it correctly, updating context. */
@@ -595,148 +1206,451 @@ bail:
   return -1;
 }
 
-int imap_append_message (CONTEXT *ctx, MESSAGE *msg)
+/* append_length: length of the message in fp once bare LFs become CRLF */
+static size_t append_length (FILE *fp)
 {
-  IMAP_DATA* idata;
-  FILE *fp;
+  char buf[LONG_STRING * 4];
+  char *p, *end;
+  size_t n, len = 0;
+  int last = EOF;
+
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+  {
+    len += n;
+    end = buf + n;
+    for (p = buf; (p = memchr (p, '\n', end - p)); p++)
+      if ((p > buf ? p[-1] : last) != '\r')
+	len++;
+    last = (unsigned char) end[-1];
+  }
+  rewind (fp);
+
+  return len;
+}
+
+/* append_send_literal: stream fp to the server, converting LF to CRLF */
+static int append_send_literal (IMAP_DATA *idata, FILE *fp,
+				progress_t *progressbar, size_t *sent)
+{
+  char bufi[LONG_STRING * 4];
+  char bufo[sizeof (bufi) * 2 + 1];
+  size_t n, i, len;
+  int last = EOF;
+
+  while ((n = fread (bufi, 1, sizeof (bufi), fp)) > 0)
+  {
+    for (i = 0, len = 0; i < n; last = bufi[i++])
+    {
+      if (bufi[i] == '\n' && last != '\r')
+	bufo[len++] = '\r';
+      bufo[len++] = bufi[i];
+    }
+
+    *sent += len;
+    flush_buffer (bufo, &len, idata->conn);
+    mutt_progress_update (progressbar, *sent, -1);
+  }
+
+  return ferror (fp) ? -1 : 0;
+}
+
+/* append_nonsync: can the literal be sent without waiting for the
+ * server's continuation request? */
+static int append_nonsync (IMAP_DATA *idata, size_t len)
+{
+  return mutt_bit_isset (idata->capabilities, LITERALPLUS) ||
+    (mutt_bit_isset (idata->capabilities, LITERALMINUS) && len <= 4096);
+}
+
+static void append_error (IMAP_DATA *idata)
+{
+  char *pc;
+
+  dprint (1, (debugfile, "imap_append_message(): command failed: %s\n",
+	      idata->buf));
+
+  pc = idata->buf + SEQLEN;
+  SKIPWS (pc);
+  pc = imap_next_word (pc);
+  mutt_error ("%s", pc);
+  mutt_sleep (1);
+}
+
+/* append_send: send the messages in the list am as the arguments of a
+ * single APPEND command (more than one requires MULTIAPPEND). */
+static int append_send (IMAP_DATA *idata, const char *mbox, IMAP_APPEND_MSG *am)
+{
+  IMAP_APPEND_MSG *cur;
+  progress_t progressbar;
   char buf[LONG_STRING];
-  char mbox[LONG_STRING];
+  FILE *fp;
+  size_t total = 0, sent = 0;
+  int nonsync, rc;
+
+  for (cur = am; cur; cur = cur->next)
+    total += cur->len;
+
+  mutt_progress_init (&progressbar, _("Uploading message..."),
+		      M_PROGRESS_SIZE, NetInc, total);
+
+  for (cur = am; cur; cur = cur->next)
+  {
+    if ((fp = fopen (cur->path, "r")) == NULL)
+    {
+      mutt_perror (cur->path);
+      /* the server is waiting for the rest of the command, nothing
+       * sensible can follow on this connection */
+      if (cur != am)
+	idata->status = IMAP_FATAL;
+      return -1;
+    }
+
+    nonsync = append_nonsync (idata, cur->len);
+    if (cur == am)
+    {
+      snprintf (buf, sizeof (buf), "APPEND %s (%s) \"%s\" {%lu%s}", mbox,
+		cur->flags, cur->date, (unsigned long) cur->len,
+		nonsync ? "+" : "");
+      imap_cmd_start (idata, buf);
+    }
+    else
+    {
+      snprintf (buf, sizeof (buf), " (%s) \"%s\" {%lu%s}\r\n", cur->flags,
+		cur->date, (unsigned long) cur->len, nonsync ? "+" : "");
+      mutt_socket_write (idata->conn, buf);
+    }
+
+    if (!nonsync)
+    {
+      do
+	rc = imap_cmd_step (idata);
+      while (rc == IMAP_CMD_CONTINUE);
+
+      if (rc != IMAP_CMD_RESPOND)
+      {
+	append_error (idata);
+	safe_fclose (&fp);
+	return -1;
+      }
+    }
+
+    rc = append_send_literal (idata, fp, &progressbar, &sent);
+    safe_fclose (&fp);
+    if (rc < 0)
+    {
+      mutt_perror (cur->path);
+      idata->status = IMAP_FATAL;
+      return -1;
+    }
+  }
+
+  mutt_socket_write (idata->conn, "\r\n");
+
+  do
+    rc = imap_cmd_step (idata);
+  while (rc == IMAP_CMD_CONTINUE);
+
+  if (!imap_code (idata->buf))
+  {
+    append_error (idata);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int append_mailbox (IMAP_DATA *idata, const char *path, char *mbox,
+			   size_t mboxlen)
+{
   char mailbox[LONG_STRING];
-  char internaldate[IMAP_DATELEN];
-  char imap_flags[SHORT_STRING];
-  size_t len;
-  progress_t progressbar;
-  size_t sent;
-  int c, last;
   IMAP_MBOX mx;
-  int rc;
-
-  idata = (IMAP_DATA*) ctx->data;
 
-  if (imap_parse_path (ctx->path, &mx))
+  if (imap_parse_path (path, &mx))
     return -1;
 
   imap_fix_path (idata, mx.mbox, mailbox, sizeof (mailbox));
   if (!*mailbox)
     strfcpy (mailbox, "INBOX", sizeof (mailbox));
+  FREE (&mx.mbox);
+
+  imap_munge_mbox_name (idata, mbox, mboxlen, mailbox);
+
+  return 0;
+}
+
+/* imap_append_message: upload msg to the mailbox of ctx. If batching has
+ * been requested with imap_append_batch() and the server supports
+ * MULTIAPPEND, the message is only queued and 0 means it will be sent by
+ * imap_append_flush(). */
+int imap_append_message (CONTEXT *ctx, MESSAGE *msg)
+{
+  IMAP_DATA* idata;
+  IMAP_APPEND_MSG *am;
+  FILE *fp;
+  char mbox[LONG_STRING];
+  int rc;
+
+  idata = (IMAP_DATA*) ctx->data;
+
+  if (append_mailbox (idata, ctx->path, mbox, sizeof (mbox)) < 0)
+    return -1;
 
   if ((fp = fopen (msg->path, "r")) == NULL)
   {
     mutt_perror (msg->path);
-    goto fail;
+    return -1;
   }
 
-  /* currently we set the \Seen flag on all messages, but probably we
-   * should scan the message Status header for flag info. Since we're
-   * already rereading the whole file for length it isn't any more
-   * expensive (it'd be nice if we had the file size passed in already
-   * by the code that writes the file, but that's a lot of changes.
-   * Ideally we'd have a HEADER structure with flag info here... */
-  for (last = EOF, len = 0; (c = fgetc(fp)) != EOF; last = c)
-  {
-    if(c == '\n' && last != '\r')
-      len++;
-
-    len++;
-  }
-  rewind (fp);
+  am = safe_calloc (1, sizeof (IMAP_APPEND_MSG));
 
-  mutt_progress_init (&progressbar, _("Uploading message..."),
-		      M_PROGRESS_SIZE, NetInc, len);
+  /* currently we set the \Seen flag on all messages, but probably we
+   * should scan the message Status header for flag info. Ideally we'd
+   * have a HEADER structure with flag info here... */
+  am->len = append_length (fp);
+  safe_fclose (&fp);
 
-  imap_munge_mbox_name (idata, mbox, sizeof (mbox), mailbox);
-  imap_make_date (internaldate, msg->received);
+  imap_make_date (am->date, msg->received);
 
-  imap_flags[0] = imap_flags[1] = 0;
   if (msg->flags.read)
-    safe_strcat (imap_flags, sizeof (imap_flags), " \\Seen");
+    safe_strcat (am->flags, sizeof (am->flags), " \\Seen");
   if (msg->flags.replied)
-    safe_strcat (imap_flags, sizeof (imap_flags), " \\Answered");
+    safe_strcat (am->flags, sizeof (am->flags), " \\Answered");
   if (msg->flags.flagged)
-    safe_strcat (imap_flags, sizeof (imap_flags), " \\Flagged");
+    safe_strcat (am->flags, sizeof (am->flags), " \\Flagged");
   if (msg->flags.draft)
-    safe_strcat (imap_flags, sizeof (imap_flags), " \\Draft");
+    safe_strcat (am->flags, sizeof (am->flags), " \\Draft");
+  if (am->flags[0])
+    memmove (am->flags, am->flags + 1, strlen (am->flags));
 
-  snprintf (buf, sizeof (buf), "APPEND %s (%s) \"%s\" {%lu}", mbox,
-            imap_flags + 1,
-	    internaldate,
-	    (unsigned long) len);
+  if (!idata->append_batch || !mutt_bit_isset (idata->capabilities, MULTIAPPEND))
+  {
+    am->path = msg->path;
+    rc = append_send (idata, mbox, am);
+    FREE (&am);
+    return rc;
+  }
 
-  imap_cmd_start (idata, buf);
+  /* a queue for another mailbox goes first */
+  if (idata->append_queue && mutt_strcmp (idata->append_mbox, mbox) &&
+      imap_append_flush (ctx) < 0)
+  {
+    FREE (&am);
+    return -1;
+  }
 
-  do
-    rc = imap_cmd_step (idata);
-  while (rc == IMAP_CMD_CONTINUE);
+  /* take over the temporary file */
+  am->path = msg->path;
+  msg->path = NULL;
 
-  if (rc != IMAP_CMD_RESPOND)
+  if (!idata->append_queue)
   {
-    char *pc;
+    mutt_str_replace (&idata->append_mbox, mbox);
+    idata->append_tail = &idata->append_queue;
+  }
+  *idata->append_tail = am;
+  idata->append_tail = &am->next;
+  idata->append_count++;
+  idata->append_bytes += am->len;
 
-    dprint (1, (debugfile, "imap_append_message(): command failed: %s\n",
-		idata->buf));
+  if (idata->append_count >= IMAP_APPEND_BATCH ||
+      idata->append_bytes >= IMAP_APPEND_BATCH_BYTES)
+    return imap_append_flush (ctx);
 
-    pc = idata->buf + SEQLEN;
-    SKIPWS (pc);
-    pc = imap_next_word (pc);
-    mutt_error ("%s", pc);
-    mutt_sleep (1);
-    safe_fclose (&fp);
-    goto fail;
-  }
+  return 0;
+}
+
+/* imap_append_batch: allow imap_append_message() to queue messages for
+ * ctx. The caller must imap_append_flush() before it relies on them being
+ * stored, and should check imap_append_pending() to learn when earlier
+ * messages have been sent. */
+void imap_append_batch (CONTEXT *ctx, int batch)
+{
+  IMAP_DATA *idata = (IMAP_DATA *) ctx->data;
+
+  if (ctx->magic == M_IMAP && idata)
+    idata->append_batch = batch ? 1 : 0;
+}
+
+/* imap_append_pending: number of messages queued but not yet sent */
+int imap_append_pending (CONTEXT *ctx)
+{
+  IMAP_DATA *idata = (IMAP_DATA *) ctx->data;
+
+  if (ctx->magic != M_IMAP || !idata)
+    return 0;
 
-  for (last = EOF, sent = len = 0; (c = fgetc(fp)) != EOF; last = c)
+  return idata->append_count;
+}
+
+/* imap_append_flush: send all queued messages in one MULTIAPPEND command.
+ * The server stores either all of them or none. Returns 0 on success,
+ * -1 on failure, in both cases the queue is empty afterwards. */
+int imap_append_flush (CONTEXT *ctx)
+{
+  IMAP_DATA *idata = (IMAP_DATA *) ctx->data;
+  int rc;
+
+  if (ctx->magic != M_IMAP || !idata || !idata->append_queue)
+    return 0;
+
+  dprint (2, (debugfile, "imap_append_flush: sending %d messages (%lu bytes)\n",
+	      idata->append_count, (unsigned long) idata->append_bytes));
+
+  rc = append_send (idata, idata->append_mbox, idata->append_queue);
+  imap_append_discard (idata);
+
+  return rc;
+}
+
+/* imap_append_discard: drop queued appends and their temporary files */
+void imap_append_discard (IMAP_DATA *idata)
+{
+  IMAP_APPEND_MSG *am;
+
+  while ((am = idata->append_queue))
   {
-    if (c == '\n' && last != '\r')
-      buf[len++] = '\r';
+    idata->append_queue = am->next;
+    unlink (am->path);
+    FREE (&am->path);
+    FREE (&am);
+  }
 
-    buf[len++] = c;
+  idata->append_tail = &idata->append_queue;
+  idata->append_count = 0;
+  idata->append_bytes = 0;
+  FREE (&idata->append_mbox);
+}
+
+#ifdef USE_HCACHE
+/* copy_parse_uidset: expand an RFC 4315 uid-set into at most max UIDs.
+ *   Returns the number of UIDs, or -1 if there are more than max. */
+static int copy_parse_uidset (const char *s, unsigned int *uids, int max)
+{
+  unsigned int a, b;
+  int n = 0;
+  char *p;
 
-    if (len > sizeof(buf) - 3)
+  while (*s && *s != ' ' && *s != ']')
+  {
+    a = b = strtoul (s, &p, 10);
+    if (p == s)
+      return -1;
+    if (*p == ':')
+    {
+      s = p + 1;
+      b = strtoul (s, &p, 10);
+      if (p == s)
+	return -1;
+    }
+    for (;;)
     {
-      sent += len;
-      flush_buffer(buf, &len, idata->conn);
-      mutt_progress_update (&progressbar, sent, -1);
+      if (n >= max)
+	return -1;
+      uids[n++] = a;
+      if (a == b)
+	break;
+      a += a < b ? 1 : -1;
     }
+    s = p;
+    if (*s == ',')
+      s++;
   }
 
-  if (len)
-    flush_buffer(buf, &len, idata->conn);
+  return n;
+}
 
-  mutt_socket_write (idata->conn, "\r\n");
-  safe_fclose (&fp);
+static int copy_compare_uid (const void *a, const void *b)
+{
+  unsigned int ua = HEADER_DATA (*(HEADER **) a)->uid;
+  unsigned int ub = HEADER_DATA (*(HEADER **) b)->uid;
 
-  do
-    rc = imap_cmd_step (idata);
-  while (rc == IMAP_CMD_CONTINUE);
+  return ua < ub ? -1 : ua > ub;
+}
 
-  if (!imap_code (idata->buf))
+/* copy_seed_hcache: store the copied headers in the header cache of the
+ * destination, under the UIDs the server reported in COPYUID responses,
+ * so opening the destination doesn't fetch them again. The cache is only
+ * extended if it is already in use for the same UIDVALIDITY. */
+static void copy_seed_hcache (IMAP_DATA *idata, const char *mbox,
+			      HEADER **hdrs, int nhdrs)
+{
+  header_cache_t *hc;
+  LIST *cu;
+  HEADER key, *kp, **hp;
+  IMAP_HEADER_DATA kdata;
+  unsigned int *src, *dst, *uv, *un;
+  unsigned int uidvalidity, uidnext, maxuid = 0;
+  char buf[16];
+  char *s;
+  int i, ns, nd, seeded = 0;
+
+  if (!idata->copyuid || !(hc = imap_hcache_open (idata, mbox)))
+    return;
+
+  uv = mutt_hcache_fetch_raw (hc, "/UIDVALIDITY", imap_hcache_keylen);
+  un = mutt_hcache_fetch_raw (hc, "/UIDNEXT", imap_hcache_keylen);
+  uidnext = un ? *un : 0;
+
+  qsort (hdrs, nhdrs, sizeof (HEADER *), copy_compare_uid);
+  src = safe_calloc (nhdrs, sizeof (unsigned int));
+  dst = safe_calloc (nhdrs, sizeof (unsigned int));
+  key.data = &kdata;
+  kp = &key;
+
+  for (cu = idata->copyuid; uv && cu; cu = cu->next)
   {
-    char *pc;
+    uidvalidity = strtoul (cu->data, &s, 10);
+    if (uidvalidity != *uv)
+      continue;
+    SKIPWS (s);
+    ns = copy_parse_uidset (s, src, nhdrs);
+    s = strchr (s, ' ');
+    if (ns < 0 || !s)
+      continue;
+    SKIPWS (s);
+    nd = copy_parse_uidset (s, dst, nhdrs);
+    if (nd != ns)
+      continue;
 
-    dprint (1, (debugfile, "imap_append_message(): command failed: %s\n",
-		idata->buf));
-    pc = idata->buf + SEQLEN;
-    SKIPWS (pc);
-    pc = imap_next_word (pc);
-    mutt_error ("%s", pc);
-    mutt_sleep (1);
-    goto fail;
+    for (i = 0; i < ns; i++)
+    {
+      kdata.uid = src[i];
+      if (!(hp = bsearch (&kp, hdrs, nhdrs, sizeof (HEADER *), copy_compare_uid)))
+	continue;
+      snprintf (buf, sizeof (buf), "/%u", dst[i]);
+      if (mutt_hcache_store (hc, buf, *hp, uidvalidity, imap_hcache_keylen, 0) == 0)
+	seeded++;
+      if (dst[i] > maxuid)
+	maxuid = dst[i];
+    }
   }
 
-  FREE (&mx.mbox);
-  return 0;
-
- fail:
-  FREE (&mx.mbox);
-  return -1;
+  if (seeded && maxuid >= uidnext)
+  {
+    uidnext = maxuid + 1;
+    mutt_hcache_store_raw (hc, "/UIDNEXT", &uidnext, sizeof (uidnext),
+			   imap_hcache_keylen);
+  }
+  dprint (2, (debugfile, "copy_seed_hcache: seeded %d headers in %s\n",
+	      seeded, mbox));
+
+  FREE (&src);
+  FREE (&dst);
+  FREE (&uv);
+  FREE (&un);
+  mutt_hcache_close (hc);
 }
+#endif
 
 /* imap_copy_messages: use server COPY command to copy messages to another
- *   folder.
+ *   folder. If delete is set and $imap_move is, the server's MOVE command
+ *   is used instead where available.
  *   Return codes:
  *      -1: error
  *       0: success
- *       1: non-fatal error - try fetch/append */
+ *       1: non-fatal error - try fetch/append
+ *       2: the tagged messages were copied, except those with attachments
+ *          to delete, which must go through fetch/append */
 int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
 {
   IMAP_DATA* idata;
@@ -744,14 +1658,22 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
   char mbox[LONG_STRING];
   char mmbox[LONG_STRING];
   char prompt[LONG_STRING];
+  const char *copy;
+  HEADER **skipped = NULL, **copied = NULL;
+  int nskipped = 0, ncopied = 0;
   int rc;
   int n;
   IMAP_MBOX mx;
   int err_continue = M_NO;
   int triedcreate = 0;
+  int move, moving = 0;
+  unsigned char reopen = 0;
 
   idata = (IMAP_DATA*) ctx->data;
 
+  mutt_buffer_init (&sync_cmd);
+  mutt_buffer_init (&cmd);
+
   if (imap_parse_path (dest, &mx))
   {
     dprint (1, (debugfile, "imap_copy_messages: bad destination %s\n", dest));
@@ -763,12 +1685,14 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
   {
     dprint (3, (debugfile, "imap_copy_messages: %s not same server as %s\n",
       dest, ctx->path));
+    FREE (&mx.mbox);
     return 1;
   }
 
   if (h && h->attach_del)
   {
     dprint (3, (debugfile, "imap_copy_messages: Message contains attachments to be deleted\n"));
+    FREE (&mx.mbox);
     return 1;
   }
 
@@ -777,39 +1701,90 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
     strfcpy (mbox, "INBOX", sizeof (mbox));
   imap_munge_mbox_name (idata, mmbox, sizeof (mmbox), mbox);
 
+  move = delete && option (OPTIMAPMOVE) &&
+    mutt_bit_isset (idata->capabilities, MOVE);
+  copy = move ? "UID MOVE" : "UID COPY";
+
+  /* Null HEADER* means copy tagged messages. Messages with attachments to
+   * delete must be rewritten, leave them to FETCH and APPEND. */
+  if (!h)
+  {
+    skipped = safe_calloc (ctx->msgcount, sizeof (HEADER *));
+    copied = safe_calloc (ctx->msgcount, sizeof (HEADER *));
+    for (n = 0; n < ctx->msgcount; n++)
+    {
+      if (!ctx->hdrs[n]->tagged)
+	continue;
+      if (ctx->hdrs[n]->attach_del)
+	skipped[nskipped++] = ctx->hdrs[n];
+      else if (ctx->hdrs[n]->active)
+	copied[ncopied++] = ctx->hdrs[n];
+    }
+
+    if (!ncopied)
+    {
+      dprint (3, (debugfile, "imap_copy_messages: Messages contain attachments to be deleted\n"));
+      rc = nskipped ? 1 : -1;
+      goto out;
+    }
+  }
+
+  mutt_free_list (&idata->copyuid);
+
+  /* the moved messages disappear: don't let the mailbox change under the
+   * caller's feet, the next mailbox check will tidy up */
+  if (move)
+  {
+    reopen = idata->reopen & IMAP_REOPEN_ALLOW;
+    idata->reopen = (idata->reopen & ~IMAP_REOPEN_ALLOW) |
+      IMAP_EXPUNGE_EXPECTED | IMAP_MOVE_EXPECTED;
+    moving = 1;
+  }
+
   /* loop in case of TRYCREATE */
   do
   {
+    FREE (&sync_cmd.data);
     mutt_buffer_init (&sync_cmd);
+    FREE (&cmd.data);
     mutt_buffer_init (&cmd);
 
-    /* Null HEADER* means copy tagged messages */
     if (!h)
     {
-      /* if any messages have attachments to delete, fall through to FETCH
-       * and APPEND. TODO: Copy what we can with COPY, fall through for the
-       * remainder. */
-      for (n = 0; n < ctx->msgcount; n++)
+      /* the copies should carry the flags changed since the last sync */
+      if ((rc = imap_sync_messages (idata, copied, ncopied)) < 0)
       {
-        if (ctx->hdrs[n]->tagged && ctx->hdrs[n]->attach_del)
-        {
-          dprint (3, (debugfile, "imap_copy_messages: Message contains attachments to be deleted\n"));
-          return 1;
-        }
-
-        if (ctx->hdrs[n]->tagged && ctx->hdrs[n]->active &&
-            ctx->hdrs[n]->changed)
+        dprint (1, (debugfile, "imap_copy_messages: could not sync\n"));
+        goto out;
+      }
+      if (rc && imap_exec (idata, NULL, 0) && err_continue != M_YES)
+      {
+        err_continue = imap_continue ("imap_copy_messages: STORE failed",
+                                      idata->buf);
+        if (err_continue != M_YES)
         {
-          rc = imap_sync_message (idata, ctx->hdrs[n], &sync_cmd, &err_continue);
-          if (rc < 0)
-          {
-            dprint (1, (debugfile, "imap_copy_messages: could not sync\n"));
-            goto out;
-          }
+          rc = -1;
+          goto out;
         }
       }
+      /* stored, don't do it again after TRYCREATE */
+      for (n = 0; n < ncopied; n++)
+	if (copied[n]->active && copied[n]->changed)
+	{
+	  HEADER_DATA (copied[n])->conflict = 0;
+	  copied[n]->changed = 0;
+	  ctx->changed--;
+	}
+      if (idata->modified)
+        imap_sync_modified (idata);
+
+      /* hide the skipped messages from the message set */
+      for (n = 0; n < nskipped; n++)
+	skipped[n]->tagged = 0;
+      rc = imap_exec_msgset (idata, copy, mmbox, M_TAG, 0, 0);
+      for (n = 0; n < nskipped; n++)
+	skipped[n]->tagged = 1;
 
-      rc = imap_exec_msgset (idata, "UID COPY", mmbox, M_TAG, 0, 0);
       if (!rc)
       {
         dprint (1, (debugfile, "imap_copy_messages: No messages tagged\n"));
@@ -821,13 +1796,18 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
         dprint (1, (debugfile, "could not queue copy\n"));
         goto out;
       }
+      else if (move)
+        mutt_message (_("Moving %d messages to %s..."), rc, mbox);
       else
         mutt_message (_("Copying %d messages to %s..."), rc, mbox);
     }
     else
     {
-      mutt_message (_("Copying message %d to %s..."), h->index+1, mbox);
-      mutt_buffer_printf (&cmd, "UID COPY %u %s", HEADER_DATA (h)->uid, mmbox);
+      if (move)
+	mutt_message (_("Moving message %d to %s..."), h->index+1, mbox);
+      else
+	mutt_message (_("Copying message %d to %s..."), h->index+1, mbox);
+      mutt_buffer_printf (&cmd, "%s %u %s", copy, HEADER_DATA (h)->uid, mmbox);
 
       if (h->active && h->changed)
       {
@@ -877,18 +1857,22 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
     goto out;
   }
 
+#ifdef USE_HCACHE
+  if (h)
+    copy_seed_hcache (idata, mbox, &h, 1);
+  else
+    copy_seed_hcache (idata, mbox, copied, ncopied);
+#endif
+
   /* cleanup */
   if (delete)
   {
     if (!h)
-      for (n = 0; n < ctx->msgcount; n++)
+      for (n = 0; n < ncopied; n++)
       {
-        if (ctx->hdrs[n]->tagged)
-        {
-          mutt_set_flag (ctx, ctx->hdrs[n], M_DELETE, 1);
-          if (option (OPTDELETEUNTAG))
-            mutt_set_flag (ctx, ctx->hdrs[n], M_TAG, 0);
-        }
+	mutt_set_flag (ctx, copied[n], M_DELETE, 1);
+	if (option (OPTDELETEUNTAG))
+	  mutt_set_flag (ctx, copied[n], M_TAG, 0);
       }
     else
     {
@@ -898,13 +1882,21 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
     }
   }
 
-  rc = 0;
+  rc = nskipped ? 2 : 0;
 
  out:
-  if (cmd.data)
-    FREE (&cmd.data);
-  if (sync_cmd.data)
-    FREE (&sync_cmd.data);
+  if (moving)
+  {
+    idata->reopen |= reopen;
+    /* nothing was moved, so no EXPUNGE is coming */
+    if (rc < 0)
+      idata->reopen &= ~(IMAP_EXPUNGE_EXPECTED | IMAP_MOVE_EXPECTED);
+  }
+  FREE (&cmd.data);
+  FREE (&sync_cmd.data);
+  mutt_free_list (&idata->copyuid);
+  FREE (&skipped);
+  FREE (&copied);
   FREE (&mx.mbox);
 
   return rc < 0 ? -1 : rc;
@@ -1082,14 +2074,11 @@ char* imap_set_flags (IMAP_DATA* idata, HEADER* h, char* s)
  *      0 on success
  *     -1 if the string is not a fetch response
  *     -2 if the string is a corrupt fetch response */
-static int msg_fetch_header (CONTEXT* ctx, IMAP_HEADER* h, char* buf, FILE* fp)
+static int msg_fetch_header (IMAP_DATA* idata, IMAP_HEADER* h, char* buf, BUFFER* hbuf)
 {
-  IMAP_DATA* idata;
   long bytes;
   int rc = -1; /* default now is that string isn't FETCH response*/
 
-  idata = (IMAP_DATA*) ctx->data;
-
   if (buf[0] != '*')
     return rc;
 
@@ -1109,12 +2098,13 @@ static int msg_fetch_header (CONTEXT* ctx, IMAP_HEADER* h, char* buf, FILE* fp)
 
   /* FIXME: current implementation - call msg_parse_fetch - if it returns -2,
    *   read header lines and call it again. Silly. */
-  if ((rc = msg_parse_fetch (h, buf)) != -2 || !fp)
+  if ((rc = msg_parse_fetch (h, buf)) != -2 || !hbuf)
     return rc;
 
   if (imap_get_literal_count (buf, &bytes) == 0)
   {
-    imap_read_literal (fp, idata, bytes, NULL);
+    if (imap_read_literal_buffer (hbuf, idata, bytes) < 0)
+      return rc;
 
     /* we may have other fields of the FETCH _after_ the literal
      * (eg Domino puts FLAGS here). Nothing wrong with that, either.
@@ -1162,6 +2152,8 @@ static int msg_parse_fetch (IMAP_HEADER *h, char *s)
 
       s = imap_next_word (s);
     }
+    else if (ascii_strncasecmp ("MODSEQ", s, 6) == 0)
+      s = imap_parse_modseq (s + 6, &h->data->modseq);
     else if (ascii_strncasecmp ("INTERNALDATE", s, 12) == 0)
     {
       s += 12;
@@ -1210,6 +2202,29 @@ static int msg_parse_fetch (IMAP_HEADER *h, char *s)
   return 0;
 }
 
+/* imap_parse_modseq: read the "(n)" following a MODSEQ fetch item.
+ *   Returns the position after it. */
+char* imap_parse_modseq (char* s, unsigned long long* modseq)
+{
+  SKIPWS (s);
+  if (*s == '(')
+    s++;
+  *modseq = strtoull (s, &s, 10);
+  if (*s == ')')
+    s++;
+
+  return s;
+}
+
+/* imap_update_modseq: note a modseq the server reported, so that
+ *   idata->modseq stays the highest one known for the mailbox. Nothing
+ *   to do without CONDSTORE. */
+void imap_update_modseq (IMAP_DATA* idata, unsigned long long modseq)
+{
+  if (idata->modseq && modseq > idata->modseq)
+    idata->modseq = modseq;
+}
+
 /* msg_parse_flags: read a FLAGS token into an IMAP_HEADER */
 static char* msg_parse_flags (IMAP_HEADER* h, char* s)
 {
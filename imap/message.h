@@ -35,8 +35,13 @@ typedef struct imap_header_data
   unsigned int changed : 1;
 
   unsigned int parsed : 1;
+  unsigned int lazy : 1;	/* envelope not fetched yet */
+  unsigned int conflict : 1;	/* changed here and on the server, see
+				 * cmd_parse_fetch() */
 
   unsigned int uid;	/* 32-bit Message UID */
+  unsigned long long modseq;	/* RFC 7162 CONDSTORE, 0 if unknown */
+  unsigned int sortpos;	/* position in the server's SORT response */
   LIST *keywords;
 } IMAP_HEADER_DATA;
 
@@ -140,7 +140,8 @@ int imap_hcache_put (IMAP_DATA* idata, HEADER* h)
 {
   char key[16];
 
-  if (!idata->hcache)
+  /* don't cache the empty envelope of a lazily fetched header */
+  if (!idata->hcache || HEADER_DATA (h)->lazy)
     return -1;
 
   sprintf (key, "/%u", HEADER_DATA (h)->uid);
@@ -392,6 +393,9 @@ void imap_free_idata (IMAP_DATA** idata)
   if (!idata)
     return;
 
+  imap_append_discard (*idata);
+  mutt_free_list (&(*idata)->copyuid);
+  mutt_free_list (&(*idata)->modified);
   FREE (&(*idata)->capstr);
   mutt_free_list (&(*idata)->flags);
   imap_mboxcache_free (*idata);
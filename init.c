@@ -70,6 +70,9 @@ typedef struct myvar
 
 static myvar_t* MyVars;
 
+static HASH *VarNames = NULL;		/* MuttVars by name */
+static HASH *CommandNames = NULL;	/* Commands by name */
+
 static int var_to_string (int idx, char* val, size_t len);
 
 static void myvar_set (const char* var, const char* val);
@@ -124,12 +127,20 @@ int query_quadoption (int opt, const char *prompt)
    matches, or -1 if the variable is not found.  */
 static int mutt_option_index (char *s)
 {
+  struct option_t *opt;
   int i;
 
-  for (i = 0; MuttVars[i].option; i++)
-    if (mutt_strcmp (s, MuttVars[i].option) == 0)
-      return (MuttVars[i].type == DT_SYN ?  mutt_option_index ((char *) MuttVars[i].data) : i);
-  return (-1);
+  if (!VarNames)
+  {
+    VarNames = hash_create (1031, 0);
+    for (i = 0; MuttVars[i].option; i++)
+      hash_insert (VarNames, MuttVars[i].option, &MuttVars[i], 0);
+  }
+
+  if (!s || !(opt = hash_find (VarNames, s)))
+    return (-1);
+  i = opt - MuttVars;
+  return (MuttVars[i].type == DT_SYN ?  mutt_option_index ((char *) MuttVars[i].data) : i);
 }
 
 int mutt_extract_token (BUFFER *dest, BUFFER *tok, int flags)
@@ -408,7 +419,6 @@ static void add_to_list (LIST **list, const char *str)
 
 int mutt_add_to_rx_list (RX_LIST **list, const char *s, int flags, BUFFER *err)
 {
-  RX_LIST *t, *last = NULL;
   REGEXP *rx;
 
   if (!s || !*s)
@@ -421,32 +431,10 @@ int mutt_add_to_rx_list (RX_LIST **list, const char *s, int flags, BUFFER *err)
   }
 
   /* check to make sure the item is not already on this list */
-  for (last = *list; last; last = last->next)
-  {
-    if (ascii_strcasecmp (rx->pattern, last->rx->pattern) == 0)
-    {
-      /* already on the list, so just ignore it */
-      last = NULL;
-      break;
-    }
-    if (!last->next)
-      break;
-  }
-
-  if (!*list || last)
-  {
-    t = mutt_new_rx_list();
-    t->rx = rx;
-    if (last)
-    {
-      last->next = t;
-      last = last->next;
-    }
-    else
-      *list = last = t;
-  }
-  else /* duplicate */
-    mutt_free_regexp (&rx);
+  if (mutt_rx_list_find (list, rx->pattern))
+    mutt_free_regexp (&rx);	/* already on the list, so just ignore it */
+  else
+    mutt_rx_list_append (list, rx, flags);
 
   return 0;
 }
@@ -1286,8 +1274,7 @@ static int parse_unalias (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *er
 
 static int parse_alias (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 {
-  ALIAS *tmp = Aliases;
-  ALIAS *last = NULL;
+  ALIAS *tmp;
   char *estr = NULL;
   group_context_t *gc = NULL;
   
@@ -1303,19 +1290,13 @@ static int parse_alias (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
     return -1;
   
   /* check to see if an alias with this name already exists */
-  for (; tmp; tmp = tmp->next)
-  {
-    if (!mutt_strcasecmp (tmp->name, buf->data))
-      break;
-    last = tmp;
-  }
-
-  if (!tmp)
+  if ((tmp = hash_find (AliasNames, buf->data)) == NULL)
   {
     /* create a new alias */
     tmp = (ALIAS *) safe_calloc (1, sizeof (ALIAS));
     tmp->self = tmp;
     tmp->name = safe_strdup (buf->data);
+    mutt_alias_append (tmp);
     /* give the main addressbook code a chance */
     if (CurrentMenu == MENU_ALIAS)
       set_option (OPTMENUCALLER);
@@ -1335,10 +1316,6 @@ static int parse_alias (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 
   tmp->addr = mutt_parse_adrlist (tmp->addr, buf->data);
 
-  if (last)
-    last->next = tmp;
-  else
-    Aliases = tmp;
   if (mutt_addrlist_to_intl (tmp->addr, &estr))
   {
     snprintf (err->data, err->dsize, _("Warning: Bad IDN '%s' in alias '%s'.\n"),
@@ -2334,10 +2311,18 @@ int mutt_parse_rc_line (/* const */ char *line, BUFFER *token, BUFFER *err)
 {
   int i, r = -1;
   BUFFER expn;
+  const struct command_t *cmd;
 
   if (!line || !*line)
     return 0;
 
+  if (!CommandNames)
+  {
+    CommandNames = hash_create (127, 0);
+    for (i = 0; Commands[i].name; i++)
+      hash_insert (CommandNames, Commands[i].name, (void *) &Commands[i], 0);
+  }
+
   mutt_buffer_init (&expn);
   expn.data = expn.dptr = line;
   expn.dsize = mutt_strlen (line);
@@ -2355,20 +2340,13 @@ int mutt_parse_rc_line (/* const */ char *line, BUFFER *token, BUFFER *err)
       continue;
     }
     mutt_extract_token (token, &expn, 0);
-    for (i = 0; Commands[i].name; i++)
-    {
-      if (!mutt_strcmp (token->data, Commands[i].name))
-      {
-	if (Commands[i].func (token, &expn, Commands[i].data, err) != 0)
-	  goto finish;
-        break;
-      }
-    }
-    if (!Commands[i].name)
+    if (!(cmd = hash_find (CommandNames, (NONULL (token->data)))))
     {
       snprintf (err->data, err->dsize, _("%s: unknown command"), NONULL (token->data));
       goto finish;
     }
+    if (cmd->func (token, &expn, cmd->data, err) != 0)
+      goto finish;
   }
   r = 0;
 finish:
@@ -2899,6 +2877,7 @@ void mutt_init (int skip_sys_rc, LIST *commands)
 
   Groups = hash_create (1031, 0);
   ReverseAlias = hash_create (1031, 1);
+  AliasNames = hash_create (1031, 1);
   
   mutt_menu_init ();
   mutt_srandom ();
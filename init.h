@@ -1147,6 +1147,20 @@ struct option_t MuttVars[] = {
    ** it polls for new mail just as if you had issued individual ``$mailboxes''
    ** commands.
    */
+#ifdef USE_ZLIB
+  { "imap_deflate",		DT_BOOL, R_NONE, OPTIMAPDEFLATE, 1 },
+  /*
+  ** .pp
+  ** When \fIset\fP, mutt will use the IMAP COMPRESS=DEFLATE extension
+  ** (RFC 4978) to compress all traffic on connections to servers which
+  ** advertise it. This can greatly speed up downloading the headers of
+  ** large folders over slow links. Compression is negotiated once, right
+  ** after login, so changing this variable has no effect on connections
+  ** which are already open. \fC<show-timing>\fP lists the bytes read and
+  ** written by mutt on compressed connections, next to those received
+  ** from and sent to the server.
+  */
+#endif
   { "imap_delim_chars",		DT_STR, R_NONE, UL &ImapDelimChars, UL "/." },
   /*
   ** .pp
@@ -1154,6 +1168,20 @@ struct option_t MuttVars[] = {
   ** as folder separators for displaying IMAP paths. In particular it
   ** helps in using the ``='' shortcut for your \fIfolder\fP variable.
   */
+  { "imap_fetch_connections", DT_NUM, R_NONE, UL &ImapFetchConnections, 0 },
+  /*
+  ** .pp
+  ** When opening a large IMAP folder with no usable header cache, mutt
+  ** can download the headers over this many additional connections to the
+  ** server at the same time, each reading a slice of the folder. This
+  ** helps when a single connection can't make use of the available
+  ** bandwidth, e.g. over links with high latency. Each connection fetches
+  ** at least 1000 messages, so small folders use fewer of them or none.
+  ** The extra connections are logged out once the headers are in.
+  ** .pp
+  ** Servers usually limit the number of connections per user, so keep
+  ** this small. A value of 0 disables the feature.
+  */
   { "imap_headers",	DT_STR, R_INDEX, UL &ImapHeaders, UL 0},
   /*
   ** .pp
@@ -1188,6 +1216,22 @@ struct option_t MuttVars[] = {
   ** violated every now and then. Reduce this number if you find yourself
   ** getting disconnected from your IMAP server due to inactivity.
   */
+  { "imap_lazy_headers",	DT_BOOL, R_NONE, OPTIMAPLAZYHEADERS, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, opening an IMAP folder which needs more than 1000
+  ** headers downloaded only fetches the flags, arrival date and size of
+  ** each message at first. The remaining header fields (see
+  ** $$imap_headers) are fetched as messages come into view in the index,
+  ** a screenful at a time, and stored in the header cache.
+  ** .pp
+  ** Sorting by ``date'', ``from'', ``to'' or ``subject'' is then left to
+  ** the server, which must support the SORT extension (RFC 5256); its
+  ** ordering may differ slightly from mutt's. When $$sort needs the
+  ** headers otherwise, e.g. for threads, they are all downloaded up front
+  ** as usual. Those still missing are fetched before a search or limit
+  ** on header fields, or when $$sort is changed to such a method.
+  */
   { "imap_list_subscribed",	DT_BOOL, R_NONE, OPTIMAPLSUB, 0 },
   /*
   ** .pp
@@ -1202,6 +1246,15 @@ struct option_t MuttVars[] = {
   ** .pp
   ** This variable defaults to the value of $$imap_user.
   */
+  { "imap_move",	DT_BOOL, R_NONE, OPTIMAPMOVE, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, messages saved with \fC<save-message>\fP to a folder
+  ** on the same IMAP server are moved there with the server's MOVE command
+  ** (RFC 6851), if it supports it, rather than copied and marked for
+  ** deletion. The originals are then gone from the current folder at once,
+  ** and can't be undeleted.
+  */
   { "imap_pass", 	DT_STR,  R_NONE, UL &ImapPass, UL 0 },
   /*
   ** .pp
@@ -1517,6 +1570,15 @@ struct option_t MuttVars[] = {
   ** (useful for slow links to avoid many redraws).
   */
 #if defined(USE_IMAP) || defined(USE_POP)
+  { "message_cache_age", DT_NUM, R_NONE, UL &MessageCacheAge, 0 },
+  /*
+  ** .pp
+  ** When set to a non-zero value, entries in the $$message_cachedir
+  ** which have not been read for this many days are removed. A value of
+  ** zero keeps entries forever.
+  ** .pp
+  ** Also see the $$message_cache_size variable.
+  */
   { "message_cache_clean", DT_BOOL, R_NONE, OPTMESSAGECACHECLEAN, 0 },
   /*
   ** .pp
@@ -1525,6 +1587,16 @@ struct option_t MuttVars[] = {
   ** every once in a while, since it can be a little slow
   ** (especially for large folders).
   */
+  { "message_cache_size", DT_NUM, R_NONE, UL &MessageCacheSize, 0 },
+  /*
+  ** .pp
+  ** When set to a non-zero value, the total size of the $$message_cachedir
+  ** is kept below this many megabytes. When a newly cached message pushes
+  ** it over the limit, the least recently read entries are removed until
+  ** it is back under 90% of the limit. A value of zero means unlimited.
+  ** .pp
+  ** Also see the $$message_cache_age variable.
+  */
   { "message_cachedir",	DT_PATH,	R_NONE,	UL &MessageCachedir, 0 },
   /*
   ** .pp
@@ -1536,7 +1608,8 @@ struct option_t MuttVars[] = {
   ** remote message only once and can perform regular expression searches
   ** as fast as for local folders.
   ** .pp
-  ** Also see the $$message_cache_clean variable.
+  ** Also see the $$message_cache_clean, $$message_cache_size and
+  ** $$message_cache_age variables.
   */
 #endif
   { "message_format",	DT_STR,	 R_NONE, UL &MsgFmt, UL "%s" },
@@ -1916,6 +1989,11 @@ struct option_t MuttVars[] = {
   ** produces a different date format which may result in mutt showing
   ** incorrect key generation dates.
   ** .pp
+  ** When the GnuPG home directory (\fC$$$GNUPGHOME\fP or \fC~/.gnupg\fP)
+  ** has keyring files, mutt runs this command once with an empty \fC%r\fP
+  ** and looks up recipients and key IDs in its output until the keyring
+  ** files change.
+  ** .pp
   ** This is a format string, see the $$pgp_decode_command command for
   ** possible \fCprintf(3)\fP-like sequences.
   ** (PGP only)
@@ -2600,6 +2678,25 @@ struct option_t MuttVars[] = {
   ** For the pager, this variable specifies the number of lines shown
   ** before search results. By default, search results will be top-aligned.
   */
+  { "search_index",	DT_PATH, R_NONE, UL &SearchIndex, 0 },
+  /*
+  ** .pp
+  ** This variable points to a directory where mutt keeps a full-text index
+  ** of local mailboxes (mbox, MMDF, MH and Maildir), one file per folder.
+  ** The index records which short character sequences occur in the header
+  ** and body of each message, and lets the \fC~b\fP, \fC~B\fP and \fC~h\fP
+  ** patterns skip messages that cannot contain the string searched for.
+  ** It only helps with plain strings (\fC=b\fP and friends, or regular
+  ** expressions without special characters). Messages are added to the
+  ** index the first time they are searched, so only repeated searches of
+  ** a folder get faster.
+  ** .pp
+  ** The index follows the setting of $$thorough_search and $$charset;
+  ** messages indexed with different settings are indexed again.
+  ** Encrypted messages are only indexed in their raw form, never after
+  ** decryption.
+  ** If \fIunset\fP (the default), no index is kept.
+  */
   { "send_charset",	DT_STR,  R_NONE, UL &SendCharset, UL "us-ascii:iso-8859-1:utf-8" },
   /*
   ** .pp
@@ -3355,6 +3452,15 @@ struct option_t MuttVars[] = {
   ** .pp
   ** A value of zero or less will cause Mutt to never time out.
   */
+  { "timing_file",	DT_PATH, R_NONE, UL &TimingFile, 0 },
+  /*
+  ** .pp
+  ** If set, Mutt writes the time it spent in each phase of opening,
+  ** checking and synchronizing mailboxes (reading directories, parsing,
+  ** header cache lookups, sorting, threading, server round trips, drawing
+  ** the index) to this file as JSON when it exits. The same summary can
+  ** be viewed at any time with \fC<show-timing>\fP.
+  */
   { "tmpdir",		DT_PATH, R_NONE, UL &Tempdir, 0 },
   /*
   ** .pp
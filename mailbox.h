@@ -38,7 +38,8 @@ enum
   M_NEW_MAIL = 1,	/* new mail received in mailbox */
   M_LOCKED,		/* couldn't lock the mailbox */
   M_REOPENED,		/* mailbox was reopened */
-  M_FLAGS               /* nondestructive flags change (IMAP) */
+  M_FLAGS,              /* nondestructive flags change (IMAP) */
+  M_MOVED               /* our own moved messages were expunged (IMAP) */
 };
 
 typedef struct
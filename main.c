@@ -31,6 +31,7 @@
 #include "url.h"
 #include "mutt_crypt.h"
 #include "mutt_idna.h"
+#include "timing.h"
 
 #ifdef USE_SASL
 #include "mutt_sasl.h"
@@ -321,6 +322,11 @@ static void show_version (void)
 #else
 	"-USE_GSS  "
 #endif
+#ifdef USE_ZLIB
+	"+USE_ZLIB  "
+#else
+	"-USE_ZLIB  "
+#endif
 
 #if HAVE_GETADDRINFO
 	"+HAVE_GETADDRINFO  "
@@ -1192,6 +1198,8 @@ int main (int argc, char **argv)
 #ifdef USE_SASL
     mutt_sasl_done ();
 #endif
+    if (TimingFile)
+      mutt_timing_dump (TimingFile);
     mutt_free_opts ();
     mutt_endwin (Errorbuf);
   }
@@ -28,6 +28,7 @@
 #include "sort.h"
 #include "copy.h"
 #include "mutt_curses.h"
+#include "timing.h"
 
 #include <sys/stat.h>
 #include <dirent.h>
@@ -414,6 +415,7 @@ int mbox_parse_mailbox (CONTEXT *ctx)
 /* open a mbox or mmdf style mailbox */
 int mbox_open_mailbox (CONTEXT *ctx)
 {
+  timing_t start;
   int rc;
 
   if ((ctx->fp = fopen (ctx->path, "r")) == NULL)
@@ -428,12 +430,14 @@ int mbox_open_mailbox (CONTEXT *ctx)
     return (-1);
   }
 
+  start = mutt_timing_now ();
   if (ctx->magic == M_MBOX)
     rc = mbox_parse_mailbox (ctx);
   else if (ctx->magic == M_MMDF)
     rc = mmdf_parse_mailbox (ctx);
   else
     rc = -1;
+  mutt_timing_add (TIMING_MBOX_PARSE, start, ctx->msgcount);
 
   mbox_unlock_mailbox (ctx);
   mutt_unblock_signals ();
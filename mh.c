@@ -37,6 +37,7 @@
 #endif
 #include "mutt_curses.h"
 #include "buffy.h"
+#include "timing.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -1177,6 +1178,7 @@ int mh_read_dir (CONTEXT * ctx, const char *subdir)
   int count;
   char msgbuf[STRING];
   progress_t progress;
+  timing_t start;
 
   memset (&mhs, 0, sizeof (mhs));
   if (!ctx->quiet)
@@ -1197,15 +1199,19 @@ int mh_read_dir (CONTEXT * ctx, const char *subdir)
   md = NULL;
   last = &md;
   count = 0;
+  start = mutt_timing_now ();
   if (maildir_parse_dir (ctx, &last, subdir, &count, &progress) == -1)
     return -1;
+  mutt_timing_add (TIMING_DIR_SCAN, start, count);
 
   if (!ctx->quiet)
   {
     snprintf (msgbuf, sizeof (msgbuf), _("Reading %s..."), ctx->path);
     mutt_progress_init (&progress, msgbuf, M_PROGRESS_MSG, ReadInc, count);
   }
+  start = mutt_timing_now ();
   maildir_delayed_parsing (ctx, &md, &progress);
+  mutt_timing_add (TIMING_DIR_PARSE, start, count);
 
   if (ctx->magic == M_MH)
   {
@@ -367,8 +367,13 @@ enum
   OPTIGNORELISTREPLYTO,
 #ifdef USE_IMAP
   OPTIMAPCHECKSUBSCRIBED,
+# ifdef USE_ZLIB
+  OPTIMAPDEFLATE,
+# endif
   OPTIMAPIDLE,
+  OPTIMAPLAZYHEADERS,
   OPTIMAPLSUB,
+  OPTIMAPMOVE,
   OPTIMAPPASSIVE,
   OPTIMAPPEEK,
   OPTIMAPSERVERNOISE,
@@ -570,6 +575,11 @@ LIST *mutt_add_list (LIST *, const char *);
 LIST *mutt_add_list_n (LIST*, const void *, size_t);
 LIST *mutt_find_list (LIST *, const char *);
 int mutt_remove_from_rx_list (RX_LIST **l, const char *str);
+RX_LIST *mutt_rx_list_find (RX_LIST **, const char *);
+void mutt_rx_list_append (RX_LIST **, REGEXP *, int);
+void mutt_rx_list_reindex (RX_LIST **);
+void mutt_rx_list_forget (RX_LIST **);
+char *mutt_rx_literal (const char *, int);
 
 void mutt_init (int, LIST *);
 
@@ -838,11 +848,12 @@ typedef struct pattern_t
   unsigned int alladdr : 1;
   unsigned int stringmatch : 1;
   unsigned int groupmatch : 1;
-  unsigned int ign_case : 1;		/* ignore case for local stringmatch searches */
+  unsigned int ign_case : 1;		/* ignore case for local searches */
   int min;
   int max;
   struct pattern_t *next;
   struct pattern_t *child;		/* arguments to logical op */
+  char *literal;			/* regexp without metacharacters */
   union 
   {
     regex_t *rx;
@@ -908,6 +919,8 @@ typedef struct _context
   unsigned int collapsed : 1;   /* are all threads collapsed? */
   unsigned int closing : 1;	/* mailbox is being closed */
 
+  struct search_index *sidx;	/* full-text search index */
+
   /* driver hooks */
   void *data;			/* driver specific data */
   int (*mx_close)(struct _context *);
@@ -0,0 +1,854 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * mutt_bench: generate reproducible synthetic mbox, maildir and MH
+ * folders and time mutt's hot paths on them, without a terminal.
+ * Results are written as JSON, for tracking regressions.
+ *
+ * This is linked against all of mutt except main.c, so it provides the
+ * globals and mutt_exit() itself.
+ */
+
+#define MAIN_C 1
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mutt.h"
+#include "mailbox.h"
+#include "mx.h"
+
+#ifdef USE_HCACHE
+#include "hcache.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#define BENCH_DEFAULT_MSGS 10000
+#define BENCH_DEFAULT_SEED 1
+#define BENCH_DEFAULT_REPEAT 3
+
+/* size of the encoded data for the decoder benchmarks */
+#define BENCH_DECODE_SIZE (8 << 20)
+
+/* a reply picks its parent among this many preceding messages */
+#define BENCH_THREAD_WINDOW 200
+
+/* the data directory and the names of the files below it */
+#define BENCH_PATH_MAX (_POSIX_PATH_MAX + SHORT_STRING)
+
+typedef struct
+{
+  char *name;
+  long count;		/* items processed per run */
+  int runs;
+  double best;
+  double total;
+} BENCH_RESULT;
+
+static BENCH_RESULT *Results = NULL;
+static int NumResults = 0;
+
+static unsigned long BenchState;
+
+static const char *Words[] = {
+  "about", "after", "again", "agenda", "archive", "attached", "before",
+  "branch", "budget", "build", "change", "client", "commit", "config",
+  "customer", "deadline", "debug", "design", "draft", "email", "error",
+  "feature", "folder", "header", "invoice", "issue", "kernel", "latest",
+  "lunch", "meeting", "memory", "mutt", "network", "notes", "office",
+  "patch", "please", "project", "quarter", "question", "release",
+  "report", "review", "schedule", "server", "status", "summary", "test",
+  "thanks", "ticket", "today", "tomorrow", "travel", "update", "version",
+  "weekend", "working", "zebra", "\303\251t\303\251", "caf\303\251",
+  "na\303\257ve", "r\303\251sum\303\251", "stra\303\237e", "\303\274ber"
+};
+#define NUM_WORDS (sizeof (Words) / sizeof (Words[0]))
+
+static const char *Domains[] = {
+  "example.com", "example.org", "example.net", "mail.example.com",
+  "lists.example.org"
+};
+#define NUM_DOMAINS (sizeof (Domains) / sizeof (Domains[0]))
+
+static const char *DayNames[] = {
+  "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+static const char *MonthNames[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+void mutt_exit (int code)
+{
+  exit (code);
+}
+
+static void usage (void)
+{
+  fputs ("usage: mutt_bench [-d dir] [-n messages] [-r repeat] [-s seed] [-o file] [-g]\n"
+	 "  -d dir\twhere to keep the generated folders (default: bench-data)\n"
+	 "  -n num\tnumber of messages per folder\n"
+	 "  -r num\tnumber of runs per benchmark, the best one is reported\n"
+	 "  -s num\tseed for the folder generator\n"
+	 "  -o file\twrite results to file instead of stdout\n"
+	 "  -g\t\tonly generate the folders\n", stderr);
+  exit (1);
+}
+
+/* xorshift: reproducible across platforms, unlike random() */
+static unsigned long bench_rand (void)
+{
+  BenchState ^= (BenchState << 13) & 0xffffffffUL;
+  BenchState ^= BenchState >> 17;
+  BenchState ^= (BenchState << 5) & 0xffffffffUL;
+  return BenchState;
+}
+
+static double bench_now (void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+static void bench_record (const char *name, long count, double secs)
+{
+  int i;
+
+  for (i = 0; i < NumResults; i++)
+    if (!mutt_strcmp (Results[i].name, name))
+      break;
+
+  if (i == NumResults)
+  {
+    safe_realloc (&Results, (NumResults + 1) * sizeof (BENCH_RESULT));
+    memset (&Results[i], 0, sizeof (BENCH_RESULT));
+    Results[i].name = safe_strdup (name);
+    Results[i].best = secs;
+    NumResults++;
+  }
+
+  Results[i].count = count;
+  Results[i].runs++;
+  Results[i].total += secs;
+  if (secs < Results[i].best)
+    Results[i].best = secs;
+
+  fprintf (stderr, "%-24s %8ld %10.6fs\n", name, count, secs);
+}
+
+static void bench_json_string (FILE *fp, const char *s)
+{
+  fputc ('"', fp);
+  for (; *s; s++)
+  {
+    if (*s == '"' || *s == '\\')
+      fputc ('\\', fp);
+    fputc (*s, fp);
+  }
+  fputc ('"', fp);
+}
+
+static void bench_write_json (FILE *fp, int msgs, unsigned long seed, int repeat)
+{
+  int i;
+
+  fputs ("{\n  \"version\": ", fp);
+  bench_json_string (fp, MUTT_VERSION);
+  fprintf (fp, ",\n  \"messages\": %d,\n  \"seed\": %lu,\n  \"repeat\": %d,\n",
+	   msgs, seed, repeat);
+  fputs ("  \"results\": [\n", fp);
+  for (i = 0; i < NumResults; i++)
+  {
+    fputs ("    { \"name\": ", fp);
+    bench_json_string (fp, Results[i].name);
+    fprintf (fp, ", \"count\": %ld, \"runs\": %d, \"best\": %.6f, \"mean\": %.6f, "
+	     "\"per_item_us\": %.3f }%s\n",
+	     Results[i].count, Results[i].runs, Results[i].best,
+	     Results[i].total / Results[i].runs,
+	     Results[i].count ? Results[i].best * 1e6 / Results[i].count : 0.0,
+	     i + 1 < NumResults ? "," : "");
+  }
+  fputs ("  ]\n}\n", fp);
+}
+
+/* --- folder generation --- */
+
+typedef struct
+{
+  char *data;
+  size_t len;
+  size_t size;
+} GENBUF;
+
+static void gen_add (GENBUF *b, const char *s, size_t len)
+{
+  if (b->len + len + 1 > b->size)
+  {
+    b->size = (b->len + len + 1) * 2;
+    safe_realloc (&b->data, b->size);
+  }
+  memcpy (b->data + b->len, s, len);
+  b->len += len;
+  b->data[b->len] = 0;
+}
+
+static void gen_printf (GENBUF *b, const char *fmt, ...)
+{
+  char buf[LONG_STRING];
+  va_list ap;
+  int len;
+
+  va_start (ap, fmt);
+  len = vsnprintf (buf, sizeof (buf), fmt, ap);
+  va_end (ap);
+  if (len >= sizeof (buf))
+    len = sizeof (buf) - 1;
+  gen_add (b, buf, len);
+}
+
+static const char *gen_word (void)
+{
+  /* favour the first words, so that some words are common and some rare */
+  unsigned long r = bench_rand ();
+
+  return Words[(r % NUM_WORDS) * ((r >> 8) % NUM_WORDS) / NUM_WORDS];
+}
+
+/* a subject is determined by its own seed, so replies can repeat it */
+static void gen_subject (GENBUF *b, unsigned long subj)
+{
+  unsigned long save = BenchState;
+  int i, n;
+
+  BenchState = subj | 1;
+  n = 2 + bench_rand () % 6;
+  for (i = 0; i < n; i++)
+  {
+    if (i)
+      gen_add (b, " ", 1);
+    gen_printf (b, "%s", Words[bench_rand () % NUM_WORDS]);
+  }
+  BenchState = save;
+}
+
+static void gen_text (GENBUF *b, int lines, int qp)
+{
+  int i, col;
+  const char *w;
+
+  for (i = 0; i < lines; i++)
+  {
+    for (col = 0; col < 64; )
+    {
+      w = gen_word ();
+      if (col)
+	gen_add (b, " ", 1);
+      if (qp)
+      {
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) w; *p; p++)
+	{
+	  if (*p & 0x80)
+	    gen_printf (b, "=%02X", *p);
+	  else
+	    gen_add (b, (const char *) p, 1);
+	}
+      }
+      else
+	gen_add (b, w, strlen (w));
+      col += strlen (w) + 1;
+    }
+    /* throw in some soft line breaks */
+    if (qp && bench_rand () % 4 == 0)
+      gen_add (b, "=\n", 2);
+    else
+      gen_add (b, "\n", 1);
+  }
+}
+
+static void gen_base64 (GENBUF *b, size_t len)
+{
+  unsigned char in[57], out[128];
+  size_t i, n;
+
+  while (len)
+  {
+    n = len < sizeof (in) ? len : sizeof (in);
+    for (i = 0; i < n; i++)
+      in[i] = bench_rand () & 0xff;
+    mutt_to_base64 (out, in, n, sizeof (out));
+    gen_printf (b, "%s\n", out);
+    len -= n;
+  }
+}
+
+static void gen_date (char *buf, size_t len, time_t t, int rfc822)
+{
+  struct tm *tm = gmtime (&t);
+
+  if (rfc822)
+    snprintf (buf, len, "%s, %d %s %d %02d:%02d:%02d +0000",
+	      DayNames[tm->tm_wday], tm->tm_mday, MonthNames[tm->tm_mon],
+	      tm->tm_year + 1900, tm->tm_hour, tm->tm_min, tm->tm_sec);
+  else
+    snprintf (buf, len, "%s %s %2d %02d:%02d:%02d %d",
+	      DayNames[tm->tm_wday], MonthNames[tm->tm_mon], tm->tm_mday,
+	      tm->tm_hour, tm->tm_min, tm->tm_sec, tm->tm_year + 1900);
+}
+
+/* gen_message: build message i into b. parent[] and subj[] describe the
+ * thread structure of all messages so far. */
+static void gen_message (GENBUF *b, int i, const int *parent,
+			 const unsigned long *subj, unsigned long seed,
+			 time_t when)
+{
+  char date[SHORT_STRING];
+  char boundary[SHORT_STRING];
+  unsigned long user = bench_rand () % 500;
+  int kind = bench_rand () % 10;
+  int lines = 5 + bench_rand () % 60;
+  int p, depth;
+
+  b->len = 0;
+
+  gen_date (date, sizeof (date), when, 1);
+  gen_printf (b, "Date: %s\n", date);
+  gen_printf (b, "From: User %lu <user%lu@%s>\n", user, user,
+	      Domains[user % NUM_DOMAINS]);
+  gen_printf (b, "To: bench-list@%s\n", Domains[seed % NUM_DOMAINS]);
+  if (bench_rand () % 3 == 0)
+    gen_printf (b, "Cc: user%lu@%s\n", (user * 7) % 500,
+		Domains[(user + 1) % NUM_DOMAINS]);
+  gen_printf (b, "Subject: %s", parent[i] >= 0 ? "Re: " : "");
+  gen_subject (b, subj[i]);
+  gen_add (b, "\n", 1);
+  gen_printf (b, "Message-ID: <%d.%lu@bench.example>\n", i, seed);
+  if (parent[i] >= 0)
+  {
+    gen_printf (b, "In-Reply-To: <%d.%lu@bench.example>\n", parent[i], seed);
+    gen_printf (b, "References:");
+    for (p = parent[i], depth = 0; p >= 0 && depth < 10; p = parent[p], depth++)
+      gen_printf (b, " <%d.%lu@bench.example>", p, seed);
+    gen_add (b, "\n", 1);
+  }
+  gen_printf (b, "MIME-Version: 1.0\n");
+
+  snprintf (boundary, sizeof (boundary), "bench-%d-%lu", i, seed);
+
+  switch (kind)
+  {
+    case 6:
+      gen_printf (b, "Content-Type: text/plain; charset=utf-8\n"
+		  "Content-Transfer-Encoding: quoted-printable\n\n");
+      gen_text (b, lines, 1);
+      break;
+
+    case 7:
+    case 8:
+      gen_printf (b, "Content-Type: multipart/alternative; boundary=\"%s\"\n\n",
+		  boundary);
+      gen_printf (b, "--%s\nContent-Type: text/plain; charset=utf-8\n"
+		  "Content-Transfer-Encoding: 8bit\n\n", boundary);
+      gen_text (b, lines, 0);
+      gen_printf (b, "--%s\nContent-Type: text/html; charset=utf-8\n"
+		  "Content-Transfer-Encoding: quoted-printable\n\n<html><body><p>\n",
+		  boundary);
+      gen_text (b, lines, 1);
+      gen_printf (b, "</p></body></html>\n--%s--\n", boundary);
+      break;
+
+    case 9:
+      gen_printf (b, "Content-Type: multipart/mixed; boundary=\"%s\"\n\n",
+		  boundary);
+      gen_printf (b, "--%s\nContent-Type: text/plain; charset=utf-8\n"
+		  "Content-Transfer-Encoding: 8bit\n\n", boundary);
+      gen_text (b, lines, 0);
+      gen_printf (b, "--%s\nContent-Type: application/octet-stream; name=\"data%d.bin\"\n"
+		  "Content-Disposition: attachment; filename=\"data%d.bin\"\n"
+		  "Content-Transfer-Encoding: base64\n\n", boundary, i, i);
+      gen_base64 (b, 1024 + bench_rand () % 8192);
+      gen_printf (b, "--%s--\n", boundary);
+      break;
+
+    default:
+      gen_printf (b, "Content-Type: text/plain; charset=utf-8\n"
+		  "Content-Transfer-Encoding: 8bit\n\n");
+      gen_text (b, lines, 0);
+      break;
+  }
+}
+
+static int gen_mkdir (const char *path)
+{
+  if (mkdir (path, 0700) < 0 && errno != EEXIST)
+  {
+    fprintf (stderr, "mutt_bench: mkdir %s: %s\n", path, strerror (errno));
+    return -1;
+  }
+  return 0;
+}
+
+static int gen_folders (const char *dir, int msgs, unsigned long seed)
+{
+  char path[BENCH_PATH_MAX];
+  char date[SHORT_STRING];
+  GENBUF b;
+  FILE *mbox, *fp;
+  int *parent;
+  unsigned long *subj;
+  time_t when = 1262304000;	/* 2010-01-01 */
+  int i, rc = -1;
+
+  snprintf (path, sizeof (path), "%s/stamp", dir);
+  if (access (path, F_OK) == 0)
+    return 0;
+
+  fprintf (stderr, "mutt_bench: generating %d messages in %s\n", msgs, dir);
+
+  if (gen_mkdir (dir) < 0)
+    return -1;
+  snprintf (path, sizeof (path), "%s/maildir", dir);
+  if (gen_mkdir (path) < 0)
+    return -1;
+  snprintf (path, sizeof (path), "%s/maildir/cur", dir);
+  if (gen_mkdir (path) < 0)
+    return -1;
+  snprintf (path, sizeof (path), "%s/maildir/new", dir);
+  if (gen_mkdir (path) < 0)
+    return -1;
+  snprintf (path, sizeof (path), "%s/maildir/tmp", dir);
+  if (gen_mkdir (path) < 0)
+    return -1;
+  snprintf (path, sizeof (path), "%s/mh", dir);
+  if (gen_mkdir (path) < 0)
+    return -1;
+  snprintf (path, sizeof (path), "%s/mh/.mh_sequences", dir);
+  if (!(fp = fopen (path, "w")))
+    return -1;
+  fclose (fp);
+
+  snprintf (path, sizeof (path), "%s/mbox", dir);
+  if (!(mbox = fopen (path, "w")))
+  {
+    fprintf (stderr, "mutt_bench: %s: %s\n", path, strerror (errno));
+    return -1;
+  }
+
+  memset (&b, 0, sizeof (b));
+  parent = safe_calloc (msgs, sizeof (int));
+  subj = safe_calloc (msgs, sizeof (unsigned long));
+
+  BenchState = (seed * 2654435761UL + 1) & 0xffffffffUL;
+  if (!BenchState)
+    BenchState = 1;
+  for (i = 0; i < msgs; i++)
+  {
+    when += bench_rand () % 1200;
+
+    /* about 60% of the messages are replies */
+    if (i && bench_rand () % 10 < 6)
+    {
+      parent[i] = i - 1 - bench_rand () % (i < BENCH_THREAD_WINDOW ? i : BENCH_THREAD_WINDOW);
+      subj[i] = subj[parent[i]];
+    }
+    else
+    {
+      parent[i] = -1;
+      subj[i] = bench_rand ();
+    }
+
+    gen_message (&b, i, parent, subj, seed, when);
+
+    gen_date (date, sizeof (date), when, 0);
+    fprintf (mbox, "From user@bench.example %s\n", date);
+    fwrite (b.data, 1, b.len, mbox);
+    fputc ('\n', mbox);
+
+    snprintf (path, sizeof (path), "%s/maildir/%s/%ld.B%dM%lu.bench%s", dir,
+	      i % 5 ? "cur" : "new", (long) when, i, seed,
+	      i % 5 ? (i % 3 ? ":2,S" : ":2,RS") : "");
+    if (!(fp = fopen (path, "w")))
+      goto bail;
+    fwrite (b.data, 1, b.len, fp);
+    fclose (fp);
+
+    snprintf (path, sizeof (path), "%s/mh/%d", dir, i + 1);
+    if (!(fp = fopen (path, "w")))
+      goto bail;
+    fwrite (b.data, 1, b.len, fp);
+    fclose (fp);
+  }
+
+  /* decoder input */
+  snprintf (path, sizeof (path), "%s/base64", dir);
+  if (!(fp = fopen (path, "w")))
+    goto bail;
+  b.len = 0;
+  gen_base64 (&b, BENCH_DECODE_SIZE / 4 * 3);
+  fwrite (b.data, 1, b.len, fp);
+  fclose (fp);
+
+  snprintf (path, sizeof (path), "%s/qp", dir);
+  if (!(fp = fopen (path, "w")))
+    goto bail;
+  b.len = 0;
+  while (b.len < BENCH_DECODE_SIZE)
+    gen_text (&b, 100, 1);
+  fwrite (b.data, 1, b.len, fp);
+  fclose (fp);
+
+  snprintf (path, sizeof (path), "%s/stamp", dir);
+  if (!(fp = fopen (path, "w")))
+    goto bail;
+  fprintf (fp, "%d %lu\n", msgs, seed);
+  fclose (fp);
+
+  rc = 0;
+
+bail:
+  if (rc)
+    fprintf (stderr, "mutt_bench: %s: %s\n", path, strerror (errno));
+  if (fclose (mbox) != 0)
+    rc = -1;
+  FREE (&b.data);
+  FREE (&parent);
+  FREE (&subj);
+  return rc;
+}
+
+/* --- benchmarks --- */
+
+static CONTEXT *bench_open (const char *name, const char *path)
+{
+  CONTEXT *ctx;
+  double t = bench_now ();
+
+  if (!(ctx = mx_open_mailbox (path, M_NOSORT | M_READONLY | M_QUIET, NULL)))
+  {
+    fprintf (stderr, "mutt_bench: can't open %s\n", path);
+    return NULL;
+  }
+  if (name)
+    bench_record (name, ctx->msgcount, bench_now () - t);
+
+  return ctx;
+}
+
+static void bench_close (CONTEXT **ctx)
+{
+  if (Context == *ctx)
+    Context = NULL;
+  mx_fastclose_mailbox (*ctx);
+  FREE (ctx);			/* __FREE_CHECKED__ */
+}
+
+static int bench_folder (const char *name, const char *path, int repeat)
+{
+  CONTEXT *ctx;
+  int i;
+
+  for (i = 0; i < repeat; i++)
+  {
+    if (!(ctx = bench_open (name, path)))
+      return -1;
+    bench_close (&ctx);
+  }
+  return 0;
+}
+
+#ifdef USE_HCACHE
+static int bench_hcache (const char *dir, int repeat)
+{
+  char path[BENCH_PATH_MAX];
+  char cache[BENCH_PATH_MAX];
+  CONTEXT *ctx;
+  int i;
+
+  snprintf (path, sizeof (path), "%s/maildir", dir);
+  snprintf (cache, sizeof (cache), "%s/hcache", dir);
+  mutt_str_replace (&HeaderCache, cache);
+
+  for (i = 0; i < repeat; i++)
+  {
+    /* hcache file names are derived from the folder, so start afresh */
+    mutt_rmtree (cache);
+    if (gen_mkdir (cache) < 0)
+      return -1;
+
+    if (!(ctx = bench_open ("hcache_store", path)))
+      return -1;
+    bench_close (&ctx);
+
+    if (!(ctx = bench_open ("hcache_restore", path)))
+      return -1;
+    bench_close (&ctx);
+  }
+
+  mutt_rmtree (cache);
+  FREE (&HeaderCache);
+
+  return 0;
+}
+#endif
+
+static void bench_sort (CONTEXT *ctx, const char *name, int sort, int repeat)
+{
+  double t;
+  int i;
+
+  for (i = 0; i < repeat; i++)
+  {
+    /* start from folder order each time */
+    Sort = SORT_ORDER;
+    mutt_sort_headers (ctx, 1);
+
+    Sort = sort;
+    t = bench_now ();
+    mutt_sort_headers (ctx, 1);
+    bench_record (name, ctx->msgcount, bench_now () - t);
+  }
+}
+
+static int bench_pattern (CONTEXT *ctx, const char *name, const char *expr,
+			  int repeat)
+{
+  char buf[STRING];
+  char errbuf[STRING];
+  BUFFER err;
+  pattern_t *pat;
+  double t;
+  int i, j, matches = 0;
+
+  memset (&err, 0, sizeof (err));
+  err.data = errbuf;
+  err.dsize = sizeof (errbuf);
+
+  strfcpy (buf, expr, sizeof (buf));
+  if (!(pat = mutt_pattern_comp (buf, M_FULL_MSG, &err)))
+  {
+    fprintf (stderr, "mutt_bench: %s: %s\n", expr, errbuf);
+    return -1;
+  }
+
+  for (i = 0; i < repeat; i++)
+  {
+    t = bench_now ();
+    for (j = 0, matches = 0; j < ctx->msgcount; j++)
+      if (mutt_pattern_exec (pat, M_MATCH_FULL_ADDRESS, ctx, ctx->hdrs[j]))
+	matches++;
+    bench_record (name, ctx->msgcount, bench_now () - t);
+  }
+  dprint (1, (debugfile, "mutt_bench: %s: %d matches\n", expr, matches));
+
+  mutt_pattern_free (&pat);
+  return 0;
+}
+
+/* mime.h can't be included along with the global definitions, so the
+ * part is described by name */
+static int bench_decode (const char *name, const char *path,
+			 const char *type, const char *encoding, int repeat)
+{
+  STATE s;
+  BODY *b;
+  struct stat st;
+  double t;
+  int i;
+
+  memset (&s, 0, sizeof (s));
+  if (!(s.fpin = fopen (path, "r")) || fstat (fileno (s.fpin), &st) < 0 ||
+      !(s.fpout = fopen ("/dev/null", "w")))
+  {
+    fprintf (stderr, "mutt_bench: %s: %s\n", path, strerror (errno));
+    safe_fclose (&s.fpin);
+    return -1;
+  }
+
+  b = mutt_new_body ();
+  b->type = mutt_check_mime_type (type);
+  b->subtype = safe_strdup (strchr (type, '/') + 1);
+  b->encoding = mutt_check_encoding (encoding);
+  b->offset = 0;
+  b->length = st.st_size;
+
+  for (i = 0; i < repeat; i++)
+  {
+    t = bench_now ();
+    mutt_decode_attachment (b, &s);
+    bench_record (name, (long) st.st_size, bench_now () - t);
+  }
+
+  mutt_free_body (&b);
+  safe_fclose (&s.fpin);
+  safe_fclose (&s.fpout);
+
+  return 0;
+}
+
+int main (int argc, char **argv)
+{
+  char dir[_POSIX_PATH_MAX];
+  char path[BENCH_PATH_MAX];
+  const char *basedir = "bench-data";
+  const char *output = NULL;
+  unsigned long seed = BENCH_DEFAULT_SEED;
+  int msgs = BENCH_DEFAULT_MSGS;
+  int repeat = BENCH_DEFAULT_REPEAT;
+  int genonly = 0;
+  CONTEXT *ctx;
+  FILE *fp;
+  int ch;
+
+  while ((ch = getopt (argc, argv, "d:gn:o:r:s:")) != EOF)
+  {
+    switch (ch)
+    {
+      case 'd':
+	basedir = optarg;
+	break;
+      case 'g':
+	genonly = 1;
+	break;
+      case 'n':
+	msgs = atoi (optarg);
+	break;
+      case 'o':
+	output = optarg;
+	break;
+      case 'r':
+	repeat = atoi (optarg);
+	break;
+      case 's':
+	seed = strtoul (optarg, NULL, 10);
+	break;
+      default:
+	usage ();
+    }
+  }
+  if (optind != argc || msgs <= 0 || repeat <= 0)
+    usage ();
+
+  setlocale (LC_CTYPE, "");
+  mutt_error = mutt_nocurses_error;
+  mutt_message = mutt_nocurses_error;
+  umask (077);
+
+  if (gen_mkdir (basedir) < 0)
+    return 1;
+  if (snprintf (dir, sizeof (dir), "%s/%d-%lu", basedir, msgs, seed) >= sizeof (dir))
+  {
+    fprintf (stderr, "mutt_bench: %s: %s\n", basedir, strerror (ENAMETOOLONG));
+    return 1;
+  }
+  if (gen_folders (dir, msgs, seed) < 0)
+    return 1;
+  if (genonly)
+    return 0;
+
+  /* defaults only: results must not depend on the user's muttrc */
+  memset (Options, 0, sizeof (Options));
+  memset (QuadOptions, 0, sizeof (QuadOptions));
+  set_option (OPTNOCURSES);
+  mutt_str_replace (&Muttrc, "/dev/null");
+  mutt_init (1, NULL);
+#ifdef USE_DOTLOCK
+  /* the folders are private, and mutt_dotlock may not be installed yet */
+  mutt_str_replace (&MuttDotlock, "true");
+#endif
+
+  snprintf (path, sizeof (path), "%s/maildir", dir);
+  if (bench_folder ("maildir_read_dir", path, repeat) < 0)
+    return 1;
+  snprintf (path, sizeof (path), "%s/mh", dir);
+  if (bench_folder ("mh_read_dir", path, repeat) < 0)
+    return 1;
+#ifdef USE_HCACHE
+  if (bench_hcache (dir, repeat) < 0)
+    return 1;
+#endif
+  snprintf (path, sizeof (path), "%s/mbox", dir);
+  if (bench_folder ("mbox_parse_mailbox", path, repeat) < 0)
+    return 1;
+
+  if (!(ctx = bench_open (NULL, path)))
+    return 1;
+  Context = ctx;
+
+  bench_sort (ctx, "sort_date", SORT_DATE, repeat);
+  bench_sort (ctx, "sort_subject", SORT_SUBJECT, repeat);
+  bench_sort (ctx, "sort_threads", SORT_THREADS, repeat);
+
+  if (bench_pattern (ctx, "pattern_from", "~f user17@", repeat) < 0 ||
+      bench_pattern (ctx, "pattern_subject", "~s 'budget.*review'", repeat) < 0 ||
+      bench_pattern (ctx, "pattern_and", "~N ~C bench-list !~s zebra", repeat) < 0 ||
+      bench_pattern (ctx, "pattern_body", "~b 'zebra meeting'", repeat) < 0)
+    return 1;
+
+  bench_close (&ctx);
+
+  snprintf (path, sizeof (path), "%s/base64", dir);
+  if (bench_decode ("decode_base64", path, "application/octet-stream",
+		    "base64", repeat) < 0)
+    return 1;
+  snprintf (path, sizeof (path), "%s/qp", dir);
+  if (bench_decode ("decode_qp", path, "text/plain",
+		    "quoted-printable", repeat) < 0)
+    return 1;
+
+  if (output)
+  {
+    if (!(fp = fopen (output, "w")))
+    {
+      fprintf (stderr, "mutt_bench: %s: %s\n", output, strerror (errno));
+      return 1;
+    }
+  }
+  else
+    fp = stdout;
+
+  bench_write_json (fp, msgs, seed, repeat);
+
+  if (fp != stdout && fclose (fp) != 0)
+    return 1;
+
+  return 0;
+}
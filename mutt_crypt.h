@@ -181,6 +181,11 @@ const char* crypt_get_fingerprint_or_id (char *p, const char **pphint,
 /* Check if a string contains a numerical key */
 short crypt_is_numerical_keyid (const char *s);
 
+/* Note when the files of the GnuPG keyrings last changed, in arrays of
+   CRYPT_KEYRING_FILES.  Return -1 if there are none of them. */
+#define CRYPT_KEYRING_FILES 6
+int crypt_stat_keyring (time_t *mtime, off_t *size);
+
 
 
 /*-- cryptglue.c --*/
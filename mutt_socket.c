@@ -192,6 +192,35 @@ int mutt_socket_readchar (CONNECTION *conn, char *c)
   return 1;
 }
 
+/* mutt_socket_readn: read exactly len bytes into buf, copying whatever
+ *   the connection has buffered before going back to the network.
+ *   Returns len, or -1 on failure. */
+int mutt_socket_readn (CONNECTION* conn, char* buf, size_t len)
+{
+  size_t got = 0, n;
+
+  while (got < len)
+  {
+    /* refill */
+    if (conn->bufpos >= conn->available)
+    {
+      if (mutt_socket_readchar (conn, buf + got) != 1)
+        return -1;
+      got++;
+      continue;
+    }
+
+    n = conn->available - conn->bufpos;
+    if (n > len - got)
+      n = len - got;
+    memcpy (buf + got, conn->inbuf + conn->bufpos, n);
+    conn->bufpos += n;
+    got += n;
+  }
+
+  return len;
+}
+
 int mutt_socket_readln_d (char* buf, size_t buflen, CONNECTION* conn, int dbg)
 {
   char ch;
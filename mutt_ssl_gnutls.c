@@ -84,6 +84,7 @@ tlssockdata;
 /* local prototypes */
 static int tls_socket_read (CONNECTION* conn, char* buf, size_t len);
 static int tls_socket_write (CONNECTION* conn, const char* buf, size_t len);
+static int tls_socket_poll (CONNECTION* conn);
 static int tls_socket_open (CONNECTION* conn);
 static int tls_socket_close (CONNECTION* conn);
 static int tls_starttls_close (CONNECTION* conn);
@@ -122,7 +123,7 @@ int mutt_ssl_socket_setup (CONNECTION* conn)
   conn->conn_read	= tls_socket_read;
   conn->conn_write	= tls_socket_write;
   conn->conn_close	= tls_socket_close;
-  conn->conn_poll       = raw_socket_poll;
+  conn->conn_poll       = tls_socket_poll;
 
   return 0;
 }
@@ -153,6 +154,17 @@ static int tls_socket_read (CONNECTION* conn, char* buf, size_t len)
   return ret;
 }
 
+/* records already decrypted by GnuTLS don't show up on the socket */
+static int tls_socket_poll (CONNECTION* conn)
+{
+  tlssockdata *data = conn->sockdata;
+
+  if (data && gnutls_record_check_pending (data->state) > 0)
+    return 1;
+
+  return raw_socket_poll (conn);
+}
+
 static int tls_socket_write (CONNECTION* conn, const char* buf, size_t len)
 {
   tlssockdata *data = conn->sockdata;
@@ -210,6 +222,7 @@ int mutt_ssl_starttls (CONNECTION* conn)
   conn->conn_read	= tls_socket_read;
   conn->conn_write	= tls_socket_write;
   conn->conn_close	= tls_starttls_close;
+  conn->conn_poll	= tls_socket_poll;
 
   return 0;
 }
@@ -510,6 +523,7 @@ static int tls_starttls_close (CONNECTION* conn)
   conn->conn_read = raw_socket_read;
   conn->conn_write = raw_socket_write;
   conn->conn_close = raw_socket_close;
+  conn->conn_poll = raw_socket_poll;
 
   return rc;
 }
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* RFC 4978 DEFLATE compression layer. Like the SASL protection layer,
+ * this is stacked on top of whatever transport the connection already
+ * uses (raw, tunnel, SSL, SASL), by saving the old methods and sockdata
+ * and swapping in wrappers. */
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mutt.h"
+#include "mutt_socket.h"
+#include "mutt_zstrm.h"
+
+#include <zlib.h>
+
+#define ZSTRM_BUFSIZE 8192
+
+typedef struct
+{
+  z_stream z;
+  char* buf;
+  unsigned int pending : 1; /* inflate output was truncated last time */
+  unsigned int eos : 1;     /* peer ended the compressed stream */
+} zstrm_direction_t;
+
+typedef struct
+{
+  zstrm_direction_t read;
+  zstrm_direction_t write;
+
+  ZSTRM_STATS stats;
+
+  /* underlying socket data */
+  void* sockdata;
+  int (*mzstrm_open) (CONNECTION* conn);
+  int (*mzstrm_close) (CONNECTION* conn);
+  int (*mzstrm_read) (CONNECTION* conn, char* buf, size_t len);
+  int (*mzstrm_write) (CONNECTION* conn, const char* buf, size_t count);
+  int (*mzstrm_poll) (CONNECTION* conn);
+} ZSTRM_DATA;
+
+static int zstrm_open (CONNECTION* conn);
+static int zstrm_close (CONNECTION* conn);
+static int zstrm_read (CONNECTION* conn, char* buf, size_t len);
+static int zstrm_write (CONNECTION* conn, const char* buf, size_t count);
+static int zstrm_poll (CONNECTION* conn);
+
+static void* zstrm_malloc (void* op, unsigned int sze, unsigned int v)
+{
+  return safe_calloc (sze, v);
+}
+
+static void zstrm_free (void* op, void* ptr)
+{
+  FREE (&ptr);
+}
+
+/* zstrm_ratio: compression ratio in percent, for logging */
+static unsigned int zstrm_ratio (unsigned long long raw,
+                                 unsigned long long wire)
+{
+  if (!raw)
+    return 0;
+  return (unsigned int) (100 - (wire * 100) / raw);
+}
+
+/* mutt_zstrm_wrap_conn: replace connection methods, sockdata with
+ *   DEFLATE wrappers. Must be called right after the server has accepted
+ *   the COMPRESS command, before anything else is sent or read.
+ *   Returns 0 on success, -1 if zlib could not be initialised (in which
+ *   case the connection is left untouched). */
+int mutt_zstrm_wrap_conn (CONNECTION* conn)
+{
+  ZSTRM_DATA* zdata = safe_calloc (1, sizeof (ZSTRM_DATA));
+
+  zdata->read.z.zalloc = zstrm_malloc;
+  zdata->read.z.zfree = zstrm_free;
+  zdata->write.z.zalloc = zstrm_malloc;
+  zdata->write.z.zfree = zstrm_free;
+
+  /* RFC 4978 mandates raw deflate streams without zlib headers */
+  if (inflateInit2 (&zdata->read.z, -15) != Z_OK)
+  {
+    FREE (&zdata);
+    return -1;
+  }
+  if (deflateInit2 (&zdata->write.z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15,
+                    8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    inflateEnd (&zdata->read.z);
+    FREE (&zdata);
+    return -1;
+  }
+
+  zdata->read.buf = safe_malloc (ZSTRM_BUFSIZE);
+  zdata->write.buf = safe_malloc (ZSTRM_BUFSIZE);
+
+  /* preserve old functions */
+  zdata->sockdata = conn->sockdata;
+  zdata->mzstrm_open = conn->conn_open;
+  zdata->mzstrm_close = conn->conn_close;
+  zdata->mzstrm_read = conn->conn_read;
+  zdata->mzstrm_write = conn->conn_write;
+  zdata->mzstrm_poll = conn->conn_poll;
+
+  /* and set up new functions */
+  conn->sockdata = zdata;
+  conn->conn_open = zstrm_open;
+  conn->conn_close = zstrm_close;
+  conn->conn_read = zstrm_read;
+  conn->conn_write = zstrm_write;
+  conn->conn_poll = zstrm_poll;
+
+  dprint (2, (debugfile, "DEFLATE compression enabled on fd=%d\n", conn->fd));
+
+  return 0;
+}
+
+/* mutt_zstrm_get_stats: copy compression counters for conn into stats.
+ *   Returns 0 on success, -1 if conn is not compressed. */
+int mutt_zstrm_get_stats (CONNECTION* conn, ZSTRM_STATS* stats)
+{
+  ZSTRM_DATA* zdata;
+
+  if (conn->conn_read != zstrm_read)
+    return -1;
+
+  zdata = (ZSTRM_DATA*) conn->sockdata;
+  memcpy (stats, &zdata->stats, sizeof (ZSTRM_STATS));
+
+  return 0;
+}
+
+static int zstrm_open (CONNECTION* conn)
+{
+  ZSTRM_DATA* zdata = (ZSTRM_DATA*) conn->sockdata;
+  int rc;
+
+  conn->sockdata = zdata->sockdata;
+  rc = zdata->mzstrm_open (conn);
+  conn->sockdata = zdata;
+
+  return rc;
+}
+
+/* zstrm_close: calls underlying close function and disposes of the zlib
+ *   streams, then restores connection to its uncompressed state */
+static int zstrm_close (CONNECTION* conn)
+{
+  ZSTRM_DATA* zdata = (ZSTRM_DATA*) conn->sockdata;
+
+  dprint (2, (debugfile, "zstrm_close: read %llu->%llu (%u%%), "
+              "wrote %llu->%llu (%u%%)\n",
+              zdata->stats.in_wire, zdata->stats.in_raw,
+              zstrm_ratio (zdata->stats.in_raw, zdata->stats.in_wire),
+              zdata->stats.out_raw, zdata->stats.out_wire,
+              zstrm_ratio (zdata->stats.out_raw, zdata->stats.out_wire)));
+
+  /* restore connection's underlying methods */
+  conn->sockdata = zdata->sockdata;
+  conn->conn_open = zdata->mzstrm_open;
+  conn->conn_close = zdata->mzstrm_close;
+  conn->conn_read = zdata->mzstrm_read;
+  conn->conn_write = zdata->mzstrm_write;
+  conn->conn_poll = zdata->mzstrm_poll;
+
+  inflateEnd (&zdata->read.z);
+  deflateEnd (&zdata->write.z);
+  FREE (&zdata->read.buf);
+  FREE (&zdata->write.buf);
+  FREE (&zdata);
+
+  /* call underlying close */
+  return conn->conn_close (conn);
+}
+
+static int zstrm_read (CONNECTION* conn, char* buf, size_t len)
+{
+  ZSTRM_DATA* zdata = (ZSTRM_DATA*) conn->sockdata;
+  int rc;
+  int zrc;
+
+  if (zdata->read.eos)
+    return 0;
+
+  FOREVER
+  {
+    /* first drain whatever we can from input we already have */
+    if (zdata->read.z.avail_in || zdata->read.pending)
+    {
+      zdata->read.z.next_out = (Bytef*) buf;
+      zdata->read.z.avail_out = len;
+
+      zrc = inflate (&zdata->read.z, Z_SYNC_FLUSH);
+      rc = len - zdata->read.z.avail_out;
+      zdata->read.pending = (zdata->read.z.avail_out == 0);
+
+      switch (zrc)
+      {
+	case Z_OK:
+	case Z_BUF_ERROR:
+	  break;
+	case Z_STREAM_END:
+	  dprint (2, (debugfile, "zstrm_read: server ended compressed stream\n"));
+	  zdata->read.eos = 1;
+	  zdata->read.pending = 0;
+	  break;
+	default:
+	  dprint (1, (debugfile, "zstrm_read: inflate failed: %d (%s)\n", zrc,
+		      NONULL (zdata->read.z.msg)));
+	  return -1;
+      }
+
+      if (rc > 0)
+      {
+	zdata->stats.in_raw += rc;
+	return rc;
+      }
+      if (zdata->read.eos)
+	return 0;
+    }
+
+    /* need more compressed data from the underlying transport */
+    conn->sockdata = zdata->sockdata;
+    rc = zdata->mzstrm_read (conn, zdata->read.buf, ZSTRM_BUFSIZE);
+    conn->sockdata = zdata;
+
+    if (rc <= 0)
+      return rc;
+
+    zdata->stats.in_wire += rc;
+    zdata->read.z.next_in = (Bytef*) zdata->read.buf;
+    zdata->read.z.avail_in = rc;
+  }
+}
+
+static int zstrm_write (CONNECTION* conn, const char* buf, size_t count)
+{
+  ZSTRM_DATA* zdata = (ZSTRM_DATA*) conn->sockdata;
+  int zrc;
+  int rc;
+  size_t wlen, sent;
+
+  zdata->write.z.next_in = (Bytef*) buf;
+  zdata->write.z.avail_in = count;
+
+  /* each write is a complete protocol unit, so flush it all out to a byte
+   * boundary: the server must be able to act on it without waiting for
+   * more data. */
+  do
+  {
+    zdata->write.z.next_out = (Bytef*) zdata->write.buf;
+    zdata->write.z.avail_out = ZSTRM_BUFSIZE;
+
+    zrc = deflate (&zdata->write.z, Z_SYNC_FLUSH);
+    if (zrc != Z_OK && zrc != Z_BUF_ERROR)
+    {
+      dprint (1, (debugfile, "zstrm_write: deflate failed: %d (%s)\n", zrc,
+		  NONULL (zdata->write.z.msg)));
+      return -1;
+    }
+
+    wlen = ZSTRM_BUFSIZE - zdata->write.z.avail_out;
+    conn->sockdata = zdata->sockdata;
+    for (sent = 0; sent < wlen; sent += rc)
+    {
+      if ((rc = zdata->mzstrm_write (conn, zdata->write.buf + sent,
+                                     wlen - sent)) < 0)
+      {
+	conn->sockdata = zdata;
+	return -1;
+      }
+    }
+    conn->sockdata = zdata;
+    zdata->stats.out_wire += wlen;
+  }
+  while (zdata->write.z.avail_in || !zdata->write.z.avail_out);
+
+  zdata->stats.out_raw += count;
+
+  return count;
+}
+
+static int zstrm_poll (CONNECTION* conn)
+{
+  ZSTRM_DATA* zdata = (ZSTRM_DATA*) conn->sockdata;
+  int rc;
+
+  /* inflate may still hold output from the last read */
+  if (zdata->read.z.avail_in || zdata->read.pending)
+    return 1;
+
+  conn->sockdata = zdata->sockdata;
+  rc = zdata->mzstrm_poll (conn);
+  conn->sockdata = zdata;
+
+  return rc;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* RFC 4978 DEFLATE compression layer for connections */
+
+#ifndef _MUTT_ZSTRM_H_
+#define _MUTT_ZSTRM_H_ 1
+
+#include "mutt_socket.h"
+
+/* byte counters for a compressed connection. "raw" is uncompressed
+ * protocol data as seen by the upper layers, "wire" is what was actually
+ * passed to the underlying transport. */
+typedef struct
+{
+  unsigned long long in_raw;
+  unsigned long long in_wire;
+  unsigned long long out_raw;
+  unsigned long long out_wire;
+} ZSTRM_STATS;
+
+int mutt_zstrm_wrap_conn (CONNECTION* conn);
+int mutt_zstrm_get_stats (CONNECTION* conn, ZSTRM_STATS* stats);
+
+#endif /* _MUTT_ZSTRM_H_ */
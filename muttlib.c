@@ -291,6 +291,8 @@ int mutt_remove_from_rx_list (RX_LIST **l, const char *str)
 	p = p->next;
       }
     }
+    if (rv == 0)
+      mutt_rx_list_reindex (l);
   }
   return (rv);
 }
@@ -795,6 +797,7 @@ void mutt_free_alias (ALIAS **p)
     t = *p;
     *p = (*p)->next;
     mutt_alias_delete_reverse (t);
+    mutt_alias_delete_name (t);
     FREE (&t->name);
     rfc822_free_address (&t->addr);
     FREE (&t);
@@ -1832,6 +1835,7 @@ void mutt_free_rx_list (RX_LIST **list)
   RX_LIST *p;
   
   if (!list) return;
+  mutt_rx_list_forget (list);
   while (*list)
   {
     p = *list;
@@ -1856,22 +1860,6 @@ void mutt_free_spam_list (SPAM_LIST **list)
   }
 }
 
-int mutt_match_rx_list (const char *s, RX_LIST *l)
-{
-  if (!s)  return 0;
-  
-  for (; l; l = l->next)
-  {
-    if (regexec (l->rx->rx, s, (size_t) 0, (regmatch_t *) 0, (int) 0) == 0)
-    {
-      dprint (5, (debugfile, "mutt_match_rx_list: %s matches %s\n", s, l->rx->pattern));
-      return 1;
-    }
-  }
-
-  return 0;
-}
-
 /* Match a string against the patterns defined by the 'spam' command and output
  * the expanded format into `text` when there is a match.  If textsize<=0, the
  * match is performed but the format is not expanded and no assumptions are made
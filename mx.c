@@ -29,6 +29,8 @@
 #include "copy.h"
 #include "keymap.h"
 #include "url.h"
+#include "searchidx.h"
+#include "timing.h"
 
 #ifdef USE_IMAP
 #include "imap.h"
@@ -585,6 +587,7 @@ static int mx_open_mailbox_append (CONTEXT *ctx, int flags)
 CONTEXT *mx_open_mailbox (const char *path, int flags, CONTEXT *pctx)
 {
   CONTEXT *ctx = pctx;
+  timing_t start = mutt_timing_now ();
   int rc;
 
   if (!ctx)
@@ -685,6 +688,7 @@ CONTEXT *mx_open_mailbox (const char *path, int flags, CONTEXT *pctx)
     }
     if (!ctx->quiet)
       mutt_clear_error ();
+    mutt_timing_add (TIMING_MX_OPEN, start, ctx->msgcount);
   }
   else
   {
@@ -709,6 +713,9 @@ void mx_fastclose_mailbox (CONTEXT *ctx)
    * XXX: really belongs in mx_close_mailbox, but this is a nice hook point */
   mutt_buffy_setnotified(ctx->path);
 
+  /* needs the headers to know which index entries are still current */
+  mutt_sidx_close (ctx);
+
   if (ctx->mx_close)
     ctx->mx_close (ctx);
 
@@ -803,7 +810,17 @@ int mx_close_mailbox (CONTEXT *ctx, int *index_hint)
     if (ctx->magic == M_MBOX || ctx->magic == M_MMDF)
       mbox_close_mailbox (ctx);
     else
+    {
+#ifdef USE_IMAP
+      /* send what imap_append_batch() left queued */
+      if (ctx->magic == M_IMAP && imap_append_flush (ctx) < 0)
+      {
+	mx_fastclose_mailbox (ctx);
+	return -1;
+      }
+#endif
       mx_fastclose_mailbox (ctx);
+    }
     return 0;
   }
 
@@ -1084,6 +1101,7 @@ int mx_sync_mailbox (CONTEXT *ctx, int *index_hint)
   int rc, i;
   int purge = 1;
   int msgcount, deleted;
+  timing_t start;
 
   if (ctx->dontwrite)
   {
@@ -1140,12 +1158,14 @@ int mx_sync_mailbox (CONTEXT *ctx, int *index_hint)
   msgcount = ctx->msgcount;
   deleted = ctx->deleted;
 
+  start = mutt_timing_now ();
 #ifdef USE_IMAP
   if (ctx->magic == M_IMAP)
     rc = imap_sync_mailbox (ctx, purge, index_hint);
   else
 #endif
     rc = sync_mailbox (ctx, index_hint);
+  mutt_timing_add (TIMING_MX_SYNC, start, msgcount);
   if (rc == 0)
   {
 #ifdef USE_IMAP
@@ -1297,7 +1317,7 @@ MESSAGE *mx_open_new_message (CONTEXT *dest, HEADER *hdr, int flags)
 }
 
 /* check for new mail */
-int mx_check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
+static int check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
 {
   int rc;
 
@@ -1356,6 +1376,17 @@ int mx_check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
   return (-1);
 }
 
+int mx_check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
+{
+  timing_t start = mutt_timing_now ();
+  int rc;
+
+  rc = check_mailbox (ctx, index_hint, lock);
+  mutt_timing_add (TIMING_MX_CHECK, start, ctx ? ctx->msgcount : 0);
+
+  return rc;
+}
+
 /* return a stream pointer for a message */
 MESSAGE *mx_open_message (CONTEXT *ctx, int msgno)
 {
@@ -106,14 +106,47 @@ struct line_t
   LOFF_T offset;
   short type;
   short continuation;
-  short chunks;
-  short search_cnt;
-  struct syntax_t *syntax;
-  struct syntax_t *search;
+  unsigned int is_cont_hdr : 1; /* this line is a continuation of the previous header line */
+  struct syntax_t syntax; /* color of a header line; for a continuation, the
+			   * line it continues (first) and where (last) */
   struct q_class_t *quote;
-  unsigned int is_cont_hdr; /* this line is a continuation of the previous header line */
 };
 
+/* Where color body patterns (Chunks) and the search (Matches) match:
+ * worked out only for the line being drawn, and kept while its
+ * continuations are drawn too. */
+struct chunks_t
+{
+  struct syntax_t *chunk;
+  int line;	/* the line the chunks belong to, or -1 */
+  int count;
+  int max;
+};
+
+static struct chunks_t Chunks = { NULL, -1, 0, 0 };
+static struct chunks_t Matches = { NULL, -1, 0, 0 };
+
+/* The lines of the message the search matches, by the offset they start
+ * at, as far as the message has been scanned. */
+struct search_t
+{
+  regex_t *rx;
+  char *literal;	/* the pattern, if it has no special characters */
+  char first[3];	/* its first character, in either case */
+  int icase;
+  LOFF_T *hit;
+  int hits;
+  int max;
+  LOFF_T scanned;	/* where scanning goes on */
+  int done;		/* whether the whole message has been scanned */
+};
+
+/* lines the pager indexes between checks for a key while it is idle */
+#define PAGER_INDEX_STEP 128
+
+/* bytes of the message the search reads at a time */
+#define PAGER_SEARCH_BLOCK 65536
+
 #define ANSI_OFF       (1<<0)
 #define ANSI_BLINK     (1<<1)
 #define ANSI_BOLD      (1<<2)
@@ -191,15 +224,15 @@ resolve_color (struct line_t *lineInfo, int n, int cnt, int flags, int special,
       addch ('+');
       last_color = ColorDefs[MT_COLOR_MARKERS];
     }
-    m = (lineInfo[n].syntax)[0].first;
-    cnt += (lineInfo[n].syntax)[0].last;
+    m = lineInfo[n].syntax.first;
+    cnt += lineInfo[n].syntax.last;
   }
   else
     m = n;
   if (!(flags & M_SHOWCOLOR))
     def_color = ColorDefs[MT_COLOR_NORMAL];
   else if (lineInfo[m].type == MT_COLOR_HEADER)
-    def_color = (lineInfo[m].syntax)[0].color;
+    def_color = lineInfo[m].syntax.color;
   else
     def_color = ColorDefs[lineInfo[m].type];
 
@@ -220,18 +253,18 @@ resolve_color (struct line_t *lineInfo, int n, int cnt, int flags, int special,
   }
 
   color = def_color;
-  if (flags & M_SHOWCOLOR)
+  if ((flags & M_SHOWCOLOR) && Chunks.line == m)
   {
-    for (i = 0; i < lineInfo[m].chunks; i++)
+    for (i = 0; i < Chunks.count; i++)
     {
       /* we assume the chunks are sorted */
-      if (cnt > (lineInfo[m].syntax)[i].last)
+      if (cnt > Chunks.chunk[i].last)
 	continue;
-      if (cnt < (lineInfo[m].syntax)[i].first)
+      if (cnt < Chunks.chunk[i].first)
 	break;
-      if (cnt != (lineInfo[m].syntax)[i].last)
+      if (cnt != Chunks.chunk[i].last)
       {
-	color = (lineInfo[m].syntax)[i].color;
+	color = Chunks.chunk[i].color;
 	break;
       }
       /* don't break here, as cnt might be 
@@ -239,15 +272,15 @@ resolve_color (struct line_t *lineInfo, int n, int cnt, int flags, int special,
     }
   }
 
-  if (flags & M_SEARCH)
+  if ((flags & M_SEARCH) && Matches.line == m)
   {
-    for (i = 0; i < lineInfo[m].search_cnt; i++)
+    for (i = 0; i < Matches.count; i++)
     {
-      if (cnt > (lineInfo[m].search)[i].last)
+      if (cnt > Matches.chunk[i].last)
 	continue;
-      if (cnt < (lineInfo[m].search)[i].first)
+      if (cnt < Matches.chunk[i].first)
 	break;
-      if (cnt != (lineInfo[m].search)[i].last)
+      if (cnt != Matches.chunk[i].last)
       {
 	color = ColorDefs[MT_COLOR_SEARCH];
 	search = 1;
@@ -311,16 +344,16 @@ append_line (struct line_t *lineInfo, int n, int cnt)
   int m;
 
   lineInfo[n+1].type = lineInfo[n].type;
-  (lineInfo[n+1].syntax)[0].color = (lineInfo[n].syntax)[0].color;
+  lineInfo[n+1].syntax.color = lineInfo[n].syntax.color;
   lineInfo[n+1].continuation = 1;
 
   /* find the real start of the line */
   for (m = n; m >= 0; m--)
     if (lineInfo[m].continuation == 0) break;
 
-  (lineInfo[n+1].syntax)[0].first = m;
-  (lineInfo[n+1].syntax)[0].last = (lineInfo[n].continuation) ? 
-    cnt + (lineInfo[n].syntax)[0].last : cnt;
+  lineInfo[n+1].syntax.first = m;
+  lineInfo[n+1].syntax.last = (lineInfo[n].continuation) ? 
+    cnt + lineInfo[n].syntax.last : cnt;
 }
 
 static void
@@ -710,7 +743,7 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
 {
   COLOR_LINE *color_line;
   regmatch_t pmatch[1], smatch[1];
-  int found, offset, null_rx, i;
+  int i;
 
   if (n == 0 || ISHEADER (lineInfo[n-1].type))
   {
@@ -726,7 +759,7 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
       if (n > 0 && (buf[0] == ' ' || buf[0] == '\t'))
       {
 	lineInfo[n].type = lineInfo[n-1].type; /* wrapped line */
-	(lineInfo[n].syntax)[0].color = (lineInfo[n-1].syntax)[0].color;
+	lineInfo[n].syntax.color = lineInfo[n-1].syntax.color;
 	lineInfo[n].is_cont_hdr = 1;
       }
       else
@@ -739,7 +772,7 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
 	if (REGEXEC (color_line->rx, buf) == 0)
 	{
 	  lineInfo[n].type = MT_COLOR_HEADER;
-	  lineInfo[n].syntax[0].color = color_line->pair;
+	  lineInfo[n].syntax.color = color_line->pair;
 	  if (lineInfo[n].is_cont_hdr)
 	  {
 	    /* adjust the previous continuation lines to reflect the color of this continuation line */
@@ -747,13 +780,13 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
 	    for (j = n - 1; j >= 0 && lineInfo[j].is_cont_hdr; --j)
 	    {
 	      lineInfo[j].type = lineInfo[n].type;
-	      lineInfo[j].syntax[0].color = lineInfo[n].syntax[0].color;
+	      lineInfo[j].syntax.color = lineInfo[n].syntax.color;
 	    }
 	    /* now adjust the first line of this header field */
 	    if (j >= 0)
 	    {
 	      lineInfo[j].type = lineInfo[n].type;
-	      lineInfo[j].syntax[0].color = lineInfo[n].syntax[0].color;
+	      lineInfo[j].syntax.color = lineInfo[n].syntax.color;
 	    }
 	    *force_redraw = 1; /* the previous lines have already been drawn on the screen */
 	  }
@@ -780,16 +813,7 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
 	   (lineInfo[i].type == MT_COLOR_NORMAL ||
 	    lineInfo[i].type == MT_COLOR_QUOTED ||
 	    lineInfo[i].type == MT_COLOR_HEADER))
-      {
-	/* oops... */
-	if (lineInfo[i].chunks)
-	{
-	  lineInfo[i].chunks = 0;
-	  safe_realloc (&(lineInfo[n].syntax), 
-			sizeof (struct syntax_t));
-	}
 	lineInfo[i++].type = MT_COLOR_SIGNATURE;
-      }
   }
   else if (check_sig (buf, lineInfo, n - 1) == 0)
     lineInfo[n].type = MT_COLOR_SIGNATURE;
@@ -834,69 +858,107 @@ resolve_types (char *buf, char *raw, struct line_t *lineInfo, int n, int last,
   else
     lineInfo[n].type = MT_COLOR_NORMAL;
 
-  /* body patterns */
-  if (lineInfo[n].type == MT_COLOR_NORMAL || 
-      lineInfo[n].type == MT_COLOR_QUOTED)
-  {
-    size_t nl;
+}
+
+/* resolve_chunks: match the color body patterns against buf, the text of
+ * line n, for drawing it. */
+static void resolve_chunks (char *buf, int n)
+{
+  COLOR_LINE *color_line;
+  regmatch_t pmatch[1];
+  int found, offset, null_rx, i;
+  size_t nl;
 
-    /* don't consider line endings part of the buffer
-     * for regex matching */
-    if ((nl = mutt_strlen (buf)) > 0 && buf[nl-1] == '\n')
-      buf[nl-1] = 0;
+  Chunks.line = n;
+  Chunks.count = 0;
 
-    i = 0;
-    offset = 0;
-    lineInfo[n].chunks = 0;
-    do
-    {
-      if (!buf[offset])
-	break;
+  /* don't consider line endings part of the buffer
+   * for regex matching */
+  if ((nl = mutt_strlen (buf)) > 0 && buf[nl-1] == '\n')
+    buf[nl-1] = 0;
+  else
+    nl = 0;
+
+  i = 0;
+  offset = 0;
+  do
+  {
+    if (!buf[offset])
+      break;
 
-      found = 0;
-      null_rx = 0;
-      color_line = ColorBodyList;
-      while (color_line)
+    found = 0;
+    null_rx = 0;
+    color_line = ColorBodyList;
+    while (color_line)
+    {
+      if (regexec (&color_line->rx, buf + offset, 1, pmatch,
+		   (offset ? REG_NOTBOL : 0)) == 0)
       {
-	if (regexec (&color_line->rx, buf + offset, 1, pmatch,
-		     (offset ? REG_NOTBOL : 0)) == 0)
+	if (pmatch[0].rm_eo != pmatch[0].rm_so)
 	{
-	  if (pmatch[0].rm_eo != pmatch[0].rm_so)
+	  if (!found)
 	  {
-	    if (!found)
-	    {
-	      if (++(lineInfo[n].chunks) > 1)
-		safe_realloc (&(lineInfo[n].syntax), 
-			      (lineInfo[n].chunks) * sizeof (struct syntax_t));
-	    }
-	    i = lineInfo[n].chunks - 1;
-	    pmatch[0].rm_so += offset;
-	    pmatch[0].rm_eo += offset;
-	    if (!found ||
-		pmatch[0].rm_so < (lineInfo[n].syntax)[i].first ||
-		(pmatch[0].rm_so == (lineInfo[n].syntax)[i].first &&
-		 pmatch[0].rm_eo > (lineInfo[n].syntax)[i].last))
-	    {
-	      (lineInfo[n].syntax)[i].color = color_line->pair;
-	      (lineInfo[n].syntax)[i].first = pmatch[0].rm_so;
-	      (lineInfo[n].syntax)[i].last = pmatch[0].rm_eo;
-	    }
-	    found = 1;
-	    null_rx = 0;
+	    if (++Chunks.count > Chunks.max)
+	      safe_realloc (&Chunks.chunk,
+			    (Chunks.max += 8) * sizeof (struct syntax_t));
 	  }
-	  else
-	    null_rx = 1; /* empty regexp; don't add it, but keep looking */
+	  i = Chunks.count - 1;
+	  pmatch[0].rm_so += offset;
+	  pmatch[0].rm_eo += offset;
+	  if (!found ||
+	      pmatch[0].rm_so < Chunks.chunk[i].first ||
+	      (pmatch[0].rm_so == Chunks.chunk[i].first &&
+	       pmatch[0].rm_eo > Chunks.chunk[i].last))
+	  {
+	    Chunks.chunk[i].color = color_line->pair;
+	    Chunks.chunk[i].first = pmatch[0].rm_so;
+	    Chunks.chunk[i].last = pmatch[0].rm_eo;
+	  }
+	  found = 1;
+	  null_rx = 0;
 	}
-	color_line = color_line->next;
+	else
+	  null_rx = 1; /* empty regexp; don't add it, but keep looking */
       }
+      color_line = color_line->next;
+    }
 
-      if (null_rx)
-	offset++; /* avoid degenerate cases */
-      else
-	offset = (lineInfo[n].syntax)[i].last;
-    } while (found || null_rx);
-    if (nl > 0)
-      buf[nl] = '\n';
+    if (null_rx)
+      offset++; /* avoid degenerate cases */
+    else
+      offset = Chunks.chunk[i].last;
+  } while (found || null_rx);
+  if (nl > 0)
+    buf[nl-1] = '\n';
+}
+
+/* resolve_matches: find where the search matches buf, the text of line n,
+ * for drawing it. */
+static void resolve_matches (char *buf, int n, regex_t *rx)
+{
+  regmatch_t pmatch[1];
+  int offset = 0;
+
+  Matches.line = n;
+  Matches.count = 0;
+
+  while (regexec (rx, buf + offset, 1, pmatch, (offset ? REG_NOTBOL : 0)) == 0)
+  {
+    if (Matches.count == Matches.max)
+      safe_realloc (&Matches.chunk,
+		    (Matches.max += 8) * sizeof (struct syntax_t));
+    pmatch[0].rm_so += offset;
+    pmatch[0].rm_eo += offset;
+    Matches.chunk[Matches.count].first = pmatch[0].rm_so;
+    Matches.chunk[Matches.count].last = pmatch[0].rm_eo;
+    Matches.count++;
+
+    if (pmatch[0].rm_eo == pmatch[0].rm_so)
+      offset++; /* avoid degenerate cases */
+    else
+      offset = pmatch[0].rm_eo;
+    if (!buf[offset])
+      break;
   }
 }
 
@@ -1021,11 +1083,49 @@ trim_incomplete_mbyte(unsigned char *buf, size_t len)
   return len;
 }
 
+/* strip_controls: copy buf to fmt, but without bold and underline
+ * controls, ANSI sequences and attachment markers. */
+static void strip_controls (unsigned char *fmt, unsigned char *buf)
+{
+  unsigned char *p, *q;
+
+  p = buf;
+  q = fmt;
+  while (*p)
+  {
+    if (*p == '\010' && (p > buf))
+    {
+      if (*(p+1) == '_')	/* underline */
+	p += 2;
+      else if (*(p+1) && q > fmt)	/* bold or overstrike */
+      {
+	*(q-1) = *(p+1);
+	p += 2;
+      }
+      else			/* ^H */
+	*q++ = *p++;
+    }
+    else if (*p == '\033' && *(p+1) == '[' && is_ansi (p + 2))
+    {
+      while (*p++ != 'm')	/* skip ANSI sequence */
+	;
+    }
+    else if (*p == '\033' && *(p+1) == ']' && check_attachment_marker ((char *) p) == 0)
+    {
+      dprint (2, (debugfile, "fill_buffer: Seen attachment marker.\n"));
+      while (*p++ != '\a')	/* skip pseudo-ANSI sequence */
+	;
+    }
+    else
+      *q++ = *p++;
+  }
+  *q = 0;
+}
+
 static int
 fill_buffer (FILE *f, LOFF_T *last_pos, LOFF_T offset, unsigned char **buf,
 	     unsigned char **fmt, size_t *blen, int *buf_ready)
 {
-  unsigned char *p, *q;
   static int b_read;
   int l;
 
@@ -1049,38 +1149,7 @@ fill_buffer (FILE *f, LOFF_T *last_pos, LOFF_T offset, unsigned char **buf,
     if (b_read == *blen - 2)
       b_read -= trim_incomplete_mbyte(*buf, b_read);
     
-    /* copy "buf" to "fmt", but without bold and underline controls */
-    p = *buf;
-    q = *fmt;
-    while (*p)
-    {
-      if (*p == '\010' && (p > *buf))
-      {
-	if (*(p+1) == '_')	/* underline */
-	  p += 2;
-	else if (*(p+1) && q > *fmt)	/* bold or overstrike */
-	{
-	  *(q-1) = *(p+1);
-	  p += 2;
-	}
-	else			/* ^H */
-	  *q++ = *p++;
-      }
-      else if (*p == '\033' && *(p+1) == '[' && is_ansi (p + 2))
-      {
-	while (*p++ != 'm')	/* skip ANSI sequence */
-	  ;
-      }
-      else if (*p == '\033' && *(p+1) == ']' && check_attachment_marker ((char *) p) == 0)
-      {
-	dprint (2, (debugfile, "fill_buffer: Seen attachment marker.\n"));
-	while (*p++ != '\a')	/* skip pseudo-ANSI sequence */
-	  ;
-      }
-      else
-	*q++ = *p++;
-    }
-    *q = 0;
+    strip_controls (*fmt, *buf);
   }
   return b_read;
 }
@@ -1258,7 +1327,7 @@ static int format_line (struct line_t **lineInfo, int n, unsigned char *buf,
  *		M_SHOWCOLOR, show characters in color
  *			otherwise don't show characters
  *		M_HIDE, don't show quoted text
- *		M_SEARCH, resolve search patterns
+ *		M_SEARCH, show where the search matches
  *		M_TYPES, compute line's type
  *		M_PAGER_NSKIP, keeps leading whitespace
  *		M_PAGER_MARKER, eventually show markers
@@ -1280,7 +1349,6 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
   int ch, vch, col, cnt, b_read;
   int buf_ready = 0, change_last = 0;
   int special;
-  int offset;
   int def_color;
   int m;
   int rc = -1;
@@ -1300,9 +1368,7 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
     {
       memset (&((*lineInfo)[ch]), 0, sizeof (struct line_t));
       (*lineInfo)[ch].type = -1;
-      (*lineInfo)[ch].search_cnt = -1;
-      (*lineInfo)[ch].syntax = safe_malloc (sizeof (struct syntax_t));
-      ((*lineInfo)[ch].syntax)[0].first = ((*lineInfo)[ch].syntax)[0].last = -1;
+      (*lineInfo)[ch].syntax.first = (*lineInfo)[ch].syntax.last = -1;
     }
   }
 
@@ -1354,38 +1420,6 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
 			    force_redraw, q_level);
   }
 
-  if ((flags & M_SEARCH) && !(*lineInfo)[n].continuation && (*lineInfo)[n].search_cnt == -1) 
-  {
-    if (fill_buffer (f, last_pos, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
-    {
-      if (change_last)
-	(*last)--;
-      goto out;
-    }
-
-    offset = 0;
-    (*lineInfo)[n].search_cnt = 0;
-    while (regexec (SearchRE, (char *) fmt + offset, 1, pmatch, (offset ? REG_NOTBOL : 0)) == 0)
-    {
-      if (++((*lineInfo)[n].search_cnt) > 1)
-	safe_realloc (&((*lineInfo)[n].search),
-		      ((*lineInfo)[n].search_cnt) * sizeof (struct syntax_t));
-      else
-	(*lineInfo)[n].search = safe_malloc (sizeof (struct syntax_t));
-      pmatch[0].rm_so += offset;
-      pmatch[0].rm_eo += offset;
-      ((*lineInfo)[n].search)[(*lineInfo)[n].search_cnt - 1].first = pmatch[0].rm_so;
-      ((*lineInfo)[n].search)[(*lineInfo)[n].search_cnt - 1].last = pmatch[0].rm_eo;
-
-      if (pmatch[0].rm_eo == pmatch[0].rm_so)
-	offset++; /* avoid degenerate cases */
-      else
-	offset = pmatch[0].rm_eo;
-      if (!fmt[offset])
-	break;
-    }
-  }
-
   if (!(flags & M_SHOW) && (*lineInfo)[n+1].offset > 0)
   {
     /* we've already scanned this line, so just exit */
@@ -1454,6 +1488,40 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
     goto out;
   }
 
+  /* the color body patterns and the search are only matched for what is
+   * drawn. A continuation line needs them for the whole line it is part of. */
+  m = ((*lineInfo)[n].continuation) ? (*lineInfo)[n].syntax.first : n;
+  if (((flags & M_SHOWCOLOR) && Chunks.line != m) ||
+      ((flags & M_SEARCH) && Matches.line != m))
+  {
+    unsigned char *mbuf = NULL, *mfmt = NULL, *text = fmt;
+    size_t mbuflen = 0;
+    int mbuf_ready = 0;
+
+    if (m != n)
+      text = (fill_buffer (f, last_pos, (*lineInfo)[m].offset, &mbuf, &mfmt,
+			   &mbuflen, &mbuf_ready) < 0) ? NULL : mfmt;
+
+    if ((flags & M_SHOWCOLOR) && Chunks.line != m)
+    {
+      Chunks.line = m;
+      Chunks.count = 0;
+      if (text && ColorBodyList && ((*lineInfo)[m].type == MT_COLOR_NORMAL ||
+				    (*lineInfo)[m].type == MT_COLOR_QUOTED))
+	resolve_chunks ((char *) text, m);
+    }
+    if ((flags & M_SEARCH) && Matches.line != m)
+    {
+      Matches.line = m;
+      Matches.count = 0;
+      if (text)
+	resolve_matches ((char *) text, m, SearchRE);
+    }
+
+    FREE (&mbuf);
+    FREE (&mfmt);
+  }
+
   /* display the line */
   format_line (lineInfo, n, buf, flags, &a, cnt, &ch, &vch, &col, &special);
 
@@ -1477,9 +1545,9 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
    */
   if (flags & M_SHOWCOLOR)
   {
-    m = ((*lineInfo)[n].continuation) ? ((*lineInfo)[n].syntax)[0].first : n;
+    m = ((*lineInfo)[n].continuation) ? (*lineInfo)[n].syntax.first : n;
     if ((*lineInfo)[m].type == MT_COLOR_HEADER)
-      def_color = ((*lineInfo)[m].syntax)[0].color;
+      def_color = (*lineInfo)[m].syntax.color;
     else
       def_color = ColorDefs[ (*lineInfo)[m].type ];
 
@@ -1528,6 +1596,327 @@ upNLines (int nlines, struct line_t *info, int cur, int hiding)
   return cur;
 }
 
+/* key_pending: whether a key is waiting to be read. It is left there. */
+static int key_pending (void)
+{
+  event_t ev;
+
+  timeout (0);
+  ev = mutt_getch ();
+  timeout (-1);
+  if (ev.ch == -2)
+    return 0;
+  if (ev.ch != -1)
+    mutt_unget_event (ev.ch, ev.op);
+  return 1;
+}
+
+/* index_lines: work out the lines of the message past the last one known,
+ * as <bottom> or a search would have to, for as long as no key is waiting.
+ * Returns 1 once the end of the message is reached. */
+static int
+index_lines (FILE *f, LOFF_T *last_pos, LOFF_T size, struct line_t **lineInfo,
+	     int *last, int *max, int flags, struct q_class_t **QuoteList,
+	     int *q_level, int *force_redraw, regex_t *SearchRE)
+{
+  int i;
+
+  FOREVER
+  {
+    for (i = 0; i < PAGER_INDEX_STEP; i++)
+    {
+      if ((*lineInfo)[*last].offset >= size ||
+	  display_line (f, last_pos, lineInfo, *last, last, max, flags,
+			QuoteList, q_level, force_redraw, SearchRE) != 0)
+	return 1;
+    }
+
+    if (SigWinch || *force_redraw || key_pending ())
+      return 0;
+  }
+  /* not reached */
+}
+
+/* search_init: start a search for pattern, compiled as rx. A pattern with
+ * no special characters is looked for as a string first, so that regexec()
+ * only has to check the lines it occurs in. */
+static void search_init (struct search_t *s, regex_t *rx, const char *pattern)
+{
+  const char *p;
+
+  FREE (&s->literal);
+  s->rx = rx;
+  s->hits = 0;
+  s->scanned = 0;
+  s->done = 0;
+  s->icase = (mutt_which_case (pattern) == REG_ICASE);
+
+  /* without case, letters outside ASCII may match others than themselves */
+  for (p = pattern; *p; p++)
+    if (strchr (".[]()*+?{}|^$\\", *p) ||
+	(s->icase && (unsigned char) *p >= 0x80))
+      break;
+  if (!*p && *pattern)
+  {
+    s->literal = safe_strdup (pattern);
+    s->first[0] = *pattern;
+    s->first[1] = (*pattern >= 'a' && *pattern <= 'z') ? *pattern - 'a' + 'A' : 0;
+    s->first[2] = 0;
+  }
+}
+
+static void search_free (struct search_t *s)
+{
+  FREE (&s->literal);
+  FREE (&s->hit);
+  s->hits = s->max = 0;
+}
+
+/* search_find: the first match at or after offset. */
+static int search_find (struct search_t *s, LOFF_T offset)
+{
+  int lo = 0, hi = s->hits, mid;
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (s->hit[mid] < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* search_literal: where the literal pattern occurs in text. Without case
+ * this only compares ASCII letters. */
+static const char *search_literal (struct search_t *s, const char *text)
+{
+  const char *p;
+  int i;
+
+  if (!s->icase)
+    return strstr (text, s->literal);
+
+  for (p = text; (p = strpbrk (p, s->first)) != NULL; p++)
+  {
+    for (i = 1; s->literal[i] &&
+	   ascii_tolower ((unsigned char) p[i]) == s->literal[i]; i++)
+      ;
+    if (!s->literal[i])
+      return p;
+  }
+  return NULL;
+}
+
+/* plain_text: whether len bytes at p are what the pager shows of them: no
+ * controls fill_buffer() strips and no NUL. With ascii, nothing outside
+ * ASCII either. */
+static int plain_text (const unsigned char *p, size_t len, int ascii)
+{
+  for (; len; p++, len--)
+    if (!*p || *p == '\010' || *p == '\033' || (ascii && *p >= 0x80))
+      return 0;
+  return 1;
+}
+
+/* search_block: record the lines in the len bytes at block, from offset in
+ * the message, that the search matches. block holds whole lines and
+ * block[len] may be overwritten. */
+static void search_block (struct search_t *s, unsigned char *block,
+			  size_t len, LOFF_T offset)
+{
+  unsigned char *p, *end, *fmt = NULL;
+  const char *text;
+  size_t fmtlen = 0;
+  int c, skip;
+
+  block[len] = 0;
+  skip = s->literal && plain_text (block, len, s->icase);
+  p = block;
+  while (p < block + len)
+  {
+    if (skip)
+    {
+      /* only the lines with the pattern in them need checking */
+      if ((text = search_literal (s, (char *) p)) == NULL)
+	break;
+      for (end = (unsigned char *) text; end > p && end[-1] != '\n'; end--)
+	;
+      p = end;
+    }
+
+    if ((end = memchr (p, '\n', block + len - p)) == NULL)
+      end = block + len;
+    c = *end;
+    *end = 0;
+
+    text = (char *) p;
+    if (memchr (p, '\010', end - p) || memchr (p, '\033', end - p))
+    {
+      if (fmtlen < end - p + 1)
+	safe_realloc (&fmt, fmtlen = end - p + 1);
+      strip_controls (fmt, p);
+      text = (char *) fmt;
+    }
+
+    if ((!s->literal || search_literal (s, text) ||
+	 (s->icase && !plain_text ((unsigned char *) text, strlen (text), 1))) &&
+	regexec (s->rx, text, 0, NULL, 0) == 0)
+    {
+      if (s->hits == s->max)
+	safe_realloc (&s->hit, (s->max += 256) * sizeof (LOFF_T));
+      s->hit[s->hits++] = offset + (p - block);
+    }
+
+    *end = c;
+    p = end + 1;
+  }
+  FREE (&fmt);
+}
+
+/* search_scan: look for the search in the message from where the last scan
+ * stopped, a block at a time, until past offset until, the end of the
+ * message, or a key press. Returns -1 if a key stopped it. */
+static int search_scan (struct search_t *s, FILE *f, LOFF_T *last_pos,
+			LOFF_T until)
+{
+  unsigned char *block;
+  size_t size = PAGER_SEARCH_BLOCK, len, n;
+  int rc = 0;
+
+  block = safe_malloc (size + 1);
+  while (!s->done && s->scanned <= until)
+  {
+    fseeko (f, s->scanned, 0);
+    len = fread (block, 1, size, f);
+    *last_pos = ftello (f);
+
+    n = len;
+    if (len == size)
+    {
+      /* leave the last line if it goes on past the block */
+      while (n > 0 && block[n - 1] != '\n')
+	n--;
+      if (n == 0)
+      {
+	safe_realloc (&block, (size *= 2) + 1);
+	continue;
+      }
+    }
+    else
+      s->done = 1;
+
+    search_block (s, block, n, s->scanned);
+    s->scanned += n;
+
+    if (!s->done && (SigWinch || key_pending ()))
+    {
+      rc = -1;
+      break;
+    }
+  }
+  FREE (&block);
+  return rc;
+}
+
+/* search_line: the line that starts at offset, working out the lines up to
+ * it if need be. Returns -1 if there is none, -2 if a key interrupted. */
+static int
+search_line (LOFF_T offset, FILE *f, LOFF_T *last_pos, struct line_t **lineInfo,
+	     int *last, int *max, int flags, struct q_class_t **QuoteList,
+	     int *q_level, int *force_redraw, regex_t *SearchRE)
+{
+  int lo = 0, hi, mid, i;
+
+  for (i = 1; (*lineInfo)[*last].offset <= offset; i++)
+  {
+    if (display_line (f, last_pos, lineInfo, *last, last, max, flags,
+		      QuoteList, q_level, force_redraw, SearchRE) != 0)
+      break;
+    if (i % PAGER_INDEX_STEP == 0 && (SigWinch || key_pending ()))
+      return -2;
+  }
+
+  hi = *last;
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if ((*lineInfo)[mid].offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < *last && (*lineInfo)[lo].offset == offset)
+    return lo;
+  return -1;
+}
+
+/* search_next: the first line from line from on, going forward (dir > 0)
+ * or backward, that the search matches and that isn't hidden. Going
+ * backward from past the lines known means from the end. Returns -1 if
+ * there is none, -2 if a key interrupted the search. */
+static int
+search_next (struct search_t *s, int from, int dir, int hide, FILE *f,
+	     LOFF_T *last_pos, struct line_t **lineInfo, int *last, int *max,
+	     int flags, struct q_class_t **QuoteList, int *q_level,
+	     int *force_redraw)
+{
+  LOFF_T offset;
+  int k, n;
+
+  if (dir > 0)
+  {
+    while (from >= *last &&
+	   display_line (f, last_pos, lineInfo, *last, last, max, flags,
+			 QuoteList, q_level, force_redraw, s->rx) == 0)
+      ;
+    if (from >= *last)
+      return -1;
+
+    for (k = search_find (s, (*lineInfo)[from].offset); ; k++)
+    {
+      while (k >= s->hits)
+      {
+	if (s->done)
+	  return -1;
+	if (search_scan (s, f, last_pos, s->scanned) < 0)
+	  return -2;
+      }
+      if ((n = search_line (s->hit[k], f, last_pos, lineInfo, last, max,
+			    flags, QuoteList, q_level, force_redraw, s->rx)) == -2 ||
+	  (n >= 0 && (!hide || (*lineInfo)[n].type != MT_COLOR_QUOTED)))
+	return n;
+    }
+  }
+
+  if (from < 0)
+    return -1;
+  if (from >= *last)
+  {
+    while (!s->done)
+      if (search_scan (s, f, last_pos, s->scanned) < 0)
+	return -2;
+    k = s->hits - 1;
+  }
+  else
+  {
+    offset = (*lineInfo)[from].offset;
+    if (search_scan (s, f, last_pos, offset) < 0)
+      return -2;
+    k = search_find (s, offset + 1) - 1;
+  }
+
+  for (; k >= 0; k--)
+  {
+    if ((n = search_line (s->hit[k], f, last_pos, lineInfo, last, max,
+			  flags, QuoteList, q_level, force_redraw, s->rx)) == -2 ||
+	(n >= 0 && (!hide || (*lineInfo)[n].type != MT_COLOR_QUOTED)))
+      return n;
+  }
+  return -1;
+}
+
 static const struct mapping_t PagerHelp[] = {
   { N_("Exit"),	OP_EXIT },
   { N_("PrevPg"), OP_PREV_PAGE },
@@ -1564,11 +1953,13 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
   int r = -1, wrapped = 0, searchctx = 0;
   int redraw = REDRAW_FULL;
   FILE *fp = NULL;
-  LOFF_T last_pos = 0, last_offset = 0;
+  LOFF_T last_pos = 0, last_offset = 0, drawn_pos = 0;
   int old_smart_wrap, old_markers;
   struct stat sb;
   regex_t SearchRE;
+  struct search_t search;
   int SearchCompiled = 0, SearchFlag = 0, SearchBack = 0;
+  int indexed = 0;			/* whether all lines are known */
   int has_types = (IsHeader(extra) || (flags & M_SHOWCOLOR)) ? M_TYPES : 0; /* main message or rfc822 attachment */
 
   int bodyoffset = 1;			/* offset of first line of real text */
@@ -1613,10 +2004,9 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
   {
     memset (&lineInfo[i], 0, sizeof (struct line_t));
     lineInfo[i].type = -1;
-    lineInfo[i].search_cnt = -1;
-    lineInfo[i].syntax = safe_malloc (sizeof (struct syntax_t));
-    (lineInfo[i].syntax)[0].first = (lineInfo[i].syntax)[0].last = -1;
+    lineInfo[i].syntax.first = lineInfo[i].syntax.last = -1;
   }
+  memset (&search, 0, sizeof (search));
 
   mutt_compile_help (helpstr, sizeof (helpstr), MENU_PAGER, PagerHelp);
   if (IsHeader (extra))
@@ -1686,6 +2076,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
 	{
 	  REGCOMP
 	    (&SearchRE, searchbuf, REG_NEWLINE | mutt_which_case (searchbuf));
+	  search_init (&search, &SearchRE, searchbuf);
 	  SearchFlag = M_SEARCH;
 	  SearchBack = Resize->SearchBack;
 	}
@@ -1734,13 +2125,12 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
       i = -1;
       j = -1;
       while (display_line (fp, &last_pos, &lineInfo, ++i, &lastLine, &maxLine,
-	     has_types | SearchFlag | (flags & M_PAGER_NOWRAP), &QuoteList, &q_level, &force_redraw,
+	     has_types | (flags & M_PAGER_NOWRAP), &QuoteList, &q_level, &force_redraw,
 	     &SearchRE) == 0)
 	if (!lineInfo[i].continuation && ++j == lines)
 	{
 	  topline = i;
-	  if (!SearchFlag)
-	    break;
+	  break;
 	}
     }
 
@@ -1751,6 +2141,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
 	curline = oldtopline = topline;
 	lines = 0;
 	force_redraw = 0;
+	Chunks.line = Matches.line = -1;
 
 	while (lines < bodylen && lineInfo[curline].offset <= sb.st_size - 1)
 	{
@@ -1762,6 +2153,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
 	  curline++;
 	}
 	last_offset = lineInfo[curline].offset;
+	drawn_pos = last_pos;
       } while (force_redraw);
 
       SETCOLOR (MT_COLOR_TILDE);
@@ -1789,7 +2181,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
       hfi.ctx = Context;
       hfi.pager_progress = pager_progress_str;
 
-      if (last_pos < sb.st_size - 1)
+      if (drawn_pos < sb.st_size - 1)
 	snprintf(pager_progress_str, sizeof(pager_progress_str), OFF_T_FMT "%%", (100 * last_offset / sb.st_size));
       else
 	strfcpy(pager_progress_str, (topline == 0) ? "all" : "end", sizeof(pager_progress_str));
@@ -1858,7 +2250,26 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
     }
     else
       OldHdr = NULL;
-      
+
+    /* index the rest of the message until a key is pressed, so that
+     * <bottom> and searches needn't, then look for the search in it */
+    if (!indexed)
+    {
+      indexed = index_lines (fp, &last_pos, sb.st_size, &lineInfo, &lastLine,
+			     &maxLine, has_types |
+			     (flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP)),
+			     &QuoteList, &q_level, &force_redraw, &SearchRE);
+      if (force_redraw)
+      {
+	/* a header field has turned out to be colored after all */
+	force_redraw = 0;
+	redraw = REDRAW_BODY;
+	continue;
+      }
+    }
+    if (indexed && SearchCompiled && !search.done)
+      search_scan (&search, fp, &last_pos, sb.st_size);
+
     ch = km_dokey (MENU_PAGER);
     if (ch != -1)
       mutt_clear_error ();
@@ -1898,17 +2309,11 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
 	  lineInfo[i].offset = 0;
 	  lineInfo[i].type = -1;
 	  lineInfo[i].continuation = 0;
-	  lineInfo[i].chunks = 0;
-	  lineInfo[i].search_cnt = -1;
 	  lineInfo[i].quote = NULL;
-
-	  safe_realloc (&(lineInfo[i].syntax),
-			sizeof (struct syntax_t));
-	  if (SearchCompiled && lineInfo[i].search)
-	      FREE (&(lineInfo[i].search));
 	}
 
 	lastLine = 0;
+	indexed = 0;
 	topline = 0;
 
 	redraw = REDRAW_FULL | REDRAW_SIGWINCH;
@@ -2041,15 +2446,15 @@ search_next:
 	      (SearchBack &&ch==OP_SEARCH_OPPOSITE))
 	  {
 	    /* searching forward */
-	    for (i = wrapped ? 0 : topline + searchctx + 1; i < lastLine; i++)
-	    {
-	      if ((!hideQuoted || lineInfo[i].type != MT_COLOR_QUOTED) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
+	    i = search_next (&search, wrapped ? 0 : topline + searchctx + 1, 1,
+			     hideQuoted, fp, &last_pos, &lineInfo, &lastLine,
+			     &maxLine, has_types | (flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP)),
+			     &QuoteList, &q_level, &force_redraw);
 
-	    if (i < lastLine)
+	    if (i >= 0)
 	      topline = i;
+	    else if (i == -2)
+	      mutt_error _("Search interrupted.");
 	    else if (wrapped || !option (OPTWRAPSEARCH))
 	      mutt_error _("Not found.");
 	    else
@@ -2062,16 +2467,15 @@ search_next:
 	  else
 	  {
 	    /* searching backward */
-	    for (i = wrapped ? lastLine : topline + searchctx - 1; i >= 0; i--)
-	    {
-	      if ((!hideQuoted || (has_types && 
-		    lineInfo[i].type != MT_COLOR_QUOTED)) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
+	    i = search_next (&search, wrapped ? lastLine : topline + searchctx - 1, -1,
+			     hideQuoted, fp, &last_pos, &lineInfo, &lastLine,
+			     &maxLine, has_types | (flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP)),
+			     &QuoteList, &q_level, &force_redraw);
 
 	    if (i >= 0)
 	      topline = i;
+	    else if (i == -2)
+	      mutt_error _("Search interrupted.");
 	    else if (wrapped || !option (OPTWRAPSEARCH))
 	      mutt_error _("Not found.");
 	    else
@@ -2082,7 +2486,7 @@ search_next:
 	    }
 	  }
 
-	  if (lineInfo[topline].search_cnt > 0)
+	  if (i >= 0)
 	  {
 	    SearchFlag = M_SEARCH;
 	    /* give some context for search results */
@@ -2130,73 +2534,38 @@ search_next:
 	  SearchBack = 1;
 
 	if (SearchCompiled)
-	{
 	  regfree (&SearchRE);
-	  for (i = 0; i < lastLine; i++)
-	  {
-	    if (lineInfo[i].search)
-	      FREE (&(lineInfo[i].search));
-	    lineInfo[i].search_cnt = -1;
-	  }
-	}
 
 	if ((err = REGCOMP (&SearchRE, searchbuf, REG_NEWLINE | mutt_which_case (searchbuf))) != 0)
 	{
 	  regerror (err, &SearchRE, buffer, sizeof (buffer));
 	  mutt_error ("%s", buffer);
-	  for (i = 0; i < maxLine ; i++)
-	  {
-	    /* cleanup */
-	    if (lineInfo[i].search)
-	      FREE (&(lineInfo[i].search));
-	    lineInfo[i].search_cnt = -1;
-	  }
+	  search_free (&search);
 	  SearchFlag = 0;
 	  SearchCompiled = 0;
 	}
 	else
 	{
 	  SearchCompiled = 1;
-	  /* update the search pointers */
-	  i = 0;
-	  while (display_line (fp, &last_pos, &lineInfo, i, &lastLine, 
-				&maxLine, M_SEARCH | (flags & M_PAGER_NSKIP) | (flags & M_PAGER_NOWRAP),
-				&QuoteList, &q_level,
-				&force_redraw, &SearchRE) == 0)
-	    i++;
+	  search_init (&search, &SearchRE, searchbuf);
+	  i = search_next (&search, topline, SearchBack ? -1 : 1, hideQuoted,
+			   fp, &last_pos, &lineInfo, &lastLine, &maxLine,
+			   has_types | (flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP)),
+			   &QuoteList, &q_level, &force_redraw);
 
-	  if (!SearchBack)
+	  if (i == -2)
 	  {
-	    /* searching forward */
-	    for (i = topline; i < lastLine; i++)
-	    {
-	      if ((!hideQuoted || lineInfo[i].type != MT_COLOR_QUOTED) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
-
-	    if (i < lastLine) topline = i;
-	  }
-	  else
-	  {
-	    /* searching backward */
-	    for (i = topline; i >= 0; i--)
-	    {
-	      if ((!hideQuoted || lineInfo[i].type != MT_COLOR_QUOTED) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
-
-	    if (i >= 0) topline = i;
+	    SearchFlag = M_SEARCH;
+	    mutt_error _("Search interrupted.");
 	  }
-
-	  if (lineInfo[topline].search_cnt == 0)
+	  else if (i < 0)
 	  {
 	    SearchFlag = 0;
 	    mutt_error _("Not found.");
 	  }
 	  else
 	  {
+	    topline = i;
 	    SearchFlag = M_SEARCH;
 	    /* give some context for search results */
 	    if (SearchContext > 0 && SearchContext < LINES - 2 - option (OPTHELP) ? 1 : 0)
@@ -2464,18 +2833,13 @@ search_next:
 	    lineInfo[i].offset = 0;
 	    lineInfo[i].type = -1;
 	    lineInfo[i].continuation = 0;
-	    lineInfo[i].chunks = 0;
-	    lineInfo[i].search_cnt = -1;
 	    lineInfo[i].quote = NULL;
-
-	    safe_realloc (&(lineInfo[i].syntax), sizeof (struct syntax_t));
-	    if (SearchCompiled && lineInfo[i].search)
-		FREE (&(lineInfo[i].search));
 	  }
 
 	  if (SearchCompiled)
 	  {
 	    regfree (&SearchRE);
+	    search_free (&search);
 	    SearchCompiled = 0;
 	  }
 	  SearchFlag = 0;
@@ -2483,6 +2847,7 @@ search_next:
 	  /* try to keep the old position */
 	  topline = 0;
 	  lastLine = 0;
+	  indexed = 0;
 	  while (j > 0 && display_line (fp, &last_pos, &lineInfo, topline, 
 					&lastLine, &maxLine,
 					(has_types ? M_TYPES : 0) | (flags & M_PAGER_NOWRAP),
@@ -2798,17 +3163,19 @@ search_next:
     
   cleanup_quote (&QuoteList);
   
-  for (i = 0; i < maxLine ; i++)
-  {
-    FREE (&(lineInfo[i].syntax));
-    if (SearchCompiled && lineInfo[i].search)
-      FREE (&(lineInfo[i].search));
-  }
+  /* a pager this one was called from works them out anew */
+  FREE (&Chunks.chunk);
+  Chunks.line = -1;
+  Chunks.count = Chunks.max = 0;
+  FREE (&Matches.chunk);
+  Matches.line = -1;
+  Matches.count = Matches.max = 0;
   if (SearchCompiled)
   {
     regfree (&SearchRE);
     SearchCompiled = 0;
   }
+  search_free (&search);
   FREE (&lineInfo);
   if (index)
     mutt_menuDestroy(&index);
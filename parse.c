@@ -741,24 +741,82 @@ TimeZones[] =
   { "wst",   8,  0, 0 }, /* Western Australia */
 };
 
-/* parses a date string in RFC822 format:
- *
- * Date: [ weekday , ] day-of-month month year hour:minute:second timezone
- *
- * This routine assumes that `h' has been initialized to 0.  the `timezone'
- * field is optional, defaulting to +0000 if missing.
- */
-time_t mutt_parse_date (const char *s, HEADER *h)
+/* parse_date_digits: read 1 to max digits at s into *n. Returns where
+ *   they end, or NULL if s doesn't start with a digit. */
+static const char *parse_date_digits (const char *s, int max, int *n)
+{
+  int i;
+
+  if (!isdigit ((unsigned char) *s))
+    return NULL;
+  for (*n = 0, i = 0; i < max && isdigit ((unsigned char) *s); i++, s++)
+    *n = *n * 10 + (*s - '0');
+
+  return s;
+}
+
+/* parse_date_fast: the strict path of mutt_parse_date() for the form
+ *   nearly all mail uses, "[Ddd, ] d Mmm yyyy hh:mm[:ss] [+-]hhmm".
+ *   Returns 0 if s has it, -1 to leave s to parse_date_lenient(). */
+static int parse_date_fast (const char *s, struct tm *tm, int *zhours,
+			    int *zminutes, int *zoccident)
+{
+  int n;
+
+  if (isalpha ((unsigned char) s[0]) && isalpha ((unsigned char) s[1]) &&
+      isalpha ((unsigned char) s[2]) && s[3] == ',')
+    s = skip_email_wsp (s + 4);
+
+  /* day of the month */
+  if (!(s = parse_date_digits (s, 2, &tm->tm_mday)) || tm->tm_mday > 31 ||
+      !is_email_wsp (*s))
+    return -1;
+  s = skip_email_wsp (s);
+
+  /* month of the year */
+  if ((tm->tm_mon = mutt_check_month (s)) < 0 || !is_email_wsp (s[3]))
+    return -1;
+  s = skip_email_wsp (s + 3);
+
+  /* year */
+  if (!(s = parse_date_digits (s, 4, &n)) || n < 1900 || !is_email_wsp (*s))
+    return -1;
+  tm->tm_year = n - 1900;
+  s = skip_email_wsp (s);
+
+  /* time of day */
+  if (!(s = parse_date_digits (s, 2, &tm->tm_hour)) || *s != ':' ||
+      !(s = parse_date_digits (s + 1, 2, &tm->tm_min)))
+    return -1;
+  if (*s == ':' && !(s = parse_date_digits (s + 1, 2, &tm->tm_sec)))
+    return -1;
+  if (*s && !is_email_wsp (*s))
+    return -1;
+  s = skip_email_wsp (s);
+
+  /* numeric timezone, if any */
+  if (!*s)
+    return 0;
+  if ((*s != '+' && *s != '-') || !isdigit ((unsigned char) s[1]) ||
+      !isdigit ((unsigned char) s[2]) || !isdigit ((unsigned char) s[3]) ||
+      !isdigit ((unsigned char) s[4]))
+    return -1;
+  *zhours = (s[1] - '0') * 10 + (s[2] - '0');
+  *zminutes = (s[3] - '0') * 10 + (s[4] - '0');
+  *zoccident = *s == '-';
+
+  return 0;
+}
+
+/* parse_date_lenient: take apart whatever parse_date_fast() wouldn't.
+ *   Returns 0 if something like a date could be made of s, -1 otherwise. */
+static int parse_date_lenient (const char *s, struct tm *tm, int *zhours,
+			       int *zminutes, int *zoccident)
 {
   int count = 0;
   char *t;
   int hour, min, sec;
-  struct tm tm;
   int i;
-  int tz_offset = 0;
-  int zhours = 0;
-  int zminutes = 0;
-  int zoccident = 0;
   const char *ptz;
   char tzstr[SHORT_STRING];
   char scratch[SHORT_STRING];
@@ -776,32 +834,30 @@ time_t mutt_parse_date (const char *s, HEADER *h)
     t = scratch;
   t = skip_email_wsp(t);
 
-  memset (&tm, 0, sizeof (tm));
-
   while ((t = strtok (t, " \t")) != NULL)
   {
     switch (count)
     {
       case 0: /* day of the month */
-	if (mutt_atoi (t, &tm.tm_mday) < 0 || tm.tm_mday < 0)
+	if (mutt_atoi (t, &tm->tm_mday) < 0 || tm->tm_mday < 0)
 	  return (-1);
-	if (tm.tm_mday > 31)
+	if (tm->tm_mday > 31)
 	  return (-1);
 	break;
 
       case 1: /* month of the year */
 	if ((i = mutt_check_month (t)) < 0)
 	  return (-1);
-	tm.tm_mon = i;
+	tm->tm_mon = i;
 	break;
 
       case 2: /* year */
-	if (mutt_atoi (t, &tm.tm_year) < 0 || tm.tm_year < 0)
+	if (mutt_atoi (t, &tm->tm_year) < 0 || tm->tm_year < 0)
 	  return (-1);
-        if (tm.tm_year < 50)
-	  tm.tm_year += 100;
-        else if (tm.tm_year >= 1900)
-	  tm.tm_year -= 1900;
+        if (tm->tm_year < 50)
+	  tm->tm_year += 100;
+        else if (tm->tm_year >= 1900)
+	  tm->tm_year -= 1900;
 	break;
 
       case 3: /* time of day */
@@ -814,9 +870,9 @@ time_t mutt_parse_date (const char *s, HEADER *h)
 	  dprint(1, (debugfile, "parse_date: could not process time format: %s\n", t));
 	  return(-1);
 	}
-	tm.tm_hour = hour;
-	tm.tm_min = min;
-	tm.tm_sec = sec;
+	tm->tm_hour = hour;
+	tm->tm_min = min;
+	tm->tm_sec = sec;
 	break;
 
       case 4: /* timezone */
@@ -831,11 +887,11 @@ time_t mutt_parse_date (const char *s, HEADER *h)
 	      && isdigit ((unsigned char) ptz[1]) && isdigit ((unsigned char) ptz[2])
 	      && isdigit ((unsigned char) ptz[3]) && isdigit ((unsigned char) ptz[4]))
 	  {
-	    zhours = (ptz[1] - '0') * 10 + (ptz[2] - '0');
-	    zminutes = (ptz[3] - '0') * 10 + (ptz[4] - '0');
+	    *zhours = (ptz[1] - '0') * 10 + (ptz[2] - '0');
+	    *zminutes = (ptz[3] - '0') * 10 + (ptz[4] - '0');
 
 	    if (ptz[0] == '-')
-	      zoccident = 1;
+	      *zoccident = 1;
 	  }
 	}
 	else
@@ -850,9 +906,9 @@ time_t mutt_parse_date (const char *s, HEADER *h)
 
 	  if (tz)
 	  {
-	    zhours = tz->zhours;
-	    zminutes = tz->zminutes;
-	    zoccident = tz->zoccident;
+	    *zhours = tz->zhours;
+	    *zminutes = tz->zminutes;
+	    *zoccident = tz->zoccident;
 	  }
 
 	  /* ad hoc support for the European MET (now officially CET) TZ */
@@ -861,13 +917,10 @@ time_t mutt_parse_date (const char *s, HEADER *h)
 	    if ((t = strtok (NULL, " \t")) != NULL)
 	    {
 	      if (!ascii_strcasecmp (t, "DST"))
-		zhours++;
+		(*zhours)++;
 	    }
 	  }
 	}
-	tz_offset = zhours * 3600 + zminutes * 60;
-	if (!zoccident)
-	  tz_offset = -tz_offset;
 	break;
     }
     count++;
@@ -880,6 +933,38 @@ time_t mutt_parse_date (const char *s, HEADER *h)
     return (-1);
   }
 
+  return 0;
+}
+
+/* parses a date string in RFC822 format:
+ *
+ * Date: [ weekday , ] day-of-month month year hour:minute:second timezone
+ *
+ * This routine assumes that `h' has been initialized to 0.  the `timezone'
+ * field is optional, defaulting to +0000 if missing.
+ */
+time_t mutt_parse_date (const char *s, HEADER *h)
+{
+  struct tm tm;
+  int tz_offset;
+  int zhours = 0;
+  int zminutes = 0;
+  int zoccident = 0;
+
+  memset (&tm, 0, sizeof (tm));
+
+  if (parse_date_fast (s, &tm, &zhours, &zminutes, &zoccident) < 0)
+  {
+    memset (&tm, 0, sizeof (tm));
+    zhours = zminutes = zoccident = 0;
+    if (parse_date_lenient (s, &tm, &zhours, &zminutes, &zoccident) < 0)
+      return (-1);
+  }
+
+  tz_offset = zhours * 3600 + zminutes * 60;
+  if (!zoccident)
+    tz_offset = -tz_offset;
+
   if (h)
   {
     h->zhours = zhours;
@@ -1305,133 +1390,109 @@ int mutt_parse_rfc822_line (ENVELOPE *e, HEADER *hdr, char *line, char *p, short
 }
   
   
-/* mutt_read_rfc822_header() -- parses a RFC822 header
- *
- * Args:
- *
- * f		stream to read from
- *
- * hdr		header structure of current message (optional).
- * 
- * user_hdrs	If set, store user headers.  Used for recall-message and
- * 		postpone modes.
- * 
- * weed		If this parameter is set and the user has activated the
- * 		$weed option, honor the header weed list for user headers.
- * 	        Used for recall-message.
- * 
- * Returns:     newly allocated envelope structure.  You should free it by
- *              mutt_free_envelope() when envelope stay unneeded.
- */
-ENVELOPE *mutt_read_rfc822_header (FILE *f, HEADER *hdr, short user_hdrs,
-				   short weed)
+/* set the defaults from RFC1521 for a message being parsed */
+static void rfc822_header_init (HEADER *hdr)
 {
-  ENVELOPE *e = mutt_new_envelope();
-  LIST *last = NULL;
-  char *line = safe_malloc (LONG_STRING);
-  char *p;
-  LOFF_T loc;
-  size_t linelen = LONG_STRING;
-  char buf[LONG_STRING+1];
-
-  if (hdr)
+  if (hdr && hdr->content == NULL)
   {
-    if (hdr->content == NULL)
-    {
-      hdr->content = mutt_new_body ();
+    hdr->content = mutt_new_body ();
 
-      /* set the defaults from RFC1521 */
-      hdr->content->type        = TYPETEXT;
-      hdr->content->subtype     = safe_strdup ("plain");
-      hdr->content->encoding    = ENC7BIT;
-      hdr->content->length      = -1;
+    /* set the defaults from RFC1521 */
+    hdr->content->type        = TYPETEXT;
+    hdr->content->subtype     = safe_strdup ("plain");
+    hdr->content->encoding    = ENC7BIT;
+    hdr->content->length      = -1;
 
-      /* RFC 2183 says this is arbitrary */
-      hdr->content->disposition = DISPINLINE;
-    }
+    /* RFC 2183 says this is arbitrary */
+    hdr->content->disposition = DISPINLINE;
   }
+}
 
-  while ((loc = ftello (f)),
-	  *(line = mutt_read_rfc822_line (f, line, &linelen)) != 0)
-  {
-    if ((p = strpbrk (line, ": \t")) == NULL || *p != ':')
-    {
-      char return_path[LONG_STRING];
-      time_t t;
+/* rfc822_header_line: handle one unfolded header line of a message.
+ *   Returns 1 if line isn't a header field and ends the header, 0 otherwise.
+ *   line is modified. */
+static int rfc822_header_line (ENVELOPE *e, HEADER *hdr, char *line,
+                               short user_hdrs, short weed, LIST **lastp)
+{
+  char *p;
+  char buf[LONG_STRING+1];
 
-      /* some bogus MTAs will quote the original "From " line */
-      if (mutt_strncmp (">From ", line, 6) == 0)
-	continue; /* just ignore */
-      else if (is_from (line, return_path, sizeof (return_path), &t))
-      {
-	/* MH sometimes has the From_ line in the middle of the header! */
-	if (hdr && !hdr->received)
-	  hdr->received = t - mutt_local_tz (t);
-	continue;
-      }
+  if ((p = strpbrk (line, ": \t")) == NULL || *p != ':')
+  {
+    char return_path[LONG_STRING];
+    time_t t;
 
-      fseeko (f, loc, 0);
-      break; /* end of header */
+    /* some bogus MTAs will quote the original "From " line */
+    if (mutt_strncmp (">From ", line, 6) == 0)
+      return 0; /* just ignore */
+    else if (is_from (line, return_path, sizeof (return_path), &t))
+    {
+      /* MH sometimes has the From_ line in the middle of the header! */
+      if (hdr && !hdr->received)
+	hdr->received = t - mutt_local_tz (t);
+      return 0;
     }
 
-    *buf = '\0';
-
-    if (mutt_match_spam_list(line, SpamList, buf, sizeof(buf)))
-    {
-      if (!mutt_match_rx_list(line, NoSpamList))
-      {
+    return 1; /* end of header */
+  }
 
-	/* if spam tag already exists, figure out how to amend it */
-	if (e->spam && *buf)
-	{
-	  /* If SpamSep defined, append with separator */
-	  if (SpamSep)
-	  {
-	    mutt_buffer_addstr(e->spam, SpamSep);
-	    mutt_buffer_addstr(e->spam, buf);
-	  }
+  *buf = '\0';
 
-	  /* else overwrite */
-	  else
-	  {
-	    e->spam->dptr = e->spam->data;
-	    *e->spam->dptr = '\0';
-	    mutt_buffer_addstr(e->spam, buf);
-	  }
-	}
+  if (mutt_match_spam_list(line, SpamList, buf, sizeof(buf)))
+  {
+    if (!mutt_match_rx_list(line, NoSpamList))
+    {
 
-	/* spam tag is new, and match expr is non-empty; copy */
-	else if (!e->spam && *buf)
+      /* if spam tag already exists, figure out how to amend it */
+      if (e->spam && *buf)
+      {
+	/* If SpamSep defined, append with separator */
+	if (SpamSep)
 	{
-	  e->spam = mutt_buffer_from (buf);
+	  mutt_buffer_addstr(e->spam, SpamSep);
+	  mutt_buffer_addstr(e->spam, buf);
 	}
 
-	/* match expr is empty; plug in null string if no existing tag */
-	else if (!e->spam)
+	/* else overwrite */
+	else
 	{
-	  e->spam = mutt_buffer_from("");
+	  e->spam->dptr = e->spam->data;
+	  *e->spam->dptr = '\0';
+	  mutt_buffer_addstr(e->spam, buf);
 	}
+      }
 
-	if (e->spam && e->spam->data)
-          dprint(5, (debugfile, "p822: spam = %s\n", e->spam->data));
+      /* spam tag is new, and match expr is non-empty; copy */
+      else if (!e->spam && *buf)
+      {
+	e->spam = mutt_buffer_from (buf);
       }
-    }
 
-    *p = 0;
-    p = skip_email_wsp(p + 1);
-    if (!*p)
-      continue; /* skip empty header fields */
+      /* match expr is empty; plug in null string if no existing tag */
+      else if (!e->spam)
+      {
+	e->spam = mutt_buffer_from("");
+      }
 
-    mutt_parse_rfc822_line (e, hdr, line, p, user_hdrs, weed, 1, &last);
+      if (e->spam && e->spam->data)
+	dprint(5, (debugfile, "p822: spam = %s\n", e->spam->data));
+    }
   }
 
-  FREE (&line);
+  *p = 0;
+  p = skip_email_wsp(p + 1);
+  if (!*p)
+    return 0; /* skip empty header fields */
+
+  mutt_parse_rfc822_line (e, hdr, line, p, user_hdrs, weed, 1, lastp);
+  return 0;
+}
 
+/* decode what has been read of a message header once it is complete */
+static void rfc822_header_done (ENVELOPE *e, HEADER *hdr)
+{
   if (hdr)
   {
-    hdr->content->hdr_offset = hdr->offset;
-    hdr->content->offset = ftello (f);
-
     /* do RFC2047 decoding */
     rfc2047_decode_adrlist (e->from);
     rfc2047_decode_adrlist (e->to);
@@ -1462,6 +1523,205 @@ ENVELOPE *mutt_read_rfc822_header (FILE *f, HEADER *hdr, short user_hdrs,
       hdr->date_sent = hdr->received;
     }
   }
+}
+
+/* mutt_read_rfc822_header() -- parses a RFC822 header
+ *
+ * Args:
+ *
+ * f		stream to read from
+ *
+ * hdr		header structure of current message (optional).
+ * 
+ * user_hdrs	If set, store user headers.  Used for recall-message and
+ * 		postpone modes.
+ * 
+ * weed		If this parameter is set and the user has activated the
+ * 		$weed option, honor the header weed list for user headers.
+ * 	        Used for recall-message.
+ * 
+ * Returns:     newly allocated envelope structure.  You should free it by
+ *              mutt_free_envelope() when envelope stay unneeded.
+ */
+ENVELOPE *mutt_read_rfc822_header (FILE *f, HEADER *hdr, short user_hdrs,
+				   short weed)
+{
+  ENVELOPE *e = mutt_new_envelope();
+  LIST *last = NULL;
+  char *line = safe_malloc (LONG_STRING);
+  LOFF_T loc;
+  size_t linelen = LONG_STRING;
+
+  rfc822_header_init (hdr);
+
+  while ((loc = ftello (f)),
+	  *(line = mutt_read_rfc822_line (f, line, &linelen)) != 0)
+  {
+    if (rfc822_header_line (e, hdr, line, user_hdrs, weed, &last))
+    {
+      fseeko (f, loc, 0);
+      break; /* end of header */
+    }
+  }
+
+  FREE (&line);
+
+  if (hdr)
+  {
+    hdr->content->hdr_offset = hdr->offset;
+    hdr->content->offset = ftello (f);
+  }
+  rfc822_header_done (e, hdr);
+
+  return (e);
+}
+
+/* The header fields mutt_parse_rfc822_line() knows about, found through
+ * a perfect hash on their length and first, middle and last characters.
+ * Everything else is skipped by mutt_read_rfc822_header_span() without
+ * being unfolded unless user headers or spam tags are wanted. */
+#define HEADER_HASH_SIZE 64
+#define HEADER_HASH(s,l) (((l) * 23 + ascii_tolower ((s)[0]) * 17 + \
+                           ascii_tolower ((s)[(l) - 1]) * 6 + \
+                           ascii_tolower ((s)[(l) / 2])) & (HEADER_HASH_SIZE - 1))
+
+static const char *HeaderFields[] =
+{
+  "apparently-from", "apparently-to", "bcc", "cc", "content-description",
+  "content-disposition", "content-length", "content-transfer-encoding",
+  "content-type", "date", "expires", "from", "in-reply-to", "lines",
+  "list-post", "mail-followup-to", "mail-reply-to", "message-id",
+  "mime-version", "received", "references", "reply-to", "return-path",
+  "sender", "status", "subject", "supercedes", "supersedes", "to",
+  "x-label", "x-status", NULL
+};
+
+static const char *HeaderHash[HEADER_HASH_SIZE];
+
+static int header_field_known (const char *name, size_t len)
+{
+  const char *known;
+  int i;
+
+  if (!HeaderHash[HEADER_HASH ("to", 2)])
+  {
+    for (i = 0; HeaderFields[i]; i++)
+    {
+      size_t l = strlen (HeaderFields[i]);
+      HeaderHash[HEADER_HASH (HeaderFields[i], l)] = HeaderFields[i];
+    }
+  }
+
+  if (!len)
+    return 0;
+  known = HeaderHash[HEADER_HASH (name, len)];
+  return known && strlen (known) == len && !ascii_strncasecmp (known, name, len);
+}
+
+/* unfold_span: unfold the header field starting at s in place the way
+ *   mutt_read_rfc822_line() does. end is where the span ends. Returns
+ *   where the next field starts; the field is NUL-terminated where its
+ *   final newline was, or at end, which must then be writable. */
+static char *unfold_span (char *s, char *end)
+{
+  char *d = s, *nl;
+
+  FOREVER
+  {
+    if (!(nl = memchr (s, '\n', end - s)))
+    {
+      /* the last line of the span needn't be terminated */
+      memmove (d, s, end - s);
+      d[end - s] = 0;
+      return end;
+    }
+
+    memmove (d, s, nl - s);
+    d += nl - s;
+    /* remove trailing space. The first line begins with a non-space. */
+    while (ISSPACE (d[-1]))
+      d--;
+    s = nl + 1;
+
+    /* check to see if the next line is a continuation line */
+    if (s == end || (*s != ' ' && *s != '\t'))
+    {
+      *d = 0;
+      return s;
+    }
+
+    /* eat tabs and spaces from the beginning of the continuation line */
+    while (s < end && (*s == ' ' || *s == '\t'))
+      s++;
+    *d++ = ' ';
+  }
+  /* not reached */
+}
+
+/* skip_span: return where the header field starting at s ends. */
+static char *skip_span (char *s, char *end)
+{
+  char *nl;
+
+  while ((nl = memchr (s, '\n', end - s)))
+  {
+    s = nl + 1;
+    if (s == end || (*s != ' ' && *s != '\t'))
+      return s;
+  }
+
+  return end;
+}
+
+/* mutt_read_rfc822_header_span() -- parses a RFC822 header held in memory
+ *
+ * Like mutt_read_rfc822_header(), but reads from the len bytes at buf
+ * instead of a stream, and leaves alone header fields it won't keep.
+ * Those it does are unfolded in place, so buf is modified, and buf[len]
+ * must be writable if the span may end in the middle of a header line.
+ * The body of the message is taken to start at hdr->offset plus however
+ * much of buf the header takes up.
+ */
+ENVELOPE *mutt_read_rfc822_header_span (char *buf, size_t len, HEADER *hdr,
+					short user_hdrs, short weed)
+{
+  ENVELOPE *e = mutt_new_envelope();
+  LIST *last = NULL;
+  char *s = buf, *end = buf + len, *p, *next;
+
+  rfc822_header_init (hdr);
+
+  while (s < end && !ISSPACE (*s))
+  {
+    /* the name of a field is what comes before the colon on its first line.
+     * A line without one is no header field, but may be a From_ line. */
+    for (p = s; p < end && *p != '\n' && *p != ':' && *p != ' ' && *p != '\t'; p++)
+      ;
+    if (p < end && *p == ':' && !user_hdrs && !SpamList &&
+	!header_field_known (s, p - s))
+    {
+      s = skip_span (s, end);
+      continue;
+    }
+
+    next = unfold_span (s, end);
+    if (rfc822_header_line (e, hdr, s, user_hdrs, weed, &last))
+      break; /* end of header */
+    s = next;
+  }
+
+  /* the blank line ending the header belongs to it */
+  if (s < end && ISSPACE (*s) && (p = memchr (s, '\n', end - s)))
+    s = p + 1;
+  else if (s < end && ISSPACE (*s))
+    s = end;
+
+  if (hdr)
+  {
+    hdr->content->hdr_offset = hdr->offset;
+    hdr->content->offset = hdr->offset + (s - buf);
+  }
+  rfc822_header_done (e, hdr);
 
   return (e);
 }
@@ -36,6 +36,7 @@
 #include "mutt_crypt.h"
 #include "mutt_curses.h"
 #include "group.h"
+#include "searchidx.h"
 
 #ifdef USE_IMAP
 #include "mx.h"
@@ -150,13 +151,22 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
   struct stat st;
   FILE *fp = NULL;
   long lng = 0;
+  LOFF_T hdrlen = 0;
   int match = 0;
   HEADER *h = ctx->hdrs[msgno];
   char *buf;
   size_t blen;
+  sidx_builder_t *idx;
+
+  if (mutt_sidx_excludes (ctx, h, pat))
+    return (0);
 
   if ((msg = mx_open_message (ctx, msgno)) != NULL)
   {
+    /* messages not in the search index yet are read in full, so that
+     * the next search can skip them */
+    idx = mutt_sidx_begin (ctx, h);
+
     if (option (OPTTHOROUGHSRC))
     {
       /* decode the header / body */
@@ -167,19 +177,27 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
       if ((s.fpout = safe_fopen (tempfile, "w+")) == NULL)
       {
 	mutt_perror (tempfile);
+	mutt_sidx_abort (&idx);
 	return (0);
       }
 
-      if (pat->op != M_BODY)
+      if (pat->op != M_BODY || idx)
 	mutt_copy_header (msg->fp, h, s.fpout, CH_FROM | CH_DECODE, NULL);
+      hdrlen = ftello (s.fpout);
 
-      if (pat->op != M_HEADER)
+      if (pat->op != M_HEADER || idx)
       {
 	mutt_parse_mime_message (ctx, h);
 
-	if (WithCrypto && (h->security & ENCRYPT)
-            && !crypt_valid_passphrase(h->security))
+	if (WithCrypto && (h->security & ENCRYPT) && pat->op == M_HEADER)
+	{
+	  /* don't ask for a passphrase just to index the body */
+	  mutt_sidx_abort (&idx);
+	}
+	else if (WithCrypto && (h->security & ENCRYPT)
+		 && !crypt_valid_passphrase(h->security))
 	{
+	  mutt_sidx_abort (&idx);
 	  mx_close_message (&msg);
 	  if (s.fpout)
 	  {
@@ -188,9 +206,15 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
 	  }
 	  return (0);
 	}
+	else
+	{
+	  /* decrypted text must never be written to $search_index */
+	  if (WithCrypto && (h->security & ENCRYPT))
+	    mutt_sidx_abort (&idx);
 
-	fseeko (msg->fp, h->offset, 0);
-	mutt_body_handler (h->content, &s);
+	  fseeko (msg->fp, h->offset, 0);
+	  mutt_body_handler (h->content, &s);
+	}
       }
 
       fp = s.fpout;
@@ -198,11 +222,35 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
       fseek (fp, 0, 0);
       fstat (fileno (fp), &st);
       lng = (long) st.st_size;
+
+      if (idx)
+      {
+	if (mutt_sidx_add_file (idx, SIDX_HEADER, fp, hdrlen) < 0
+	    || mutt_sidx_add_file (idx, SIDX_BODY, fp, lng - hdrlen) < 0)
+	  mutt_sidx_abort (&idx);
+	fseek (fp, 0, 0);
+      }
+
+      if (pat->op == M_HEADER)
+	lng = (long) hdrlen;
+      else if (pat->op == M_BODY)
+      {
+	fseeko (fp, hdrlen, 0);
+	lng -= (long) hdrlen;
+      }
     }
     else
     {
       /* raw header / body */
       fp = msg->fp;
+      if (idx)
+      {
+	fseeko (fp, h->offset, 0);
+	if (mutt_sidx_add_file (idx, SIDX_HEADER, fp,
+				h->content->offset - h->offset) < 0
+	    || mutt_sidx_add_file (idx, SIDX_BODY, fp, h->content->length) < 0)
+	  mutt_sidx_abort (&idx);
+      }
       if (pat->op != M_BODY)
       {
 	fseeko (fp, h->offset, 0);
@@ -246,6 +294,9 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
       safe_fclose (&fp);
       unlink (tempfile);
     }
+
+    if (idx)
+      mutt_sidx_commit (ctx, h, &idx);
   }
 
   return match;
@@ -278,10 +329,11 @@ static int eat_regexp (pattern_t *pat, BUFFER *s, BUFFER *err)
     pat->stringmatch = 1;
 #endif
 
+  pat->ign_case = mutt_which_case (buf.data) == REG_ICASE;
+
   if (pat->stringmatch)
   {
     pat->p.str = safe_strdup (buf.data);
-    pat->ign_case = mutt_which_case (buf.data) == REG_ICASE;
     FREE (&buf.data);
   }
   else if (pat->groupmatch)
@@ -301,7 +353,11 @@ static int eat_regexp (pattern_t *pat, BUFFER *s, BUFFER *err)
       FREE (&pat->p.rx);
       return (-1);
     }
-    FREE (&buf.data);
+    /* plain strings can be looked up in the search index */
+    if (!strpbrk (buf.data, "\\|[](){}.*+?^$"))
+      pat->literal = buf.data;
+    else
+      FREE (&buf.data);
   }
 
   return 0;
@@ -768,6 +824,7 @@ void mutt_pattern_free (pattern_t **pat)
       FREE (&tmp->p.rx);
     }
 
+    FREE (&tmp->literal);
     if (tmp->child)
       mutt_pattern_free (&tmp->child);
     FREE (&tmp);
@@ -836,7 +836,7 @@ pgp_key_t pgp_getkeybyaddr (ADDRESS * a, short abilities, pgp_ring_t keyring,
 
   if (! oppenc_mode )
     mutt_message (_("Looking for keys matching \"%s\"..."), a->mailbox);
-  keys = pgp_get_candidates (keyring, hints);
+  keys = pgp_get_candidates_by_addr (keyring, a, hints);
 
   mutt_free_list (&hints);
 
@@ -40,7 +40,37 @@
 static unsigned char *pbuf = NULL;
 static size_t plen = 0;
 
-static int read_material (size_t material, size_t * used, FILE * fp)
+/* Packets are read either from a stream or from a key ring in memory. */
+struct packet_source
+{
+  FILE *fp;
+  const unsigned char *data;
+  size_t size;
+  size_t off;
+};
+
+static int read_bytes (struct packet_source *src, unsigned char *buf, size_t n)
+{
+  if (src->fp)
+  {
+    if (fread (buf, 1, n, src->fp) < n)
+    {
+      if (!feof (src->fp))
+	perror ("fread");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (n > src->size - src->off)
+    return -1;
+  memcpy (buf, src->data + src->off, n);
+  src->off += n;
+  return 0;
+}
+
+static int read_material (size_t material, size_t * used,
+			  struct packet_source *src)
 {
   if (*used + material >= plen)
   {
@@ -58,17 +88,14 @@ static int read_material (size_t material, size_t * used, FILE * fp)
     pbuf = p;
   }
 
-  if (fread (pbuf + *used, 1, material, fp) < material)
-  {
-    perror ("fread");
+  if (read_bytes (src, pbuf + *used, material) == -1)
     return -1;
-  }
 
   *used += material;
   return 0;
 }
 
-unsigned char *pgp_read_packet (FILE * fp, size_t * len)
+static unsigned char *read_packet (struct packet_source *src, size_t * len)
 {
   size_t used = 0;
   LOFF_T startpos;
@@ -76,7 +103,7 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
   unsigned char b;
   size_t material;
 
-  startpos = ftello (fp);
+  startpos = src->fp ? ftello (src->fp) : src->off;
 
   if (!plen)
   {
@@ -84,12 +111,8 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
     pbuf = safe_malloc (plen);
   }
 
-  if (fread (&ctb, 1, 1, fp) < 1)
-  {
-    if (!feof (fp))
-      perror ("fread");
+  if (read_bytes (src, &ctb, 1) == -1)
     goto bail;
-  }
 
   if (!(ctb & 0x80))
   {
@@ -104,11 +127,8 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
 
     do
     {
-      if (fread (&b, 1, 1, fp) < 1)
-      {
-	perror ("fread");
+      if (read_bytes (src, &b, 1) == -1)
 	goto bail;
-      }
 
       if (b < 192)
       {
@@ -119,11 +139,8 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
       else if (192 <= b && b <= 223)
       {
 	material = (b - 192) * 256;
-	if (fread (&b, 1, 1, fp) < 1)
-	{
-	  perror ("fread");
+	if (read_bytes (src, &b, 1) == -1)
 	  goto bail;
-	}
 	material += b + 192;
 	partial = 0;
 	/* material -= 2; */
@@ -138,11 +155,8 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
 	/* b == 255 */
       {
 	unsigned char buf[4];
-	if (fread (buf, 4, 1, fp) < 1)
-	{
-	  perror ("fread");
+	if (read_bytes (src, buf, 4) == -1)
 	  goto bail;
-	}
 	/*assert( sizeof(material) >= 4 ); */
 	material = buf[0] << 24;
 	material |= buf[1] << 16;
@@ -152,7 +166,7 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
 	/* material -= 5; */
       }
 
-      if (read_material (material, &used, fp) == -1)
+      if (read_material (material, &used, src) == -1)
 	goto bail;
 
     }
@@ -169,11 +183,8 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
     {
       case 0:
       {
-	if (fread (&b, 1, 1, fp) < 1)
-	{
-	  perror ("fread");
+	if (read_bytes (src, &b, 1) == -1)
 	  goto bail;
-	}
 
 	material = b;
 	break;
@@ -193,11 +204,8 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
 
 	for (i = 0; i < bytes; i++)
 	{
-	  if (fread (&b, 1, 1, fp) < 1)
-	  {
-	    perror ("fread");
+	  if (read_bytes (src, &b, 1) == -1)
 	    goto bail;
-	  }
 
 	  material = (material << 8) + b;
 	}
@@ -208,7 +216,7 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
       goto bail;
     }
 
-    if (read_material (material, &used, fp) == -1)
+    if (read_material (material, &used, src) == -1)
       goto bail;
   }
 
@@ -219,10 +227,41 @@ unsigned char *pgp_read_packet (FILE * fp, size_t * len)
 
 bail:
 
-  fseeko (fp, startpos, SEEK_SET);
+  if (src->fp)
+    fseeko (src->fp, startpos, SEEK_SET);
+  else
+    src->off = startpos;
   return NULL;
 }
 
+unsigned char *pgp_read_packet (FILE * fp, size_t * len)
+{
+  struct packet_source src;
+
+  memset (&src, 0, sizeof (src));
+  src.fp = fp;
+  return read_packet (&src, len);
+}
+
+/* Read the packet at *OFF in the SIZE bytes at DATA, and advance *OFF
+   past it.  *OFF is left alone if there is no complete packet. */
+unsigned char *pgp_read_packet_mem (const unsigned char *data, size_t size,
+				    size_t *off, size_t * len)
+{
+  struct packet_source src;
+  unsigned char *p;
+
+  memset (&src, 0, sizeof (src));
+  src.data = data;
+  src.size = size;
+  src.off = *off;
+  if (src.off > size)
+    return NULL;
+  if ((p = read_packet (&src, len)))
+    *off = src.off;
+  return p;
+}
+
 void pgp_release_packet (void)
 {
   plen = 0;
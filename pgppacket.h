@@ -47,6 +47,8 @@ enum packet_tags
 };
 
 unsigned char *pgp_read_packet (FILE * fp, size_t * len);
+unsigned char *pgp_read_packet_mem (const unsigned char *data, size_t size,
+				    size_t *off, size_t * len);
 void pgp_release_packet (void);
 
 #endif
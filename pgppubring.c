@@ -43,6 +43,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_GETOPT_H
 # include <getopt.h>
 #endif
@@ -59,14 +66,6 @@ extern int optind;
 
 #define MD5_DIGEST_LENGTH  16
 
-#ifdef HAVE_FGETPOS
-#define FGETPOS(fp,pos) fgetpos((fp),&(pos))
-#define FSETPOS(fp,pos) fsetpos((fp),&(pos))
-#else
-#define FGETPOS(fp,pos) pos=ftello((fp));
-#define FSETPOS(fp,pos) fseeko((fp),(pos),SEEK_SET)
-#endif
-
 
 static short dump_signatures = 0;
 static short dump_fingerprints = 0;
@@ -355,11 +354,9 @@ static pgp_key_t pgp_parse_pgp3_key (unsigned char *buff, size_t l)
   else if (alg == 17 || alg == 16 || alg == 20)
     skip_bignum (buff, l, j, &j, 1);
 
+  /* always kept, hints may name the key by its fingerprint */
   pgp_make_pgp3_fingerprint (buff, j, digest);
-  if (dump_fingerprints)
-  {
-    p->fingerprint = binary_fingerprint_to_string (digest, SHA_DIGEST_LENGTH);
-  }
+  p->fingerprint = binary_fingerprint_to_string (digest, SHA_DIGEST_LENGTH);
   
   for (k = 0; k < 2; k++)
   {
@@ -593,21 +590,18 @@ static int pgp_parse_sig (unsigned char *buff, size_t l,
   }
 }
 
-/* parse one key block, including all subkeys. */
+/* parse one key block, including all subkeys, at *OFF in the key
+   ring, and advance *OFF to the next one. */
 
-static pgp_key_t pgp_parse_keyblock (FILE * fp)
+static pgp_key_t pgp_parse_keyblock (const unsigned char *ring, size_t size,
+				     size_t *off)
 {
   unsigned char *buff;
   unsigned char pt = 0;
   unsigned char last_pt;
   size_t l;
   short err = 0;
-
-#ifdef HAVE_FGETPOS
-  fpos_t pos;
-#else
-  LOFF_T pos;
-#endif
+  size_t pos;
 
   pgp_key_t root = NULL;
   pgp_key_t *last = &root;
@@ -616,9 +610,9 @@ static pgp_key_t pgp_parse_keyblock (FILE * fp)
   pgp_uid_t **addr = NULL;
   pgp_sig_t **lsig = NULL;
 
-  FGETPOS(fp,pos);
+  pos = *off;
   
-  while (!err && (buff = pgp_read_packet (fp, &l)) != NULL)
+  while (!err && (buff = pgp_read_packet_mem (ring, size, off, &l)) != NULL)
   {
     last_pt = pt;
     pt = buff[0] & 0x3f;
@@ -627,7 +621,7 @@ static pgp_key_t pgp_parse_keyblock (FILE * fp)
     
     if ((pt == PT_SECKEY || pt == PT_PUBKEY) && root)
     {
-      FSETPOS(fp, pos);
+      *off = pos;
       return root;
     }
     
@@ -727,7 +721,7 @@ static pgp_key_t pgp_parse_keyblock (FILE * fp)
       }
     }
 
-    FGETPOS(fp,pos);
+    pos = *off;
   }
 
   if (err)
@@ -752,52 +746,87 @@ static int pgpring_string_matches_hint (const char *s, const char *hints[], int
   return 0;
 }
 
-/* 
- * Go through the key ring file and look for keys with
- * matching IDs.
- */
+/* Return the key ID asked for by a hint of 8, 16 or 40 hex digits,
+   optionally prefixed by 0x, in ID and its length, or 0. */
 
-static void pgpring_find_candidates (char *ringfile, const char *hints[], int nhints)
+static size_t pgpring_hint_keyid (const char *hint, char *id)
 {
-  FILE *rfp;
-#ifdef HAVE_FGETPOS
-  fpos_t pos, keypos;
-#else
-  LOFF_T pos, keypos;
-#endif
+  size_t len;
 
-  unsigned char *buff = NULL;
-  unsigned char pt = 0;
-  size_t l = 0;
+  if (hint[0] == '0' && (hint[1] == 'x' || hint[1] == 'X'))
+    hint += 2;
 
-  short err = 0;
-  
-  if ((rfp = fopen (ringfile, "r")) == NULL)
-  {
-    char *error_buf;
-    size_t error_buf_len;
+  len = strlen (hint);
+  if ((len != 8 && len != 16 && len != 40)
+      || strspn (hint, "0123456789abcdefABCDEF") != len)
+    return 0;
 
-    error_buf_len = sizeof ("fopen: ") - 1 + strlen (ringfile) + 1;
-    error_buf = safe_malloc (error_buf_len);
-    snprintf (error_buf, error_buf_len, "fopen: %s", ringfile);
-    perror (error_buf);
-    FREE (&error_buf);
-    return;
+  strcpy (id, hint);
+  return len;
+}
+
+static int pgpring_key_matches_id (pgp_key_t k, const char *hints[], int nhints)
+{
+  char id[41];
+  size_t len;
+  int i;
+
+  if (!k || !k->keyid || strlen (k->keyid) != 16)
+    return 0;
+
+  for (i = 0; i < nhints; i++)
+  {
+    if (!(len = pgpring_hint_keyid (hints[i], id)))
+      continue;
+    if (len == 40)
+    {
+      if (k->fingerprint && !ascii_strcasecmp (k->fingerprint, id))
+	return 1;
+    }
+    else if (!ascii_strcasecmp (k->keyid + 16 - len, id))
+      return 1;
   }
 
-  FGETPOS(rfp,pos);
-  FGETPOS(rfp,keypos);
+  return 0;
+}
+
+/* 
+ * Dump the key block at BLOCK if one of its user IDs, key IDs or
+ * fingerprints matches the hints.  Returns -1 if the key block can't
+ * be parsed.
+ */
+
+static int pgpring_dump_block (const unsigned char *ring, size_t size,
+			       size_t block, const char *hints[], int nhints)
+{
+  unsigned char *buff;
+  unsigned char pt;
+  size_t off = block, l;
+  int match = 0, seen_key = 0;
+  pgp_key_t p;
 
-  while (!err && (buff = pgp_read_packet (rfp, &l)) != NULL)
+  while (!match && (buff = pgp_read_packet_mem (ring, size, &off, &l)) != NULL)
   {
     pt = buff[0] & 0x3f;
-    
+
     if (l < 1)
       continue;
-    
-    if ((pt == PT_SECKEY) || (pt == PT_PUBKEY))
+
+    if (pt == PT_SECKEY || pt == PT_PUBKEY)
+    {
+      if (seen_key)
+	break;
+      seen_key = 1;
+    }
+
+    if (pt == PT_SECKEY || pt == PT_PUBKEY ||
+	pt == PT_SUBKEY || pt == PT_SUBSECKEY)
     {
-      keypos = pos;
+      if (nhints && (p = pgp_parse_keyinfo (buff, l)))
+      {
+	match = pgpring_key_matches_id (p, hints, nhints);
+	pgp_free_key (&p);
+      }
     }
     else if (pt == PT_NAME)
     {
@@ -809,28 +838,603 @@ static void pgpring_find_candidates (char *ringfile, const char *hints[], int nh
       /* mutt_decode_utf8_string (tmp, chs); */
 
       if (pgpring_string_matches_hint (tmp, hints, nhints))
+	match = 1;
+
+      FREE (&tmp);
+    }
+  }
+
+  if (!match)
+    return 0;
+
+  off = block;
+
+  /* Not bailing out here would lead us into an endless loop. */
+
+  if ((p = pgp_parse_keyblock (ring, size, &off)) == NULL)
+    return -1;
+
+  pgpring_dump_keyblock (p);
+  pgp_free_key (&p);
+
+  return 0;
+}
+
+/* Go through all key blocks of the key ring. */
+
+static void pgpring_scan (const unsigned char *ring, size_t size,
+			  const char *hints[], int nhints)
+{
+  unsigned char *buff;
+  unsigned char pt;
+  size_t pos = 0, off = 0, l;
+  size_t block = 0;
+  int seen_key = 0;
+
+  while ((buff = pgp_read_packet_mem (ring, size, &off, &l)) != NULL)
+  {
+    pt = buff[0] & 0x3f;
+
+    if (pt == PT_SECKEY || pt == PT_PUBKEY)
+    {
+      if (seen_key && pgpring_dump_block (ring, size, block, hints, nhints) == -1)
+	return;
+      seen_key = 1;
+      block = pos;
+    }
+
+    pos = off;
+  }
+
+  if (seen_key)
+    pgpring_dump_block (ring, size, block, hints, nhints);
+}
+
+/* 
+ * The key ring index.
+ *
+ * Finding the keys matching some hints means reading the key ring up
+ * to the end, which gets slow with large key rings.  The index kept
+ * next to the key ring in <ring>.idx maps the words of the user IDs and
+ * the key IDs to the key blocks they appear in, so that only the key
+ * blocks which may match need to be looked at.  The index is rebuilt
+ * when the key ring's mtime or size change.
+ *
+ * A hint matches user IDs containing it, so its longest word is
+ * contained in a word of each of them: the key blocks with such a word
+ * are the candidates, and are then checked like in a full scan.
+ */
+
+#define IDX_MAGIC "pgpidx\0\1"
+
+struct idx_header
+{
+  char magic[8];
+  uint64_t mtime;
+  uint64_t size;
+  uint32_t ntokens;
+  uint32_t nposts;
+  uint32_t nids;
+  uint32_t strsize;
+};
+
+/* followed by the postings, the key IDs, the words and their text */
+
+struct idx_id
+{
+  uint64_t block;
+  char keyid[16];	/* sorted by short key ID, then by key ID */
+};
+
+struct idx_token
+{
+  uint32_t str;		/* offset of the text */
+  uint32_t first;	/* the key blocks with this word */
+  uint32_t count;
+};
+
+struct pgpring_idx
+{
+  unsigned char *data;
+  size_t len;
+  int mapped;
+  struct idx_header *hdr;
+  uint64_t *posts;
+  struct idx_id *ids;
+  struct idx_token *tokens;
+  char *strings;
+};
+
+/* a word of a user ID while the index is built */
+struct idx_word
+{
+  uint32_t str;
+  uint64_t block;
+};
+
+struct idx_build
+{
+  struct idx_word *words;
+  size_t nwords, maxwords;
+  char *strings;
+  size_t strsize, maxstr;
+  struct idx_id *ids;
+  size_t nids, maxids;
+};
+
+static const char *SortStrings;
+
+static unsigned char *map_file (int fd, size_t len, int *mapped)
+{
+  unsigned char *p;
+  size_t n = 0;
+  ssize_t r;
+
+  *mapped = 0;
+  if (!len)
+    return NULL;
+
+#ifdef HAVE_MMAP
+  if ((p = mmap (NULL, len, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED)
+  {
+    *mapped = 1;
+    return p;
+  }
+#endif
+
+  p = safe_malloc (len);
+  while (n < len && (r = read (fd, p + n, len - n)) > 0)
+    n += r;
+  if (n < len)
+    FREE (&p);
+  return p;
+}
+
+static void unmap_file (unsigned char **p, size_t len, int mapped)
+{
+#ifdef HAVE_MMAP
+  if (mapped && *p)
+  {
+    munmap (*p, len);
+    *p = NULL;
+    return;
+  }
+#endif
+  FREE (p);		/* __FREE_CHECKED__ */
+}
+
+static int idx_is_word (unsigned char c)
+{
+  return (c & 0x80) || isalnum (c);
+}
+
+static void idx_add_words (struct idx_build *b, const unsigned char *s,
+			   size_t l, size_t block)
+{
+  size_t i = 0, j;
+
+  while (i < l && s[i])
+  {
+    if (!idx_is_word (s[i]))
+    {
+      i++;
+      continue;
+    }
+    for (j = i; j < l && s[j] && idx_is_word (s[j]); j++)
+      ;
+
+    if (b->nwords == b->maxwords)
+    {
+      b->maxwords = b->maxwords ? 2 * b->maxwords : 1024;
+      safe_realloc (&b->words, b->maxwords * sizeof (struct idx_word));
+    }
+    if (b->strsize + j - i + 1 > b->maxstr)
+    {
+      b->maxstr = 2 * (b->strsize + j - i + 1) + 4096;
+      safe_realloc (&b->strings, b->maxstr);
+    }
+
+    b->words[b->nwords].str = b->strsize;
+    b->words[b->nwords].block = block;
+    b->nwords++;
+    for (; i < j; i++)
+      b->strings[b->strsize++] = tolower (s[i]);
+    b->strings[b->strsize++] = '\0';
+  }
+}
+
+static void idx_add_id (struct idx_build *b, const char *keyid, size_t block)
+{
+  if (!keyid || strlen (keyid) != 16)
+    return;
+
+  if (b->nids == b->maxids)
+  {
+    b->maxids = b->maxids ? 2 * b->maxids : 1024;
+    safe_realloc (&b->ids, b->maxids * sizeof (struct idx_id));
+  }
+  b->ids[b->nids].block = block;
+  memcpy (b->ids[b->nids].keyid, keyid, 16);
+  b->nids++;
+}
+
+static int idx_word_cmp (const void *a, const void *b)
+{
+  const struct idx_word *wa = a, *wb = b;
+  int r;
+
+  if ((r = strcmp (SortStrings + wa->str, SortStrings + wb->str)))
+    return r;
+  return wa->block < wb->block ? -1 : wa->block > wb->block;
+}
+
+static int idx_id_cmp (const void *a, const void *b)
+{
+  const struct idx_id *ia = a, *ib = b;
+  int r;
+
+  if ((r = memcmp (ia->keyid + 8, ib->keyid + 8, 8)))
+    return r;
+  return memcmp (ia->keyid, ib->keyid, 8);
+}
+
+static void idx_set_pointers (struct pgpring_idx *idx)
+{
+  idx->hdr = (struct idx_header *) idx->data;
+  idx->posts = (uint64_t *) (idx->hdr + 1);
+  idx->ids = (struct idx_id *) (idx->posts + idx->hdr->nposts);
+  idx->tokens = (struct idx_token *) (idx->ids + idx->hdr->nids);
+  idx->strings = (char *) (idx->tokens + idx->hdr->ntokens);
+}
+
+static uint64_t idx_length (struct idx_header *hdr)
+{
+  return sizeof (struct idx_header)
+    + (uint64_t) hdr->nposts * sizeof (uint64_t)
+    + (uint64_t) hdr->nids * sizeof (struct idx_id)
+    + (uint64_t) hdr->ntokens * sizeof (struct idx_token)
+    + hdr->strsize;
+}
+
+static void idx_free (struct pgpring_idx *idx)
+{
+  unmap_file (&idx->data, idx->len, idx->mapped);
+  memset (idx, 0, sizeof (*idx));
+}
+
+static int idx_load (struct pgpring_idx *idx, const char *path,
+		     struct stat *ring_st)
+{
+  struct idx_header hdr;
+  struct stat st;
+  int fd;
+
+  memset (idx, 0, sizeof (*idx));
+
+  if ((fd = open (path, O_RDONLY)) == -1)
+    return -1;
+  if (fstat (fd, &st) == -1 || st.st_size < sizeof (hdr)
+      || read (fd, &hdr, sizeof (hdr)) != sizeof (hdr)
+      || memcmp (hdr.magic, IDX_MAGIC, sizeof (hdr.magic))
+      || hdr.mtime != (uint64_t) ring_st->st_mtime
+      || hdr.size != (uint64_t) ring_st->st_size
+      || idx_length (&hdr) != (uint64_t) st.st_size || !hdr.strsize)
+  {
+    close (fd);
+    return -1;
+  }
+
+  idx->len = st.st_size;
+  idx->data = map_file (fd, idx->len, &idx->mapped);
+  close (fd);
+  if (!idx->data)
+    return -1;
+
+  idx_set_pointers (idx);
+  if (idx->strings[idx->hdr->strsize - 1])
+  {
+    idx_free (idx);
+    return -1;
+  }
+
+  return 0;
+}
+
+static void idx_build (struct pgpring_idx *idx, const unsigned char *ring,
+		       size_t size, struct stat *ring_st)
+{
+  struct idx_build b;
+  struct idx_header *hdr;
+  unsigned char *buff;
+  unsigned char pt;
+  size_t pos = 0, off = 0, block = 0, l, i, n, strsize;
+  struct idx_token *t = NULL;
+  pgp_key_t k;
+
+  memset (&b, 0, sizeof (b));
+
+  while ((buff = pgp_read_packet_mem (ring, size, &off, &l)) != NULL)
+  {
+    pt = buff[0] & 0x3f;
+
+    if (pt == PT_SECKEY || pt == PT_PUBKEY)
+      block = pos;
+
+    if (pt == PT_SECKEY || pt == PT_PUBKEY ||
+	pt == PT_SUBKEY || pt == PT_SUBSECKEY)
+    {
+      if ((k = pgp_parse_keyinfo (buff, l)))
       {
-	pgp_key_t p;
+	idx_add_id (&b, k->keyid, block);
+	pgp_free_key (&k);
+      }
+    }
+    else if (pt == PT_NAME)
+      idx_add_words (&b, buff + 1, l - 1, block);
 
-	FSETPOS(rfp, keypos);
+    pos = off;
+  }
 
-	/* Not bailing out here would lead us into an endless loop. */
+  SortStrings = b.strings;
+  if (b.nwords)
+    qsort (b.words, b.nwords, sizeof (struct idx_word), idx_word_cmp);
+  if (b.nids)
+    qsort (b.ids, b.nids, sizeof (struct idx_id), idx_id_cmp);
 
-	if ((p = pgp_parse_keyblock (rfp)) == NULL)
-	  err = 1;
-	
-	pgpring_dump_keyblock (p);
-	pgp_free_key (&p);
+  /* count the distinct words, and the distinct blocks of each */
+  hdr = safe_calloc (1, sizeof (struct idx_header));
+  for (i = 0, strsize = 1; i < b.nwords; i++)
+  {
+    if (!i || strcmp (b.strings + b.words[i].str,
+		      b.strings + b.words[i - 1].str))
+    {
+      hdr->ntokens++;
+      hdr->nposts++;
+      strsize += strlen (b.strings + b.words[i].str) + 1;
+    }
+    else if (b.words[i].block != b.words[i - 1].block)
+      hdr->nposts++;
+  }
+  memcpy (hdr->magic, IDX_MAGIC, sizeof (hdr->magic));
+  hdr->mtime = ring_st->st_mtime;
+  hdr->size = ring_st->st_size;
+  hdr->nids = b.nids;
+  hdr->strsize = strsize;
+
+  idx->len = idx_length (hdr);
+  idx->data = safe_calloc (1, idx->len);
+  idx->mapped = 0;
+  memcpy (idx->data, hdr, sizeof (*hdr));
+  FREE (&hdr);
+  idx_set_pointers (idx);
+
+  if (b.nids)
+    memcpy (idx->ids, b.ids, b.nids * sizeof (struct idx_id));
+
+  /* the text at offset 0 is the empty string */
+  for (i = 0, n = 0, strsize = 1; i < b.nwords; i++)
+  {
+    const char *w = b.strings + b.words[i].str;
+
+    if (!i || strcmp (w, b.strings + b.words[i - 1].str))
+    {
+      t = t ? t + 1 : idx->tokens;
+      t->str = strsize;
+      t->first = n;
+      t->count = 0;
+      strcpy (idx->strings + strsize, w);
+      strsize += strlen (w) + 1;
+    }
+    else if (b.words[i].block == b.words[i - 1].block)
+      continue;
+
+    idx->posts[n++] = b.words[i].block;
+    t->count++;
+  }
+
+  FREE (&b.words);
+  FREE (&b.strings);
+  FREE (&b.ids);
+}
+
+/* Save the index, replacing the old one at once.  Failing to do so
+   isn't an error, the key ring is then searched without it. */
+
+static void idx_write (struct pgpring_idx *idx, const char *path)
+{
+  char tmp[_POSIX_PATH_MAX];
+  size_t n = 0;
+  ssize_t r = 0;
+  int fd;
+
+  if (snprintf (tmp, sizeof (tmp), "%s.%d", path,
+		(int) getpid ()) >= sizeof (tmp))
+    return;
+  if ((fd = open (tmp, O_WRONLY | O_CREAT | O_EXCL, 0600)) == -1)
+    return;
+
+  while (n < idx->len && (r = write (fd, idx->data + n, idx->len - n)) > 0)
+    n += r;
+
+  if (close (fd) != 0 || n < idx->len || rename (tmp, path) == -1)
+    unlink (tmp);
+}
+
+static void idx_add_block (uint64_t **blocks, size_t *n, size_t *max,
+			   uint64_t block)
+{
+  if (*n == *max)
+  {
+    *max = *max ? 2 * *max : 64;
+    safe_realloc (blocks, *max * sizeof (uint64_t));
+  }
+  (*blocks)[(*n)++] = block;
+}
+
+static int idx_block_cmp (const void *a, const void *b)
+{
+  uint64_t ba = *(const uint64_t *) a, bb = *(const uint64_t *) b;
+
+  return ba < bb ? -1 : ba > bb;
+}
+
+/* Find the key blocks which may match one of the hints, in the order of
+   the key ring.  Returns -1 if a hint can't be looked up in the index. */
+
+static int idx_find (struct pgpring_idx *idx, const char *hints[], int nhints,
+		     uint64_t **blocks, size_t *nblocks)
+{
+  char word[LONG_STRING];
+  char id[41];
+  const char *s, *w;
+  size_t max = 0, len, wlen, i, j, lo, hi;
+  int h;
+
+  *blocks = NULL;
+  *nblocks = 0;
+
+  for (h = 0; h < nhints; h++)
+  {
+    /* the longest word of the hint */
+    for (s = hints[h], w = NULL, wlen = 0; *s; s += len)
+    {
+      for (len = 0; s[len] && idx_is_word (s[len]); len++)
+	;
+      if (len > wlen)
+      {
+	w = s;
+	wlen = len;
       }
+      if (!len)
+	len = 1;
+    }
 
-      FREE (&tmp);
+    if (!wlen || wlen >= sizeof (word))
+    {
+      FREE (blocks);		/* __FREE_CHECKED__ */
+      *nblocks = 0;
+      return -1;
+    }
+
+    for (i = 0; i < wlen; i++)
+      word[i] = tolower ((unsigned char) w[i]);
+    word[wlen] = '\0';
+
+    for (i = 0; i < idx->hdr->ntokens; i++)
+    {
+      struct idx_token *t = &idx->tokens[i];
+
+      if (t->str >= idx->hdr->strsize
+	  || t->first > idx->hdr->nposts
+	  || t->count > idx->hdr->nposts - t->first)
+	continue;
+      if (!strstr (idx->strings + t->str, word))
+	continue;
+      for (j = 0; j < t->count; j++)
+	idx_add_block (blocks, nblocks, &max, idx->posts[t->first + j]);
+    }
+
+    if ((len = pgpring_hint_keyid (hints[h], id)))
+    {
+      const char *keyid = id + len - (len == 8 ? 8 : 16);
+
+      for (i = 0; id[i]; i++)
+	id[i] = toupper ((unsigned char) id[i]);
+
+      /* binary search for the first entry with this short key ID */
+      for (lo = 0, hi = idx->hdr->nids; lo < hi; )
+      {
+	size_t mid = (lo + hi) / 2;
+
+	if (memcmp (idx->ids[mid].keyid + 8, keyid + (len == 8 ? 0 : 8), 8) < 0)
+	  lo = mid + 1;
+	else
+	  hi = mid;
+      }
+      for (; lo < idx->hdr->nids
+	     && !memcmp (idx->ids[lo].keyid + 8, keyid + (len == 8 ? 0 : 8), 8);
+	   lo++)
+	if (len == 8 || !memcmp (idx->ids[lo].keyid, keyid, 8))
+	  idx_add_block (blocks, nblocks, &max, idx->ids[lo].block);
     }
+  }
 
-    FGETPOS(rfp,pos);
+  if (*nblocks)
+  {
+    qsort (*blocks, *nblocks, sizeof (uint64_t), idx_block_cmp);
+    for (i = 1, j = 1; i < *nblocks; i++)
+      if ((*blocks)[i] != (*blocks)[j - 1])
+	(*blocks)[j++] = (*blocks)[i];
+    *nblocks = j;
+  }
+
+  return 0;
+}
+
+/* 
+ * Go through the key ring file and look for keys with
+ * matching IDs.
+ */
+
+static void pgpring_find_candidates (char *ringfile, const char *hints[], int nhints)
+{
+  struct pgpring_idx idx;
+  struct stat st;
+  char idxfile[_POSIX_PATH_MAX];
+  unsigned char *ring;
+  uint64_t *blocks = NULL;
+  size_t nblocks = 0, i;
+  int fd, mapped;
+
+  if ((fd = open (ringfile, O_RDONLY)) == -1 || fstat (fd, &st) == -1)
+  {
+    char *error_buf;
+    size_t error_buf_len;
+
+    error_buf_len = sizeof ("fopen: ") - 1 + strlen (ringfile) + 1;
+    error_buf = safe_malloc (error_buf_len);
+    snprintf (error_buf, error_buf_len, "fopen: %s", ringfile);
+    perror (error_buf);
+    FREE (&error_buf);
+    if (fd != -1)
+      close (fd);
+    return;
+  }
+
+  ring = map_file (fd, st.st_size, &mapped);
+  close (fd);
+  if (!ring)
+    return;
+
+  /* there is nothing to narrow down when listing all keys, and no
+     index when its name doesn't fit */
+  if (!nhints ||
+      snprintf (idxfile, sizeof (idxfile), "%s.idx", ringfile) >= sizeof (idxfile))
+  {
+    pgpring_scan (ring, st.st_size, hints, nhints);
+    unmap_file (&ring, st.st_size, mapped);
+    return;
+  }
+
+  if (idx_load (&idx, idxfile, &st) == -1)
+  {
+    idx_build (&idx, ring, st.st_size, &st);
+    idx_write (&idx, idxfile);
   }
 
-  safe_fclose (&rfp);
+  if (idx_find (&idx, hints, nhints, &blocks, &nblocks) == -1)
+    pgpring_scan (ring, st.st_size, hints, nhints);
+  else
+  {
+    for (i = 0; i < nblocks; i++)
+      if (blocks[i] >= st.st_size
+	  || pgpring_dump_block (ring, st.st_size, blocks[i], hints, nhints) == -1)
+	break;
+  }
 
+  FREE (&blocks);
+  idx_free (&idx);
+  unmap_file (&ring, st.st_size, mapped);
 }
 
 static void print_userid (const char *id)
@@ -27,6 +27,7 @@
 #include "pop.h"
 #include "mutt_crypt.h"
 #include "bcache.h"
+#include "timing.h"
 #if USE_HCACHE
 #include "hcache.h"
 #endif
@@ -239,6 +240,7 @@ static int pop_fetch_headers (CONTEXT *ctx)
   unsigned short hcached = 0, bcached;
   POP_DATA *pop_data = (POP_DATA *)ctx->data;
   progress_t progress;
+  timing_t start = mutt_timing_now ();
 
 #ifdef USE_HCACHE
   header_cache_t *hc = NULL;
@@ -378,6 +380,8 @@ static int pop_fetch_headers (CONTEXT *ctx)
     mutt_hcache_close (hc);
 #endif
 
+  mutt_timing_add (TIMING_POP_HEADERS, start, ctx->msgcount - old_count);
+
   if (ret < 0)
   {
     for (i = ctx->msgcount; i < new_count; i++)
@@ -24,6 +24,7 @@
 #include "mx.h"
 #include "url.h"
 #include "pop.h"
+#include "timing.h"
 #if defined(USE_SSL)
 # include "mutt_ssl.h"
 #endif
@@ -420,6 +421,7 @@ int pop_query_d (POP_DATA *pop_data, char *buf, size_t buflen, char *msg)
 {
   int dbg = M_SOCK_LOG_CMD;
   char *c;
+  timing_t start = mutt_timing_now ();
 
   if (pop_data->status != POP_CONNECTED)
     return -1;
@@ -444,6 +446,7 @@ int pop_query_d (POP_DATA *pop_data, char *buf, size_t buflen, char *msg)
     pop_data->status = POP_DISCONNECTED;
     return -1;
   }
+  mutt_timing_add (TIMING_POP_CMD, start, 0);
   if (!mutt_strncmp (buf, "+OK", 3))
     return 0;
 
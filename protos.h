@@ -114,6 +114,7 @@ LIST *mutt_make_references(ENVELOPE *e);
 
 char *mutt_read_rfc822_line (FILE *, char *, size_t *);
 ENVELOPE *mutt_read_rfc822_header (FILE *, HEADER *, short, short);
+ENVELOPE *mutt_read_rfc822_header_span (char *, size_t, HEADER *, short, short);
 HEADER *mutt_dup_header (HEADER *);
 
 void mutt_set_mtime (const char *from, const char *to);
@@ -267,6 +268,8 @@ int mutt_addwch (wchar_t);
 int mutt_alias_complete (char *, size_t);
 void mutt_alias_add_reverse (ALIAS *t);
 void mutt_alias_delete_reverse (ALIAS *t);
+void mutt_alias_append (ALIAS *t);
+void mutt_alias_delete_name (ALIAS *t);
 int mutt_alloc_color (int fg, int bg);
 int mutt_any_key_to_continue (const char *);
 int mutt_buffy_check (int);
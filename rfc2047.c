@@ -62,7 +62,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
   size_t obl, n;
   int e;
 
-  cd = mutt_iconv_open (to, from, 0);
+  cd = mutt_iconv_cache_open (to, from, 0);
   if (cd == (iconv_t)(-1))
     return (size_t)(-1);
   obl = 4 * flen + 1;
@@ -72,7 +72,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
   {
     e = errno;
     FREE (&buf);
-    iconv_close (cd);
+    mutt_iconv_cache_close (cd);
     errno = e;
     return (size_t)(-1);
   }
@@ -82,7 +82,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
 
   safe_realloc (&buf, ob - buf + 1);
   *t = buf;
-  iconv_close (cd);
+  mutt_iconv_cache_close (cd);
 
   return n;
 }
@@ -280,18 +280,18 @@ static size_t try_block (ICONV_CONST char *d, size_t dlen,
 
   if (fromcode)
   {
-    cd = mutt_iconv_open (tocode, fromcode, 0);
+    cd = mutt_iconv_cache_open (tocode, fromcode, 0);
     assert (cd != (iconv_t)(-1));
     ib = d, ibl = dlen, ob = buf1, obl = sizeof (buf1) - strlen (tocode);
     if (iconv (cd, &ib, &ibl, &ob, &obl) == (size_t)(-1) ||
 	iconv (cd, 0, 0, &ob, &obl) == (size_t)(-1))
     {
       assert (errno == E2BIG);
-      iconv_close (cd);
+      mutt_iconv_cache_close (cd);
       assert (ib > d);
       return (ib - d == dlen) ? dlen : ib - d + 1;
     }
-    iconv_close (cd);
+    mutt_iconv_cache_close (cd);
   }
   else
   {
@@ -351,13 +351,13 @@ static size_t encode_block (char *s, char *d, size_t dlen,
 
   if (fromcode)
   {
-    cd = mutt_iconv_open (tocode, fromcode, 0);
+    cd = mutt_iconv_cache_open (tocode, fromcode, 0);
     assert (cd != (iconv_t)(-1));
     ib = d, ibl = dlen, ob = buf1, obl = sizeof (buf1) - strlen (tocode);
     n1 = iconv (cd, &ib, &ibl, &ob, &obl);
     n2 = iconv (cd, 0, 0, &ob, &obl);
     assert (n1 != (size_t)(-1) && n2 != (size_t)(-1));
-    iconv_close (cd);
+    mutt_iconv_cache_close (cd);
     return (*encoder) (s, buf1, ob - buf1, tocode);
   }
   else
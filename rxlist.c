@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* Indexed regular expression lists ($alternates, lists, subscribe, ...).
+ *
+ * Each list built with mutt_add_to_rx_list() gets an index of its
+ * patterns, so that adding an entry doesn't compare it with all others.
+ *
+ * Matching a string against a list used to run every regular expression
+ * of the list in turn.  Most entries are addresses or domains, which
+ * can only match strings containing some literal text, like
+ * "@lists.example.org" for "@lists\.example\.org$".  The first time a
+ * list is matched against, these required substrings are put in a hash
+ * table; only the entries whose substring occurs in the string are then
+ * run.  The other entries are combined into a single expression.  The
+ * results are remembered per string until the list changes.
+ */
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mutt.h"
+#include "mutt_regex.h"
+
+#include <string.h>
+#include <ctype.h>
+
+/* the longest required substring looked for */
+#define RX_FACTOR_MAX 32
+
+/* the number of results remembered per list */
+#define RX_MEMO_MAX 4096
+
+/* the entries requiring a substring */
+struct rx_factor
+{
+  char *text;
+  RX_LIST **entry;
+  int nentries;
+  int max;
+};
+
+struct rx_matcher
+{
+  HASH *factors;
+  unsigned char lens[RX_FACTOR_MAX + 1];	/* lengths of the substrings */
+  regex_t *combined;			/* most other entries */
+  int ncombined;
+  RX_LIST **other;			/* the rest of them */
+  int nothers;
+  HASH *memo;				/* strings matched against */
+  int nmemo;
+};
+
+struct rx_list_index
+{
+  RX_LIST **list;
+  HASH *patterns;			/* the entries by pattern */
+  RX_LIST *last;
+  int flags;				/* used to compile the entries */
+  int mixed;				/* with different flags */
+  struct rx_matcher *matcher;
+  struct rx_list_index *next;
+};
+
+static struct rx_list_index *RxListIndex = NULL;
+
+static void rx_free_factor (void *p)
+{
+  struct rx_factor *f = (struct rx_factor *) p;
+
+  FREE (&f->text);
+  FREE (&f->entry);
+  FREE (&f);		/* __FREE_CHECKED__ */
+}
+
+static void rx_free_memo (void *p)
+{
+  FREE (&p);		/* __FREE_CHECKED__ */
+}
+
+static void rx_free_matcher (struct rx_matcher **m)
+{
+  if (!*m)
+    return;
+
+  if ((*m)->factors)
+    hash_destroy (&(*m)->factors, rx_free_factor);
+  if ((*m)->combined)
+  {
+    regfree ((*m)->combined);
+    FREE (&(*m)->combined);
+  }
+  FREE (&(*m)->other);
+  if ((*m)->memo)
+    hash_destroy (&(*m)->memo, rx_free_memo);
+  FREE (m);		/* __FREE_CHECKED__ */
+}
+
+static struct rx_list_index *rx_find_index (RX_LIST **list)
+{
+  struct rx_list_index *idx;
+
+  for (idx = RxListIndex; idx; idx = idx->next)
+    if (idx->list == list)
+      return idx;
+  return NULL;
+}
+
+/* the index of list, made from its entries if there is none yet */
+static struct rx_list_index *rx_get_index (RX_LIST **list)
+{
+  struct rx_list_index *idx;
+  RX_LIST *p;
+
+  if ((idx = rx_find_index (list)))
+    return idx;
+
+  idx = safe_calloc (1, sizeof (struct rx_list_index));
+  idx->list = list;
+  idx->patterns = hash_create (127, 1);
+  idx->flags = -1;
+  for (p = *list; p; p = p->next)
+  {
+    hash_insert (idx->patterns, p->rx->pattern, p, 0);
+    idx->last = p;
+    idx->mixed = 1;			/* flags unknown */
+  }
+
+  idx->next = RxListIndex;
+  RxListIndex = idx;
+  return idx;
+}
+
+/* Forget the index of list, whose entries are being freed. */
+void mutt_rx_list_forget (RX_LIST **list)
+{
+  struct rx_list_index **pidx, *idx;
+
+  for (pidx = &RxListIndex; (idx = *pidx); pidx = &idx->next)
+  {
+    if (idx->list == list)
+    {
+      *pidx = idx->next;
+      hash_destroy (&idx->patterns, NULL);
+      rx_free_matcher (&idx->matcher);
+      FREE (&idx);
+      return;
+    }
+  }
+}
+
+/* Index list again after entries were removed. */
+void mutt_rx_list_reindex (RX_LIST **list)
+{
+  struct rx_list_index *idx;
+  int flags, mixed;
+
+  if (!(idx = rx_find_index (list)))
+    return;
+
+  flags = idx->flags;
+  mixed = idx->mixed;
+  mutt_rx_list_forget (list);
+  if (*list)
+  {
+    idx = rx_get_index (list);
+    idx->flags = flags;
+    idx->mixed = mixed;
+  }
+}
+
+/* Return the entry of list with pattern s, compared ignoring case. */
+RX_LIST *mutt_rx_list_find (RX_LIST **list, const char *s)
+{
+  if (!*list)
+    return NULL;
+  return hash_find (rx_get_index (list)->patterns, s);
+}
+
+/* Add rx, compiled with flags, at the end of list. */
+void mutt_rx_list_append (RX_LIST **list, REGEXP *rx, int flags)
+{
+  struct rx_list_index *idx = rx_get_index (list);
+  RX_LIST *t;
+
+  t = mutt_new_rx_list();
+  t->rx = rx;
+  if (idx->last)
+    idx->last->next = t;
+  else
+    *list = t;
+  idx->last = t;
+  hash_insert (idx->patterns, rx->pattern, t, 0);
+
+  if (idx->flags == -1)
+    idx->flags = flags;
+  else if (idx->flags != flags)
+    idx->mixed = 1;
+
+  rx_free_matcher (&idx->matcher);
+}
+
+/* Put the longest literal text any match of pattern must contain, in
+ * lower case if fold is set, into buf and return its length, or 0 if
+ * there is none or the pattern is too involved to tell. */
+static size_t rx_factor (const char *pattern, char *buf, int fold)
+{
+  char run[RX_FACTOR_MAX + 1];
+  size_t len = 0, best = 0;
+  const char *p = pattern;
+  int atom = 0;			/* the last atom is a literal in run */
+  char c;
+
+  if (*p == '^')
+    p++;
+
+  for (; ; p++)
+  {
+    c = *p;
+
+    if (!c || c == '.' || (c == '$' && !p[1]) ||
+	c == '*' || c == '+' || c == '?')
+    {
+      if (c == '*' || c == '+' || c == '?')
+      {
+	/* the quantified atom may be missing or repeated */
+	if (p == pattern || (p == pattern + 1 && *pattern == '^'))
+	  return 0;
+	if (atom)
+	  len--;
+      }
+      if (len > best)
+      {
+	memcpy (buf, run, len);
+	best = len;
+      }
+      len = 0;
+      atom = 0;
+      if (!c || c == '$')
+	break;
+      continue;
+    }
+
+    if (c == '\\')
+    {
+      c = *++p;
+      if (!c || isalnum ((unsigned char) c) || strchr ("<>`'", c))
+	return 0;
+    }
+    else if (strchr ("()[]{}|^$", c))
+      return 0;
+
+    if (c & 0x80)
+      return 0;
+
+    /* keep the start of long runs, any part of them is required too */
+    if (len < RX_FACTOR_MAX)
+    {
+      run[len++] = fold ? tolower ((unsigned char) c) : c;
+      atom = 1;
+    }
+    else
+      atom = 0;
+  }
+
+  buf[best] = 0;
+  return best;
+}
+
+/* Return the literal text any match of pattern must contain, or NULL.
+ * Matching strings without it can be skipped without running the
+ * expression, which must have been compiled with REGCOMP(). */
+char *mutt_rx_literal (const char *pattern, int fold)
+{
+  char buf[RX_FACTOR_MAX + 1];
+
+  if (!rx_factor (pattern, buf, fold))
+    return NULL;
+  return safe_strdup (buf);
+}
+
+/* Whether pattern may be a branch of an alternation: it has no back
+ * references, which would need renumbering, and its parentheses pair. */
+static int rx_combinable (const char *pattern)
+{
+  const char *s;
+  int depth = 0;
+
+  for (s = pattern; *s; s++)
+  {
+    if (*s == '\\')
+    {
+      if (!*++s || isdigit ((unsigned char) *s))
+	return 0;
+    }
+    else if (*s == '(')
+      depth++;
+    else if (*s == ')' && --depth < 0)
+      return 0;
+  }
+  return depth == 0;
+}
+
+static struct rx_matcher *rx_build_matcher (struct rx_list_index *idx)
+{
+  struct rx_matcher *m;
+  struct rx_factor *f;
+  char factor[RX_FACTOR_MAX + 1];
+  BUFFER *combined;
+  RX_LIST *p, **rest;
+  size_t len;
+  int i, n = 0, nrest = 0;
+
+  for (p = *idx->list; p; p = p->next)
+    n++;
+
+  m = safe_calloc (1, sizeof (struct rx_matcher));
+  m->factors = hash_create (n * 2 + 1, 0);
+  m->memo = hash_create (n < 1031 ? 1031 : n, 0);
+  rest = safe_calloc (n, sizeof (RX_LIST *));
+
+  for (p = *idx->list; p; p = p->next)
+  {
+    if ((len = rx_factor (p->rx->pattern, factor, 1)))
+    {
+      if ((f = hash_find (m->factors, factor)) == NULL)
+      {
+	f = safe_calloc (1, sizeof (struct rx_factor));
+	f->text = safe_strdup (factor);
+	hash_insert (m->factors, f->text, f, 0);
+	m->lens[len] = 1;
+      }
+      if (f->nentries == f->max)
+	safe_realloc (&f->entry, (f->max += 4) * sizeof (RX_LIST *));
+      f->entry[f->nentries++] = p;
+    }
+    else
+      rest[nrest++] = p;
+  }
+
+  /* one alternation matches where one of its branches would */
+  if (nrest > 1 && !idx->mixed)
+  {
+    combined = mutt_buffer_new ();
+    for (i = 0; i < nrest; i++)
+    {
+      if (!rx_combinable (rest[i]->rx->pattern))
+	continue;
+      if (m->ncombined++)
+	mutt_buffer_addch (combined, '|');
+      mutt_buffer_addch (combined, '(');
+      mutt_buffer_addstr (combined, rest[i]->rx->pattern);
+      mutt_buffer_addch (combined, ')');
+    }
+
+    if (m->ncombined > 1)
+    {
+      m->combined = safe_calloc (1, sizeof (regex_t));
+      if (REGCOMP (m->combined, combined->data, idx->flags | REG_NOSUB) != 0)
+      {
+	dprint (2, (debugfile, "rx_build_matcher: can't combine %d expressions.\n",
+		    m->ncombined));
+	FREE (&m->combined);
+      }
+    }
+    if (!m->combined)
+      m->ncombined = 0;
+    mutt_buffer_free (&combined);
+  }
+
+  /* the others are tried one by one */
+  for (i = 0; i < nrest; i++)
+    if (!m->combined || !rx_combinable (rest[i]->rx->pattern))
+      rest[m->nothers++] = rest[i];
+  if (m->nothers)
+    m->other = rest;
+  else
+    FREE (&rest);
+
+  dprint (3, (debugfile, "rx_build_matcher: %d of %d expressions are looked up, %d combined.\n",
+	      n - nrest, n, m->ncombined));
+
+  return m;
+}
+
+static int rx_match_all (RX_LIST *l, const char *s)
+{
+  for (; l; l = l->next)
+  {
+    if (regexec (l->rx->rx, s, (size_t) 0, (regmatch_t *) 0, (int) 0) == 0)
+    {
+      dprint (5, (debugfile, "mutt_match_rx_list: %s matches %s\n", s, l->rx->pattern));
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int rx_match (struct rx_list_index *idx, const char *s)
+{
+  struct rx_matcher *m = idx->matcher;
+  struct rx_factor *f;
+  char *buf;
+  size_t slen, i, len;
+  int j, rv = 0;
+  char c;
+
+  slen = strlen (s);
+  buf = safe_malloc (slen + 1);
+  for (i = 0; i <= slen; i++)
+  {
+    /* case folding beyond ASCII might match text the substrings don't */
+    if (s[i] & 0x80)
+    {
+      FREE (&buf);
+      return rx_match_all (*idx->list, s);
+    }
+    buf[i] = tolower ((unsigned char) s[i]);
+  }
+
+  for (i = 0; i < slen && !rv; i++)
+  {
+    for (len = 1; len <= RX_FACTOR_MAX && i + len <= slen && !rv; len++)
+    {
+      if (!m->lens[len])
+	continue;
+
+      c = buf[i + len];
+      buf[i + len] = 0;
+      f = hash_find (m->factors, buf + i);
+      buf[i + len] = c;
+      if (!f)
+	continue;
+
+      for (j = 0; j < f->nentries; j++)
+      {
+	if (regexec (f->entry[j]->rx->rx, s, 0, NULL, 0) == 0)
+	{
+	  dprint (5, (debugfile, "mutt_match_rx_list: %s matches %s\n", s,
+		      f->entry[j]->rx->pattern));
+	  rv = 1;
+	  break;
+	}
+      }
+    }
+  }
+
+  FREE (&buf);
+
+  if (!rv && m->combined && regexec (m->combined, s, 0, NULL, 0) == 0)
+  {
+    dprint (5, (debugfile, "mutt_match_rx_list: %s matches one of %d expressions\n",
+		s, m->ncombined));
+    rv = 1;
+  }
+
+  if (!rv)
+  {
+    for (j = 0; j < m->nothers; j++)
+    {
+      if (regexec (m->other[j]->rx->rx, s, 0, NULL, 0) == 0)
+      {
+	dprint (5, (debugfile, "mutt_match_rx_list: %s matches %s\n", s,
+		    m->other[j]->rx->pattern));
+	rv = 1;
+	break;
+      }
+    }
+  }
+
+  return rv;
+}
+
+int mutt_match_rx_list (const char *s, RX_LIST *l)
+{
+  struct rx_list_index *idx;
+  struct rx_matcher *m;
+  char *memo;
+  int rv;
+
+  if (!s || !l)
+    return 0;
+
+  for (idx = RxListIndex; idx; idx = idx->next)
+    if (*idx->list == l)
+      break;
+
+  /* not made by mutt_add_to_rx_list() */
+  if (!idx)
+    return rx_match_all (l, s);
+
+  if (!idx->matcher)
+    idx->matcher = rx_build_matcher (idx);
+  m = idx->matcher;
+
+  /* the result follows the string */
+  if ((memo = hash_find (m->memo, s)))
+    return memo[strlen (memo) + 1];
+
+  rv = rx_match (idx, s);
+
+  if (m->nmemo >= RX_MEMO_MAX)
+  {
+    hash_destroy (&m->memo, rx_free_memo);
+    m->memo = hash_create (RX_MEMO_MAX, 0);
+    m->nmemo = 0;
+  }
+  memo = safe_malloc (strlen (s) + 2);
+  strcpy (memo, s);		/* __STRCPY_CHECKED__ */
+  memo[strlen (s) + 1] = rv;
+  hash_insert (m->memo, memo, memo, 0);
+  m->nmemo++;
+
+  return rv;
+}
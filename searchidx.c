@@ -0,0 +1,610 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* Full-text search index for ~b, ~B and ~h on local mailboxes.
+ *
+ * For every message we remember which character trigrams occur in its
+ * header and in its body, as a pair of bitmaps indexed by a 16 bit hash
+ * of the trigram. The bitmaps are folded down to roughly one bit per
+ * distinct trigram, so small messages only cost a few bytes. A message
+ * can only contain a literal string if every trigram of that string has
+ * its bit set, which lets msg_search() skip most messages without
+ * opening them. The regular search still confirms every candidate.
+ *
+ * Text is indexed exactly as msg_search() sees it (decoded or raw,
+ * depending on $thorough_search), with ASCII case and whitespace runs
+ * folded so that case-insensitive searches and unfolded header lines
+ * are covered too. Messages are keyed like the header cache keys them
+ * and are indexed the first time a search reads them.
+ */
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mutt.h"
+#include "mx.h"
+#include "searchidx.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define SIDX_MAGIC "MSX1"
+#define SIDX_MINLOG 6
+#define SIDX_MAXLOG 16
+#define SIDX_SCRATCH ((1 << SIDX_MAXLOG) / 8)
+
+typedef struct
+{
+  char *key;
+  unsigned int stamp;
+  unsigned char thorough;
+  unsigned char log[SIDX_PARTS];	/* log2 of the bitmap sizes */
+  unsigned char *bits[SIDX_PARTS];
+} SIDX_DOC;
+
+struct search_index
+{
+  char *path;		/* NULL: keep the index in memory only */
+  HASH *docs;
+  unsigned int dirty : 1;
+
+  /* trigrams of the last literal we were asked about */
+  char *qstr;
+  int qign;
+  unsigned int *qgrams;
+  int nqgrams;
+};
+
+struct sidx_builder
+{
+  unsigned char thorough;
+  unsigned char *scratch[SIDX_PARTS];
+  unsigned char window[SIDX_PARTS][2];
+  int nwindow[SIDX_PARTS];
+};
+
+static int sidx_fold (unsigned char c)
+{
+  if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+      c == '\v')
+    return ' ';
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A' + 'a';
+  return c;
+}
+
+static unsigned int sidx_gram (unsigned char a, unsigned char b,
+                               unsigned char c)
+{
+  unsigned int t = (a << 16) | (b << 8) | c;
+
+  return ((t * 2654435761U) >> 16) & ((1 << SIDX_MAXLOG) - 1);
+}
+
+static unsigned int sidx_fnv (unsigned int h, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+
+  while (len--)
+  {
+    h ^= *p++;
+    h *= 16777619U;
+  }
+
+  return h;
+}
+
+/* sidx_stamp: changes whenever the message a key refers to is replaced */
+static unsigned int sidx_stamp (HEADER *h)
+{
+  unsigned int s = 2166136261U;
+  LOFF_T hlen = h->content->offset - h->offset;
+
+  if (h->env && h->env->message_id)
+    s = sidx_fnv (s, h->env->message_id, strlen (h->env->message_id));
+  s = sidx_fnv (s, &h->content->length, sizeof (h->content->length));
+  s = sidx_fnv (s, &hlen, sizeof (hlen));
+  s = sidx_fnv (s, &h->date_sent, sizeof (h->date_sent));
+
+  return s;
+}
+
+/* sidx_key: same keys as the header cache uses, where there is one */
+static void sidx_key (CONTEXT *ctx, HEADER *h, char *dest, size_t dlen)
+{
+  const char *p;
+  size_t len;
+
+  switch (ctx->magic)
+  {
+    case M_MAILDIR:
+      /* skip the "cur"/"new" prefix and the flags */
+      p = strrchr (h->path + 3, ':');
+      len = p ? (size_t) (p - h->path - 3) : mutt_strlen (h->path + 3);
+      if (len >= dlen)
+	len = dlen - 1;
+      memcpy (dest, h->path + 3, len);
+      dest[len] = 0;
+      break;
+    case M_MH:
+      strfcpy (dest, h->path, dlen);
+      break;
+    default:
+      snprintf (dest, dlen, OFF_T_FMT, h->offset);
+      break;
+  }
+}
+
+static void sidx_free_doc (void *p)
+{
+  SIDX_DOC *doc = p;
+  int i;
+
+  FREE (&doc->key);
+  for (i = 0; i < SIDX_PARTS; i++)
+    FREE (&doc->bits[i]);
+  FREE (&doc);
+}
+
+static int sidx_read (FILE *fp, void *p, size_t len)
+{
+  return fread (p, len, 1, fp) == 1 ? 0 : -1;
+}
+
+static int sidx_write (FILE *fp, const void *p, size_t len)
+{
+  return fwrite (p, len, 1, fp) == 1 ? 0 : -1;
+}
+
+/* sidx_path: per-folder index file under $search_index */
+static char *sidx_path (const char *folder)
+{
+  char path[_POSIX_PATH_MAX];
+  unsigned int h1, h2;
+  struct stat sb;
+
+  if (stat (SearchIndex, &sb) < 0)
+  {
+    if (errno != ENOENT || mkdir (SearchIndex, 0700) < 0)
+    {
+      dprint (1, (debugfile, "sidx_path: can't create %s: %s\n", SearchIndex,
+		  strerror (errno)));
+      return NULL;
+    }
+  }
+  else if (!S_ISDIR (sb.st_mode))
+  {
+    dprint (1, (debugfile, "sidx_path: %s is not a directory\n", SearchIndex));
+    return NULL;
+  }
+
+  h1 = sidx_fnv (2166136261U, folder, strlen (folder));
+  h2 = sidx_fnv (h1 ^ 0x5bd1e995, folder, strlen (folder));
+  snprintf (path, sizeof (path), "%s/%08x%08x", SearchIndex, h1, h2);
+
+  return safe_strdup (path);
+}
+
+static void sidx_load (search_index_t *idx)
+{
+  FILE *fp;
+  char magic[4];
+  char charset[STRING];
+  unsigned short len;
+  unsigned int count, i;
+  SIDX_DOC *doc = NULL;
+  int part;
+
+  if (!(fp = fopen (idx->path, "r")))
+    return;
+
+  if (sidx_read (fp, magic, sizeof (magic)) || memcmp (magic, SIDX_MAGIC, 4)
+      || sidx_read (fp, &len, sizeof (len)) || len >= sizeof (charset)
+      || sidx_read (fp, charset, len))
+    goto bail;
+  charset[len] = 0;
+
+  /* decoded text depends on $charset */
+  if (mutt_strcmp (charset, NONULL (Charset)))
+    goto bail;
+
+  if (sidx_read (fp, &count, sizeof (count)))
+    goto bail;
+
+  for (i = 0; i < count; i++)
+  {
+    doc = safe_calloc (1, sizeof (SIDX_DOC));
+    if (sidx_read (fp, &len, sizeof (len)))
+      goto bail;
+    doc->key = safe_malloc (len + 1);
+    if (sidx_read (fp, doc->key, len))
+      goto bail;
+    doc->key[len] = 0;
+    if (sidx_read (fp, &doc->stamp, sizeof (doc->stamp))
+	|| sidx_read (fp, &doc->thorough, 1)
+	|| sidx_read (fp, doc->log, SIDX_PARTS))
+      goto bail;
+    for (part = 0; part < SIDX_PARTS; part++)
+    {
+      if (doc->log[part] < SIDX_MINLOG || doc->log[part] > SIDX_MAXLOG)
+	goto bail;
+      doc->bits[part] = safe_malloc ((1 << doc->log[part]) / 8);
+      if (sidx_read (fp, doc->bits[part], (1 << doc->log[part]) / 8))
+	goto bail;
+    }
+
+    hash_insert (idx->docs, doc->key, doc, 0);
+    doc = NULL;
+  }
+
+  safe_fclose (&fp);
+  dprint (2, (debugfile, "sidx_load: %u messages indexed in %s\n", count,
+	      idx->path));
+  return;
+
+bail:
+  dprint (1, (debugfile, "sidx_load: discarding invalid index %s\n",
+	      idx->path));
+  if (doc)
+    sidx_free_doc (doc);
+  safe_fclose (&fp);
+  hash_destroy (&idx->docs, sidx_free_doc);
+  idx->docs = hash_create (1031, 0);
+}
+
+static void sidx_save (search_index_t *idx, CONTEXT *ctx)
+{
+  char tmp[_POSIX_PATH_MAX];
+  char key[_POSIX_PATH_MAX];
+  FILE *fp;
+  SIDX_DOC *doc;
+  unsigned short len;
+  unsigned int count = 0;
+  long countpos;
+  int i, part;
+
+  snprintf (tmp, sizeof (tmp), "%s.tmp", idx->path);
+  if (!(fp = safe_fopen (tmp, "w")))
+  {
+    dprint (1, (debugfile, "sidx_save: can't create %s\n", tmp));
+    return;
+  }
+
+  len = mutt_strlen (Charset);
+  if (sidx_write (fp, SIDX_MAGIC, 4) || sidx_write (fp, &len, sizeof (len))
+      || sidx_write (fp, NONULL (Charset), len))
+    goto bail;
+  countpos = ftell (fp);
+  if (sidx_write (fp, &count, sizeof (count)))
+    goto bail;
+
+  /* only write out documents for messages that are still there */
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    sidx_key (ctx, ctx->hdrs[i], key, sizeof (key));
+    if (!(doc = hash_find (idx->docs, key))
+	|| doc->stamp != sidx_stamp (ctx->hdrs[i]))
+      continue;
+
+    len = mutt_strlen (doc->key);
+    if (sidx_write (fp, &len, sizeof (len)) || sidx_write (fp, doc->key, len)
+	|| sidx_write (fp, &doc->stamp, sizeof (doc->stamp))
+	|| sidx_write (fp, &doc->thorough, 1)
+	|| sidx_write (fp, doc->log, SIDX_PARTS))
+      goto bail;
+    for (part = 0; part < SIDX_PARTS; part++)
+      if (sidx_write (fp, doc->bits[part], (1 << doc->log[part]) / 8))
+	goto bail;
+    count++;
+  }
+
+  if (fseek (fp, countpos, SEEK_SET) || sidx_write (fp, &count, sizeof (count)))
+    goto bail;
+
+  if (safe_fclose (&fp) || rename (tmp, idx->path) < 0)
+  {
+    dprint (1, (debugfile, "sidx_save: can't write %s: %s\n", idx->path,
+		strerror (errno)));
+    unlink (tmp);
+    return;
+  }
+
+  idx->dirty = 0;
+  dprint (2, (debugfile, "sidx_save: wrote %u messages to %s\n", count,
+	      idx->path));
+  return;
+
+bail:
+  safe_fclose (&fp);
+  unlink (tmp);
+}
+
+/* sidx_get: return the index for ctx, loading it on first use */
+static search_index_t *sidx_get (CONTEXT *ctx)
+{
+  search_index_t *idx;
+
+  if (!SearchIndex || !*SearchIndex)
+    return NULL;
+  if (ctx->magic != M_MBOX && ctx->magic != M_MMDF && ctx->magic != M_MH
+      && ctx->magic != M_MAILDIR)
+    return NULL;
+
+  if (ctx->sidx)
+    return ctx->sidx;
+
+  idx = safe_calloc (1, sizeof (search_index_t));
+  idx->docs = hash_create (ctx->msgcount > 1031 ? ctx->msgcount : 1031, 0);
+  if ((idx->path = sidx_path (ctx->path)))
+    sidx_load (idx);
+
+  return ctx->sidx = idx;
+}
+
+/* sidx_lookup: find the current index entry for h, if there is one */
+static SIDX_DOC *sidx_lookup (search_index_t *idx, CONTEXT *ctx, HEADER *h)
+{
+  char key[_POSIX_PATH_MAX];
+  SIDX_DOC *doc;
+
+  sidx_key (ctx, h, key, sizeof (key));
+  if (!(doc = hash_find (idx->docs, key)))
+    return NULL;
+
+  if (doc->stamp != sidx_stamp (h)
+      || doc->thorough != (option (OPTTHOROUGHSRC) ? 1 : 0))
+    return NULL;
+
+  return doc;
+}
+
+/* sidx_query: compute the trigrams a message must contain to match s */
+static void sidx_query (search_index_t *idx, const char *s, int ign_case)
+{
+  unsigned char w[2] = { 0, 0 };
+  int n = 0, c, i;
+
+  if (idx->qstr && !mutt_strcmp (idx->qstr, s) && idx->qign == ign_case)
+    return;
+
+  mutt_str_replace (&idx->qstr, s);
+  idx->qign = ign_case;
+  idx->nqgrams = 0;
+  safe_realloc (&idx->qgrams, (strlen (s) + 1) * sizeof (unsigned int));
+
+  for (; *s; s++)
+  {
+    c = sidx_fold ((unsigned char) *s);
+    if (c == ' ' && n && w[1] == ' ')
+      continue;
+    if (n == 2)
+    {
+      /* non-ASCII letters may have other case forms we know nothing
+       * about, so only use those trigrams for exact searches */
+      if (!ign_case || (w[0] < 0x80 && w[1] < 0x80 && c < 0x80))
+      {
+	idx->qgrams[idx->nqgrams] = sidx_gram (w[0], w[1], c);
+	for (i = 0; i < idx->nqgrams; i++)
+	  if (idx->qgrams[i] == idx->qgrams[idx->nqgrams])
+	    break;
+	if (i == idx->nqgrams)
+	  idx->nqgrams++;
+      }
+    }
+    else
+      n++;
+    w[0] = w[1];
+    w[1] = c;
+  }
+}
+
+static int sidx_has_all (SIDX_DOC *doc, int part, unsigned int *grams, int n)
+{
+  unsigned int mask = (1 << doc->log[part]) - 1;
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (!(doc->bits[part][(grams[i] & mask) >> 3] & (1 << (grams[i] & 7))))
+      return 0;
+
+  return 1;
+}
+
+/* mutt_sidx_excludes: returns 1 if the index proves that h can't match
+ *   the ~b/~B/~h pattern pat, 0 if h has to be searched. */
+int mutt_sidx_excludes (CONTEXT *ctx, HEADER *h, pattern_t *pat)
+{
+  search_index_t *idx;
+  SIDX_DOC *doc;
+  const char *s;
+
+  if (pat->stringmatch)
+    s = pat->p.str;
+  else if (!(s = pat->literal))
+    return 0;
+
+  if (!(idx = sidx_get (ctx)) || !(doc = sidx_lookup (idx, ctx, h)))
+    return 0;
+
+  sidx_query (idx, s, pat->ign_case);
+  if (!idx->nqgrams)
+    return 0;
+
+  switch (pat->op)
+  {
+    case M_HEADER:
+      return !sidx_has_all (doc, SIDX_HEADER, idx->qgrams, idx->nqgrams);
+    case M_BODY:
+      return !sidx_has_all (doc, SIDX_BODY, idx->qgrams, idx->nqgrams);
+    case M_WHOLE_MSG:
+      /* a match never spans the header/body boundary */
+      return !sidx_has_all (doc, SIDX_HEADER, idx->qgrams, idx->nqgrams)
+	&& !sidx_has_all (doc, SIDX_BODY, idx->qgrams, idx->nqgrams);
+  }
+
+  return 0;
+}
+
+/* mutt_sidx_begin: returns a builder if h should be indexed, in which case
+ *   the caller must feed it the complete header and body text with
+ *   mutt_sidx_add(), then call mutt_sidx_commit() or mutt_sidx_abort(). */
+sidx_builder_t *mutt_sidx_begin (CONTEXT *ctx, HEADER *h)
+{
+  search_index_t *idx;
+  sidx_builder_t *b;
+  int part;
+
+  if (!(idx = sidx_get (ctx)) || sidx_lookup (idx, ctx, h))
+    return NULL;
+
+  b = safe_calloc (1, sizeof (sidx_builder_t));
+  b->thorough = option (OPTTHOROUGHSRC) ? 1 : 0;
+  for (part = 0; part < SIDX_PARTS; part++)
+    b->scratch[part] = safe_calloc (1, SIDX_SCRATCH);
+
+  return b;
+}
+
+void mutt_sidx_add (sidx_builder_t *b, int part, const char *buf, size_t len)
+{
+  unsigned char *bits = b->scratch[part];
+  unsigned char *w = b->window[part];
+  int n = b->nwindow[part];
+  unsigned int g;
+  int c;
+
+  for (; len; buf++, len--)
+  {
+    c = sidx_fold ((unsigned char) *buf);
+    if (c == ' ' && n && w[1] == ' ')
+      continue;
+    if (n == 2)
+    {
+      g = sidx_gram (w[0], w[1], c);
+      bits[g >> 3] |= 1 << (g & 7);
+    }
+    else
+      n++;
+    w[0] = w[1];
+    w[1] = c;
+  }
+
+  b->nwindow[part] = n;
+}
+
+/* mutt_sidx_add_file: feed len bytes from the current position of fp */
+int mutt_sidx_add_file (sidx_builder_t *b, int part, FILE *fp, LOFF_T len)
+{
+  char buf[BUFSIZ];
+  size_t n;
+
+  while (len > 0)
+  {
+    n = len > sizeof (buf) ? sizeof (buf) : (size_t) len;
+    if ((n = fread (buf, 1, n, fp)) == 0)
+      return -1;
+    mutt_sidx_add (b, part, buf, n);
+    len -= n;
+  }
+
+  return 0;
+}
+
+void mutt_sidx_abort (sidx_builder_t **b)
+{
+  int part;
+
+  if (!*b)
+    return;
+
+  for (part = 0; part < SIDX_PARTS; part++)
+    FREE (&(*b)->scratch[part]);
+  FREE (b);
+}
+
+void mutt_sidx_commit (CONTEXT *ctx, HEADER *h, sidx_builder_t **b)
+{
+  search_index_t *idx = ctx->sidx;
+  char key[_POSIX_PATH_MAX];
+  SIDX_DOC *doc;
+  unsigned char *bits;
+  int part, log, set, size, i, c;
+
+  if (!*b)
+    return;
+
+  sidx_key (ctx, h, key, sizeof (key));
+  if (!(doc = hash_find (idx->docs, key)))
+  {
+    doc = safe_calloc (1, sizeof (SIDX_DOC));
+    doc->key = safe_strdup (key);
+    hash_insert (idx->docs, doc->key, doc, 0);
+  }
+
+  for (part = 0; part < SIDX_PARTS; part++)
+  {
+    bits = (*b)->scratch[part];
+
+    for (set = 0, i = 0; i < SIDX_SCRATCH; i++)
+      for (c = bits[i]; c; c &= c - 1)
+	set++;
+
+    /* about one bit per distinct trigram */
+    for (log = SIDX_MINLOG; log < SIDX_MAXLOG && (1 << log) < set; log++)
+      ;
+
+    /* hashes are taken modulo the bitmap size, so halving it is just a
+     * matter of or-ing the top half into the bottom half */
+    for (size = SIDX_SCRATCH; size > (1 << log) / 8; size /= 2)
+      for (i = 0; i < size / 2; i++)
+	bits[i] |= bits[i + size / 2];
+
+    FREE (&doc->bits[part]);
+    doc->bits[part] = safe_malloc ((1 << log) / 8);
+    memcpy (doc->bits[part], bits, (1 << log) / 8);
+    doc->log[part] = log;
+  }
+
+  doc->stamp = sidx_stamp (h);
+  doc->thorough = (*b)->thorough;
+  idx->dirty = 1;
+
+  mutt_sidx_abort (b);
+}
+
+/* mutt_sidx_close: write back and free the index of ctx */
+void mutt_sidx_close (CONTEXT *ctx)
+{
+  search_index_t *idx = ctx->sidx;
+
+  if (!idx)
+    return;
+
+  if (idx->dirty && idx->path)
+    sidx_save (idx, ctx);
+
+  hash_destroy (&idx->docs, sidx_free_doc);
+  FREE (&idx->path);
+  FREE (&idx->qstr);
+  FREE (&idx->qgrams);
+  FREE (&ctx->sidx);
+}
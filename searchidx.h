@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* full-text search index for local mailboxes */
+
+#ifndef _SEARCHIDX_H_
+#define _SEARCHIDX_H_ 1
+
+struct search_index;
+typedef struct search_index search_index_t;
+
+struct sidx_builder;
+typedef struct sidx_builder sidx_builder_t;
+
+enum
+{
+  SIDX_HEADER = 0,
+  SIDX_BODY,
+
+  SIDX_PARTS
+};
+
+int mutt_sidx_excludes (CONTEXT *ctx, HEADER *h, pattern_t *pat);
+
+sidx_builder_t *mutt_sidx_begin (CONTEXT *ctx, HEADER *h);
+void mutt_sidx_add (sidx_builder_t *b, int part, const char *buf, size_t len);
+int mutt_sidx_add_file (sidx_builder_t *b, int part, FILE *fp, LOFF_T len);
+void mutt_sidx_commit (CONTEXT *ctx, HEADER *h, sidx_builder_t **b);
+void mutt_sidx_abort (sidx_builder_t **b);
+
+void mutt_sidx_close (CONTEXT *ctx);
+
+#endif /* _SEARCHIDX_H_ */
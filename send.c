@@ -48,6 +48,10 @@
 #include "remailer.h"
 #endif
 
+#ifdef USE_IMAP
+#include "imap.h"
+#endif
+
 
 static void append_signature (FILE *f)
 {
@@ -1269,6 +1273,12 @@ ci_send_message (int flags,		/* send mode */
     }
   }
 
+#ifdef USE_IMAP
+  /* $imap_lazy_headers may have left out the envelopes replied to */
+  if (ctx && (flags & (SENDREPLY | SENDFORWARD)))
+    imap_read_tagged_envelopes (ctx, cur);
+#endif
+
   /* this is handled here so that the user can match ~f in send-hook */
   if (cur && option (OPTREVNAME) && !(flags & (SENDPOSTPONED|SENDRESEND)))
   {
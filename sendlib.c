@@ -505,6 +505,23 @@ typedef struct
 }
 CONTENT_STATE;
 
+/* Word-at-a-time byte tests, see "Bit Twiddling Hacks". HAS_LESS is only
+ * exact for words without 8-bit bytes, so check for those first. */
+#define WORD_ONES	(~0UL / 255)
+#define WORD_HIGHS	(WORD_ONES * 0x80)
+#define HAS_LESS(w,n)	(((w) - WORD_ONES * (n)) & ~(w) & WORD_HIGHS)
+
+/* is every byte of w printable 7-bit (including space, excluding DEL)? */
+static inline int word_is_printable (unsigned long w)
+{
+  return !(w & WORD_HIGHS) && !HAS_LESS (w, 0x20) &&
+    !HAS_LESS (w ^ (WORD_ONES * 0x7f), 1);
+}
+
+static inline int word_is_ascii (unsigned long w)
+{
+  return !(w & WORD_HIGHS);
+}
 
 static void update_content_info (CONTENT *info, CONTENT_STATE *s, char *d, size_t dlen)
 {
@@ -513,6 +530,7 @@ static void update_content_info (CONTENT *info, CONTENT_STATE *s, char *d, size_
   int dot = s->dot;
   int linelen = s->linelen;
   int was_cr = s->was_cr;
+  unsigned long w;
 
   if (!d) /* This signals EOF */
   {
@@ -526,7 +544,29 @@ static void update_content_info (CONTENT *info, CONTENT_STATE *s, char *d, size_
 
   for (; dlen; d++, dlen--)
   {
-    char ch = *d;
+    char ch;
+
+    /* Past the first four characters of a line the "From " and "."
+     * checks are settled, and runs of printable characters only bump
+     * the counters. */
+    if (!was_cr && linelen >= 4)
+    {
+      while (dlen >= sizeof (w))
+      {
+	memcpy (&w, d, sizeof (w));
+	if (!word_is_printable (w))
+	  break;
+	linelen += sizeof (w);
+	info->ascii += sizeof (w);
+	d += sizeof (w);
+	dlen -= sizeof (w);
+	whitespace = d[-1] == ' ' ? whitespace + 1 : 0;
+      }
+      if (!dlen)
+	break;
+    }
+
+    ch = *d;
 
     if (was_cr)
     {
@@ -613,6 +653,169 @@ static void update_content_info (CONTENT *info, CONTENT_STATE *s, char *d, size_
 
 }
 
+/* strict UTF-8 validation, carried across buffers */
+typedef struct
+{
+  int need;			/* continuation bytes still expected */
+  unsigned char lo, hi;		/* range of the next continuation byte */
+  unsigned int bad : 1;
+}
+UTF8_STATE;
+
+static void update_utf8_state (UTF8_STATE *s, const char *d, size_t dlen)
+{
+  unsigned long w;
+  unsigned char c;
+
+  if (!d) /* EOF */
+  {
+    if (s->need)
+      s->bad = 1;
+    return;
+  }
+
+  for (; dlen && !s->bad; d++, dlen--)
+  {
+    if (!s->need)
+    {
+      while (dlen >= sizeof (w))
+      {
+	memcpy (&w, d, sizeof (w));
+	if (!word_is_ascii (w))
+	  break;
+	d += sizeof (w);
+	dlen -= sizeof (w);
+      }
+      if (!dlen)
+	break;
+    }
+
+    c = (unsigned char) *d;
+
+    if (s->need)
+    {
+      if (c < s->lo || c > s->hi)
+	s->bad = 1;
+      s->need--;
+      s->lo = 0x80, s->hi = 0xbf;
+      continue;
+    }
+
+    if (c < 0x80)
+      continue;
+
+    s->lo = 0x80, s->hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf)
+      s->need = 1;
+    else if (c >= 0xe0 && c <= 0xef)
+    {
+      s->need = 2;
+      if (c == 0xe0)
+	s->lo = 0xa0;		/* overlong */
+      else if (c == 0xed)
+	s->hi = 0x9f;		/* surrogates */
+    }
+    else if (c >= 0xf0 && c <= 0xf4)
+    {
+      s->need = 3;
+      if (c == 0xf0)
+	s->lo = 0x90;		/* overlong */
+      else if (c == 0xf4)
+	s->hi = 0x8f;		/* beyond U+10FFFF */
+    }
+    else
+      s->bad = 1;
+  }
+}
+
+/*
+ * The analysis of the raw file, cached by file identity: attachments
+ * are looked at again whenever the compose menu updates their encoding,
+ * and the file is usually unchanged.
+ */
+
+#define CONTENT_CACHE_SIZE 8
+
+typedef struct
+{
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  time_t ctime;
+  CONTENT info;
+  unsigned int utf8 : 1;	/* the file is valid UTF-8 */
+  unsigned int valid : 1;
+}
+CONTENT_CACHE;
+
+static CONTENT_CACHE ContentCache[CONTENT_CACHE_SIZE];
+static int ContentCacheNext = 0;
+
+static CONTENT_CACHE *content_cache_find (const struct stat *sb)
+{
+  int i;
+
+  for (i = 0; i < CONTENT_CACHE_SIZE; i++)
+    if (ContentCache[i].valid &&
+	ContentCache[i].dev == sb->st_dev && ContentCache[i].ino == sb->st_ino &&
+	ContentCache[i].size == sb->st_size &&
+	ContentCache[i].mtime == sb->st_mtime &&
+	ContentCache[i].ctime == sb->st_ctime)
+      return &ContentCache[i];
+
+  return NULL;
+}
+
+/* read the file once, classifying its bytes and checking for valid UTF-8 */
+static CONTENT_CACHE *content_cache_scan (FILE *fp, const struct stat *sb)
+{
+  CONTENT_CACHE *cc;
+  CONTENT_STATE state;
+  UTF8_STATE ustate;
+  char buffer[HUGE_STRING];
+  size_t r;
+  time_t now = time (NULL);
+
+  cc = &ContentCache[ContentCacheNext];
+  ContentCacheNext = (ContentCacheNext + 1) % CONTENT_CACHE_SIZE;
+
+  memset (cc, 0, sizeof (CONTENT_CACHE));
+  memset (&state, 0, sizeof (state));
+  memset (&ustate, 0, sizeof (ustate));
+
+  rewind (fp);
+  while ((r = fread (buffer, 1, sizeof (buffer), fp)))
+  {
+    update_content_info (&cc->info, &state, buffer, r);
+    update_utf8_state (&ustate, buffer, r);
+  }
+  update_content_info (&cc->info, &state, 0, 0);
+  update_utf8_state (&ustate, 0, 0);
+
+  cc->utf8 = !ustate.bad;
+  cc->dev = sb->st_dev;
+  cc->ino = sb->st_ino;
+  cc->size = sb->st_size;
+  cc->mtime = sb->st_mtime;
+  cc->ctime = sb->st_ctime;
+  /* don't remember the result if the file changed while we read it, or
+   * may still change within the second its times are stamped with: an
+   * edit of the same size, or another file reusing the inode, would look
+   * the same */
+  cc->valid = !ferror (fp) && ftello (fp) == sb->st_size &&
+    sb->st_mtime < now && sb->st_ctime < now;
+
+  return cc;
+}
+
+/* does chs encode US-ASCII characters as themselves? */
+static int charset_is_ascii_superset (const char *chs)
+{
+  return mutt_is_us_ascii (chs) || mutt_is_utf8 (chs) ||
+    mutt_chscmp (chs, "iso-8859-");
+}
+
 /* Define as 1 if iconv sometimes returns -1(EILSEQ) instead of transcribing. */
 #define BUGGY_ICONV 1
 
@@ -634,11 +837,12 @@ static void update_content_info (CONTENT *info, CONTENT_STATE *s, char *d, size_
  */
 static size_t convert_file_to (FILE *file, const char *fromcode,
 			       int ncodes, const char **tocodes,
-			       int *tocode, CONTENT *info)
+			       int *tocode, CONTENT *info,
+			       const CONTENT_CACHE *raw)
 {
 #ifdef HAVE_ICONV
   iconv_t cd1, *cd;
-  char bufi[256], bufu[512], bufo[4 * sizeof (bufi)];
+  char bufi[1024], bufu[2048], bufo[4 * sizeof (bufi)];
   ICONV_CONST char *ib, *ub;
   char *ob;
   size_t ibl, obl, ubl, ubl1, n, ret;
@@ -647,7 +851,41 @@ static size_t convert_file_to (FILE *file, const char *fromcode,
   CONTENT_STATE *states;
   size_t *score;
 
-  cd1 = mutt_iconv_open ("utf-8", fromcode, 0);
+  /*
+   * Plain ASCII in an ASCII-compatible charset, and valid UTF-8 headed
+   * for UTF-8, come out of the conversion unchanged: the analysis of the
+   * raw file applies, and there is no need for a trial conversion.
+   */
+  if (ncodes && charset_is_ascii_superset (fromcode))
+  {
+    if (!raw->info.hibin)
+    {
+      if (charset_is_ascii_superset (tocodes[0]))
+      {
+	*tocode = 0;
+	memcpy (info, &raw->info, sizeof (CONTENT));
+	return 0;
+      }
+    }
+    else if (mutt_is_us_ascii (fromcode))
+      return -1;
+    else if (mutt_is_utf8 (fromcode))
+    {
+      if (!raw->utf8)
+	return -1;
+      /* conversion to US-ASCII fails, or isn't exact */
+      for (i = 0; i < ncodes && mutt_is_us_ascii (tocodes[i]); i++)
+	;
+      if (i < ncodes && mutt_is_utf8 (tocodes[i]))
+      {
+	*tocode = i;
+	memcpy (info, &raw->info, sizeof (CONTENT));
+	return 0;
+      }
+    }
+  }
+
+  cd1 = mutt_iconv_cache_open ("utf-8", fromcode, 0);
   if (cd1 == (iconv_t)(-1))
     return -1;
 
@@ -658,7 +896,7 @@ static size_t convert_file_to (FILE *file, const char *fromcode,
 
   for (i = 0; i < ncodes; i++)
     if (ascii_strcasecmp (tocodes[i], "utf-8"))
-      cd[i] = mutt_iconv_open (tocodes[i], "utf-8", 0);
+      cd[i] = mutt_iconv_cache_open (tocodes[i], "utf-8", 0);
     else
       /* Special case for conversion to UTF-8 */
       cd[i] = (iconv_t)(-1), score[i] = (size_t)(-1);
@@ -752,9 +990,9 @@ static size_t convert_file_to (FILE *file, const char *fromcode,
 
   for (i = 0; i < ncodes; i++)
     if (cd[i] != (iconv_t)(-1))
-      iconv_close (cd[i]);
+      mutt_iconv_cache_close (cd[i]);
 
-  iconv_close (cd1);
+  mutt_iconv_cache_close (cd1);
   FREE (&cd);
   FREE (&infos);
   FREE (&score);
@@ -779,7 +1017,8 @@ static size_t convert_file_to (FILE *file, const char *fromcode,
  */
 static size_t convert_file_from_to (FILE *file,
 				    const char *fromcodes, const char *tocodes,
-				    char **fromcode, char **tocode, CONTENT *info)
+				    char **fromcode, char **tocode, CONTENT *info,
+				    const CONTENT_CACHE *raw)
 {
   char *fcode = NULL;
   char **tcode;
@@ -816,7 +1055,7 @@ static size_t convert_file_from_to (FILE *file,
       fcode = mutt_substrdup (c, c1);
 
       ret = convert_file_to (file, fcode, ncodes, (const char **)tcode,
-			     &cn, info);
+			     &cn, info, raw);
       if (ret != (size_t)(-1))
       {
 	*fromcode = fcode;
@@ -831,7 +1070,7 @@ static size_t convert_file_from_to (FILE *file,
   {
     /* There is only one fromcode */
     ret = convert_file_to (file, fromcodes, ncodes, (const char **)tcode,
-			   &cn, info);
+			   &cn, info, raw);
     if (ret != (size_t)(-1))
     {
       *tocode = tcode[cn];
@@ -855,13 +1094,11 @@ static size_t convert_file_from_to (FILE *file,
 CONTENT *mutt_get_content_info (const char *fname, BODY *b)
 {
   CONTENT *info;
-  CONTENT_STATE state;
+  CONTENT_CACHE *raw;
   FILE *fp = NULL;
   char *fromcode = NULL;
   char *tocode;
-  char buffer[100];
   char chsbuf[STRING];
-  size_t r;
 
   struct stat sb;
 
@@ -886,8 +1123,10 @@ CONTENT *mutt_get_content_info (const char *fname, BODY *b)
     return (NULL);
   }
 
+  if ((raw = content_cache_find (&sb)) == NULL)
+    raw = content_cache_scan (fp, &sb);
+
   info = safe_calloc (1, sizeof (CONTENT));
-  memset (&state, 0, sizeof (state));
 
   if (b != NULL && b->type == TYPETEXT && (!b->noconv && !b->force_charset))
   {
@@ -896,7 +1135,7 @@ CONTENT *mutt_get_content_info (const char *fname, BODY *b)
                                 AttachCharset : Charset) : Charset;
     if (Charset && (chs || SendCharset) &&
         convert_file_from_to (fp, fchs, chs ? chs : SendCharset,
-                              &fromcode, &tocode, info) != (size_t)(-1))
+                              &fromcode, &tocode, info, raw) != (size_t)(-1))
     {
       if (!chs)
       {
@@ -910,10 +1149,7 @@ CONTENT *mutt_get_content_info (const char *fname, BODY *b)
     }
   }
 
-  rewind (fp);
-  while ((r = fread (buffer, 1, sizeof(buffer), fp)))
-    update_content_info (info, &state, buffer, r);
-  update_content_info (info, &state, 0, 0);
+  memcpy (info, &raw->info, sizeof (CONTENT));
 
   safe_fclose (&fp);
 
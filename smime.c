@@ -580,40 +580,177 @@ static smime_key_t *smime_parse_key(char *buf)
   return key;
 }
 
-static smime_key_t *smime_get_candidates(char *search, short public)
+/* The keys listed in the .index files of $smime_certificates and
+ * $smime_keys, kept for as long as the files stay the same, so that
+ * looking up the key of each recipient needn't read them again. */
+
+/* the keys an email address or hash belongs to */
+struct smime_key_ref
+{
+  char *name;
+  int *key;
+  int nkeys;
+  int max;
+};
+
+static struct smime_index
+{
+  char *path;
+  time_t mtime;
+  off_t size;
+  time_t read;				/* when the index was read */
+  smime_key_t *keys;			/* its keys, in order */
+  smime_key_t **key;
+  int nkeys;
+  HASH *email;
+  HASH *hash;
+} SmimeIndex[2];
+
+static void smime_free_key_ref (void *p)
+{
+  struct smime_key_ref *ref = (struct smime_key_ref *) p;
+
+  FREE (&ref->name);
+  FREE (&ref->key);
+  FREE (&ref);		/* __FREE_CHECKED__ */
+}
+
+static void smime_add_key_ref (HASH *table, const char *name, int key)
+{
+  struct smime_key_ref *ref;
+
+  if (!name || !*name)
+    return;
+
+  if ((ref = hash_find (table, name)) == NULL)
+  {
+    ref = safe_calloc (1, sizeof (struct smime_key_ref));
+    ref->name = safe_strdup (name);
+    hash_insert (table, ref->name, ref, 0);
+  }
+
+  if (ref->nkeys == ref->max)
+    safe_realloc (&ref->key, (ref->max += 4) * sizeof (int));
+  ref->key[ref->nkeys++] = key;
+}
+
+static void smime_free_index (struct smime_index *index)
+{
+  FREE (&index->path);
+  smime_free_key (&index->keys);
+  FREE (&index->key);
+  index->nkeys = 0;
+  if (index->email)
+    hash_destroy (&index->email, smime_free_key_ref);
+  if (index->hash)
+    hash_destroy (&index->hash, smime_free_key_ref);
+}
+
+/* smime_index: the keys of the certificates' or private keys' index,
+ * read anew if the file has changed, or NULL if it can't be read. */
+static struct smime_index *smime_index (short public)
 {
+  struct smime_index *index = &SmimeIndex[public != 0];
   char index_file[_POSIX_PATH_MAX];
-  FILE *fp;
   char buf[LONG_STRING];
-  smime_key_t *key, *results, **results_end;
-
-  results = NULL;
-  results_end = &results;
+  struct stat st;
+  smime_key_t *key, **keys_end;
+  FILE *fp;
+  int n;
 
   snprintf(index_file, sizeof (index_file), "%s/.index",
     public ? NONULL(SmimeCertificates) : NONULL(SmimeKeys));
 
-  if ((fp = safe_fopen (index_file, "r")) == NULL)
+  if ((fp = safe_fopen (index_file, "r")) == NULL || fstat (fileno (fp), &st) == -1)
   {
     mutt_perror (index_file);
+    safe_fclose (&fp);
+    smime_free_index (index);
     return NULL;
   }
 
+  /* a change within the second it was read in wouldn't show */
+  if (index->email && !mutt_strcmp (index->path, index_file) &&
+      index->mtime == st.st_mtime && index->size == st.st_size &&
+      index->mtime < index->read)
+  {
+    safe_fclose (&fp);
+    return index;
+  }
+
+  smime_free_index (index);
+  dprint (2, (debugfile, "smime_index: reading %s.\n", index_file));
+
+  index->path = safe_strdup (index_file);
+  index->mtime = st.st_mtime;
+  index->size = st.st_size;
+  index->read = time (NULL);
+  index->email = hash_create (1031, 1);
+  index->hash = hash_create (1031, 1);
+
+  keys_end = &index->keys;
   while (fgets (buf, sizeof (buf), fp))
   {
-    if ((! *search) || mutt_stristr (buf, search))
+    if ((key = smime_parse_key (buf)))
     {
-      key = smime_parse_key (buf);
-      if (key)
-      {
-        *results_end = key;
-        results_end = &key->next;
-      }
+      *keys_end = key;
+      keys_end = &key->next;
+      index->nkeys++;
     }
   }
 
   safe_fclose (&fp);
 
+  index->key = safe_calloc (index->nkeys, sizeof (smime_key_t *));
+  for (key = index->keys, n = 0; key; key = key->next, n++)
+  {
+    index->key[n] = key;
+    smime_add_key_ref (index->email, key->email, n);
+    smime_add_key_ref (index->hash, key->hash, n);
+  }
+
+  return index;
+}
+
+/* smime_get_candidates: copies of the keys in the index with name as their
+ * hash or email address, or of all keys if name is NULL, in the order of
+ * the index. */
+static smime_key_t *smime_get_candidates(short public, int by_hash,
+					 const char *name)
+{
+  struct smime_index *index;
+  struct smime_key_ref *ref;
+  smime_key_t *key, *results, **results_end;
+  HASH *table;
+  int i;
+
+  results = NULL;
+  results_end = &results;
+
+  if ((index = smime_index (public)) == NULL)
+    return NULL;
+
+  if (!name)
+  {
+    for (i = 0; i < index->nkeys; i++)
+    {
+      *results_end = key = smime_copy_key (index->key[i]);
+      results_end = &key->next;
+    }
+  }
+  else
+  {
+    table = by_hash ? index->hash : index->email;
+    if ((ref = hash_find (table, name)) == NULL)
+      return NULL;
+
+    for (i = 0; i < ref->nkeys; i++)
+    {
+      *results_end = key = smime_copy_key (index->key[ref->key[i]]);
+      results_end = &key->next;
+    }
+  }
+
   return results;
 }
 
@@ -625,7 +762,7 @@ static smime_key_t *smime_get_key_by_hash(char *hash, short public)
   smime_key_t *results, *result;
   smime_key_t *match = NULL;
 
-  results = smime_get_candidates(hash, public);
+  results = smime_get_candidates(public, 1, hash);
   for (result = results; result; result = result->next)
   {
     if (mutt_strcasecmp (hash, result->hash) == 0)
@@ -654,7 +791,7 @@ static smime_key_t *smime_get_key_by_addr(char *mailbox, short abilities, short
   if (! mailbox)
     return NULL;
 
-  results = smime_get_candidates(mailbox, public);
+  results = smime_get_candidates(public, 0, mailbox);
   for (result = results; result; result = result->next)
   {
     if (abilities && !(result->flags & abilities))
@@ -723,7 +860,7 @@ static smime_key_t *smime_get_key_by_str(char *str, short abilities, short publi
   if (! str)
     return NULL;
 
-  results = smime_get_candidates(str, public);
+  results = smime_get_candidates(public, 0, NULL);
   for (result = results; result; result = result->next)
   {
     if (abilities && !(result->flags & abilities))
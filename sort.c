@@ -23,6 +23,12 @@
 #include "mutt.h"
 #include "sort.h"
 #include "mutt_idna.h"
+#include "timing.h"
+
+#ifdef USE_IMAP
+#include "mx.h"
+#include "imap/imap.h"
+#endif
 
 #include <stdlib.h>
 #include <string.h>
@@ -244,6 +250,8 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
   HEADER *h;
   THREAD *thread, *top;
   sort_t *sortfunc;
+  int sorted = 0;
+  timing_t start = mutt_timing_now ();
   
   unset_option (OPTNEEDRESORT);
 
@@ -280,6 +288,12 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
   if (init && ctx->tree)
     mutt_clear_threads (ctx);
 
+#ifdef USE_IMAP
+  /* IMAP headers may still be missing their envelopes */
+  if (ctx->magic == M_IMAP)
+    sorted = imap_sort_headers (ctx, Sort);
+#endif
+
   if ((Sort & SORT_MASK) == SORT_THREADS)
   {
     AuxSort = NULL;
@@ -296,15 +310,17 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
     }
     mutt_sort_threads (ctx, init);
   }
-  else if ((sortfunc = mutt_get_sort_func (Sort)) == NULL ||
-	   (AuxSort = mutt_get_sort_func (SortAux)) == NULL)
+  else if (!sorted)
   {
-    mutt_error _("Could not find sorting function! [report this bug]");
-    mutt_sleep (1);
-    return;
-  }
-  else 
+    if ((sortfunc = mutt_get_sort_func (Sort)) == NULL ||
+	(AuxSort = mutt_get_sort_func (SortAux)) == NULL)
+    {
+      mutt_error _("Could not find sorting function! [report this bug]");
+      mutt_sleep (1);
+      return;
+    }
     qsort ((void *) ctx->hdrs, ctx->msgcount, sizeof (HEADER *), sortfunc);
+  }
 
   /* adjust the virtual message numbers */
   ctx->vcount = 0;
@@ -337,6 +353,8 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
     mutt_set_virtual (ctx);
   }
 
+  mutt_timing_add (TIMING_SORT, start, ctx->msgcount);
+
   if (!ctx->quiet)
     mutt_clear_error ();
 }
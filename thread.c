@@ -22,6 +22,7 @@
 
 #include "mutt.h"
 #include "sort.h"
+#include "timing.h"
 
 #include <string.h>
 #include <ctype.h>
@@ -753,6 +754,7 @@ void mutt_sort_threads (CONTEXT *ctx, int init)
   int i, oldsort, using_refs = 0;
   THREAD *thread, *new, *tmp, top;
   LIST *ref = NULL;
+  timing_t start = mutt_timing_now ();
   
   /* set Sort to the secondary method to support the set sort_aux=reverse-*
    * settings.  The sorting functions just look at the value of
@@ -971,6 +973,8 @@ void mutt_sort_threads (CONTEXT *ctx, int init)
     /* Draw the thread tree. */
     mutt_draw_tree (ctx);
   }
+
+  mutt_timing_add (TIMING_THREAD, start, ctx->msgcount);
 }
 
 static HEADER *find_virtual (THREAD *cur, int reverse)
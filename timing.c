@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* Phase-level timing: callers take a timestamp with mutt_timing_now()
+ * and hand it to mutt_timing_add() when the phase is done. Phases may
+ * nest (threading happens inside sorting, which happens inside opening a
+ * mailbox), so the totals don't add up to wall clock time. */
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mutt.h"
+#include "pager.h"
+#include "timing.h"
+#if defined(USE_IMAP) || defined(USE_POP)
+#include "account.h"
+#include "bcache.h"
+#endif
+#ifdef USE_ZLIB
+#include "mutt_socket.h"
+#include "mutt_zstrm.h"
+#endif
+
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+
+typedef struct
+{
+  unsigned long calls;
+  unsigned long long items;
+  timing_t total;
+  timing_t max;
+} TIMING_PHASE;
+
+static TIMING_PHASE Phases[TIMING_MAX];
+
+static const char *PhaseNames[TIMING_MAX] = {
+  "mx_open",
+  "mx_check",
+  "mx_sync",
+  "mbox_parse",
+  "dir_scan",
+  "dir_parse",
+  "hcache_fetch",
+  "hcache_restore",
+  "hcache_store",
+  "imap_headers",
+  "pop_headers",
+  "imap_cmd",
+  "pop_cmd",
+  "sort",
+  "thread",
+  "index_draw"
+};
+
+timing_t mutt_timing_now (void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+    return (timing_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+  {
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (timing_t) tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+  }
+}
+
+/* mutt_timing_add: account for one run of phase which began at start and
+ * processed items messages (or whatever the phase works on) */
+void mutt_timing_add (int phase, timing_t start, long items)
+{
+  timing_t now = mutt_timing_now ();
+  timing_t t = now > start ? now - start : 0;
+
+  if (phase < 0 || phase >= TIMING_MAX)
+    return;
+
+  Phases[phase].calls++;
+  if (items > 0)
+    Phases[phase].items += items;
+  Phases[phase].total += t;
+  if (t > Phases[phase].max)
+    Phases[phase].max = t;
+}
+
+static double timing_ms (timing_t t)
+{
+  return t / 1e6;
+}
+
+#if defined(USE_IMAP) || defined(USE_POP)
+/* timing_show_bcache: add the counters of the message cache */
+static void timing_show_bcache (FILE *fp)
+{
+  BCACHE_STATS stats;
+
+  mutt_bcache_stats (&stats);
+  if (!stats.hits && !stats.misses && !stats.bytes_written)
+    return;
+
+  fprintf (fp, "\n%-16s %8s %8s %10s %12s %12s %12s\n\n", _("Cache"),
+	   _("Hits"), _("Misses"), _("Evictions"), _("Read"), _("Written"),
+	   _("Evicted"));
+  fprintf (fp, "%-16s %8lu %8lu %10lu %12llu %12llu %12llu\n", "message_cachedir",
+	   stats.hits, stats.misses, stats.evictions, stats.bytes_read,
+	   stats.bytes_written, stats.bytes_evicted);
+}
+#endif
+
+#ifdef USE_ZLIB
+/* timing_show_zstrm: add the byte counts of open compressed connections */
+static void timing_show_zstrm (FILE *fp)
+{
+  CONNECTION *conn;
+  ZSTRM_STATS stats;
+  int header = 0;
+
+  for (conn = mutt_socket_head (); conn; conn = conn->next)
+  {
+    if (mutt_zstrm_get_stats (conn, &stats) < 0)
+      continue;
+    if (!header++)
+      fprintf (fp, "\n%-24s %12s %12s %12s %12s\n\n", _("Connection"),
+	       _("Read"), _("Received"), _("Written"), _("Sent"));
+    fprintf (fp, "%-24.24s %12llu %12llu %12llu %12llu\n", conn->account.host,
+	     stats.in_raw, stats.in_wire, stats.out_raw, stats.out_wire);
+  }
+}
+#endif
+
+/* mutt_timing_show: display a summary in the pager */
+void mutt_timing_show (void)
+{
+  char tempfile[_POSIX_PATH_MAX];
+  FILE *fp;
+  int i;
+
+  mutt_mktemp (tempfile, sizeof (tempfile));
+  if ((fp = safe_fopen (tempfile, "w")) == NULL)
+  {
+    mutt_perror (tempfile);
+    return;
+  }
+
+  fprintf (fp, "%-16s %8s %10s %12s %10s %10s\n\n", _("Phase"), _("Calls"),
+	   _("Items"), _("Total ms"), _("Max ms"), _("us/item"));
+  for (i = 0; i < TIMING_MAX; i++)
+  {
+    if (!Phases[i].calls)
+      continue;
+    fprintf (fp, "%-16s %8lu %10llu %12.3f %10.3f %10.3f\n", PhaseNames[i],
+	     Phases[i].calls, Phases[i].items, timing_ms (Phases[i].total),
+	     timing_ms (Phases[i].max),
+	     Phases[i].items ? Phases[i].total / 1e3 / Phases[i].items : 0.0);
+  }
+#if defined(USE_IMAP) || defined(USE_POP)
+  timing_show_bcache (fp);
+#endif
+#ifdef USE_ZLIB
+  timing_show_zstrm (fp);
+#endif
+  safe_fclose (&fp);
+
+  mutt_do_pager (_("Timing"), tempfile, M_PAGER_NOWRAP, NULL);
+}
+
+/* mutt_timing_dump: write all phases as JSON to path.
+ *   Returns 0 on success, -1 on error. */
+int mutt_timing_dump (const char *path)
+{
+  FILE *fp;
+  int i;
+
+  if ((fp = fopen (path, "w")) == NULL)
+  {
+    dprint (1, (debugfile, "mutt_timing_dump: %s: %s\n", path, strerror (errno)));
+    return -1;
+  }
+
+  fprintf (fp, "{\n  \"version\": \"%s\",\n  \"phases\": {\n", MUTT_VERSION);
+  for (i = 0; i < TIMING_MAX; i++)
+    fprintf (fp, "    \"%s\": { \"calls\": %lu, \"items\": %llu, "
+	     "\"total_ms\": %.3f, \"max_ms\": %.3f }%s\n", PhaseNames[i],
+	     Phases[i].calls, Phases[i].items, timing_ms (Phases[i].total),
+	     timing_ms (Phases[i].max), i + 1 < TIMING_MAX ? "," : "");
+  fputs ("  }\n}\n", fp);
+
+  return safe_fclose (&fp);
+}
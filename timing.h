@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2015 The Mutt developers
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* phase-level timing of mailbox operations */
+
+#ifndef _TIMING_H_
+#define _TIMING_H_ 1
+
+/* nanoseconds on a monotonic clock */
+typedef unsigned long long timing_t;
+
+/* keep in sync with PhaseNames in timing.c */
+enum
+{
+  TIMING_MX_OPEN = 0,
+  TIMING_MX_CHECK,
+  TIMING_MX_SYNC,
+  TIMING_MBOX_PARSE,
+  TIMING_DIR_SCAN,		/* readdir() of maildir/MH folders */
+  TIMING_DIR_PARSE,		/* reading maildir/MH headers, incl. hcache */
+  TIMING_HCACHE_FETCH,
+  TIMING_HCACHE_RESTORE,
+  TIMING_HCACHE_STORE,
+  TIMING_IMAP_HEADERS,
+  TIMING_POP_HEADERS,
+  TIMING_IMAP_CMD,		/* network round trips */
+  TIMING_POP_CMD,
+  TIMING_SORT,
+  TIMING_THREAD,
+  TIMING_INDEX_DRAW,
+
+  TIMING_MAX
+};
+
+timing_t mutt_timing_now (void);
+void mutt_timing_add (int phase, timing_t start, long items);
+
+void mutt_timing_show (void);
+int mutt_timing_dump (const char *path);
+
+#endif /* _TIMING_H_ */